@@ -0,0 +1,51 @@
+/**
+ * @file bench_common.h
+ * @brief 各基准测试共用的辅助函数
+ *
+ * 大纲：
+ * 1. 解析命令行给出的输入大小，可带 K/M/G 后缀，不带后缀时按 G 计
+ * 2. 把一段样本重复填满指定大小的文本块
+ * 3. 计时与输出一行吞吐量结果
+ */
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+#include "../include/piece_table.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+inline size_t parseSize(const std::string& text) {
+    size_t value = static_cast<size_t>(std::strtoull(text.c_str(), NULL, 10));
+    char unit = text.empty() ? 'G' : text[text.size() - 1];
+    if (unit == 'M' || unit == 'm') return value << 20;
+    if (unit == 'K' || unit == 'k') return value << 10;
+    return value << 30;
+}
+
+// 把样本重复写入新的文本块，直到 size 字节
+inline std::shared_ptr<TextBlock> repeatSample(const std::string& sample, size_t size) {
+    std::shared_ptr<TextBlock> block = std::make_shared<TextBlock>(size);
+    while (block->size() < size) {
+        block->append(sample.data(), std::min(sample.size(), size - block->size()));
+    }
+    return block;
+}
+
+template <typename F>
+inline double measure(F run) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+inline void report(const char* name, size_t bytes, double seconds, size_t count,
+                   const char* unit = "lines") {
+    std::printf("  %-22s %8.3f GB/s  %8.3f s  %zu %s\n",
+                name, static_cast<double>(bytes) / seconds / 1e9, seconds, count, unit);
+}
+
+#endif // BENCH_COMMON_H
@@ -0,0 +1,91 @@
+/**
+ * @file bench_line_index.cpp
+ * @brief 换行符扫描与行索引的吞吐量基准测试
+ *
+ * 用法：bench_line_index [大小...]，大小可带 K/M/G 后缀（不带时按 G 计），默认 1G。
+ * 对每个大小生成合成文本，分别测量 memchr、各扫描实现和
+ * 片段表并行建立索引的速度（GB/s），以及各实现查找子串的速度。
+ */
+#include "../include/line_scanner.h"
+#include "../include/piece_table.h"
+#include "../include/thread_pool.h"
+#include "bench_common.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 生成长度不一的行，约十分之一以 \r\n 结尾；先生成 1MB 样本再重复填满
+static std::shared_ptr<TextBlock> makeInput(size_t size) {
+    std::string sample;
+    uint32_t seed = 12345;
+    while (sample.size() < (1u << 20)) {
+        seed = seed * 1103515245u + 12345u;
+        size_t length = (seed >> 16) % 160;
+        sample.append(length, static_cast<char>('a' + (seed >> 8) % 26));
+        if ((seed >> 4) % 10 == 0) sample.push_back('\r');
+        sample.push_back('\n');
+    }
+    return repeatSample(sample, size);
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        sizes.push_back(parseSize(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes.push_back(parseSize("1G"));
+    }
+
+    std::printf("best kernel: %s, threads: %zu\n",
+                scanKernelName(bestScanKernel()), ThreadPool::shared().size() + 1);
+    for (size_t s = 0; s < sizes.size(); ++s) {
+        size_t size = sizes[s];
+        std::shared_ptr<TextBlock> input = makeInput(size);
+        std::printf("input: %.2f GB\n", static_cast<double>(size) / (1u << 30));
+
+        size_t lineFeeds = 0;
+        double seconds = measure([&]() {
+            const char* cursor = input->data();
+            const char* end = cursor + size;
+            while (const void* hit = std::memchr(cursor, '\n', static_cast<size_t>(end - cursor))) {
+                ++lineFeeds;
+                cursor = static_cast<const char*>(hit) + 1;
+            }
+        });
+        report("memchr", size, seconds, lineFeeds);
+
+        const ScanKernel kernels[] = { ScanKernel::SCALAR, ScanKernel::SSE2, ScanKernel::AVX2 };
+        for (size_t k = 0; k < 3; ++k) {
+            setScanKernel(kernels[k]);
+            if (activeScanKernel() != kernels[k]) continue;
+            LineBreakCounts counts = { 0, 0 };
+            seconds = measure([&]() { counts = countLineBreaks(input->data(), size); });
+            report(scanKernelName(kernels[k]), size, seconds, counts.lineFeeds);
+        }
+        setScanKernel(bestScanKernel());
+
+        // 样本中每行只有一种字母，这个模式串首字节常见但不会匹配，需要扫完整个输入
+        static const char kPattern[] = "aaaab";
+        std::string label;
+        for (size_t k = 0; k < 3; ++k) {
+            setScanKernel(kernels[k]);
+            if (activeScanKernel() != kernels[k]) continue;
+            size_t hit = 0;
+            seconds = measure([&]() { hit = findPattern(input->data(), size, kPattern, 5); });
+            label = std::string("find ") + scanKernelName(kernels[k]);
+            report(label.c_str(), size, seconds, hit == size ? 0 : 1, "matches");
+        }
+        setScanKernel(bestScanKernel());
+
+        PieceTable table;
+        seconds = measure([&]() {
+            table.adopt(input, size);
+            table.indexAll();
+        });
+        report("piece table index", size, seconds, table.lineCount() - 1);
+    }
+    return 0;
+}
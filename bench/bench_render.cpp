@@ -0,0 +1,181 @@
+/**
+ * @file bench_render.cpp
+ * @brief 界面绘制的逐帧基准测试
+ *
+ * 用法：bench_render [行数] [列数x行数] [virtual|ansi]，默认 200000 行、
+ * 160x48 的终端、虚拟终端。
+ * 生成一个 C/C++ 源文件（含制表符和中文注释）并打开，把脚本化的按键
+ * 送入无终端的 NCursesUI，每批按键之后绘制一帧到虚拟终端；ansi 时绘制到
+ * 输出 ANSI 控制序列的 AnsiScreen，输出写入 /dev/null。
+ * 对每个场景给出每帧绘制耗时（平均、p50、p99、最大）、写入的行数、
+ * 变化的单元格数和输出的字节数（虚拟终端为至少要输出的字节数）。
+ */
+#include "../include/ansi_screen.h"
+#include "../include/editor.h"
+#include "../include/ui_ncurses.h"
+#include "../include/virtual_screen.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const char* const kInputFile = "bench_render_input.cpp";
+
+// 一帧之前到达的一批按键
+typedef std::vector<std::vector<int> > KeyScript;
+
+static void generateInput(size_t lines) {
+    static const char* const kLines[] = {
+        "#include <vector>",
+        "// 处理一批请求：读取、解析并写回结果",
+        "static int process(const std::vector<int>& values, int limit) {",
+        "\tint total = 0;\t// 累计值",
+        "\tfor (size_t i = 0; i < values.size(); ++i) {",
+        "\t\tif (values[i] > limit) { total += values[i] * 2; } else { total -= 1; }",
+        "\t}",
+        "\tconst char* message = \"error: value out of range, 数值超出范围\";",
+        "\t/* 多行注释开始",
+        "\t   仍在注释中：error 与 warning 都不是关键字 */",
+        "\treturn total;",
+        "}",
+        "",
+    };
+    std::ofstream out(kInputFile, std::ios::binary);
+    size_t count = sizeof(kLines) / sizeof(kLines[0]);
+    for (size_t i = 0; i < lines; ++i) {
+        out << kLines[i % count];
+        if (i % 97 == 0) {
+            // 偶尔出现超过终端宽度的长行，测试水平滚动和软换行
+            for (int j = 0; j < 12; ++j) {
+                out << " padding_identifier_" << j << " 宽字符填充";
+            }
+        }
+        out << '\n';
+    }
+}
+
+// 每个字符单独一批，模拟逐个按键
+static void typeKeys(KeyScript& script, const std::string& keys, size_t repeat = 1) {
+    for (size_t r = 0; r < repeat; ++r) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            script.push_back(std::vector<int>(1, static_cast<unsigned char>(keys[i])));
+        }
+    }
+}
+
+// 整个字符串作为一批到达，如快速输入的命令行
+static void sendBatch(KeyScript& script, const std::string& keys) {
+    std::vector<int> batch;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        batch.push_back(static_cast<unsigned char>(keys[i]));
+    }
+    script.push_back(batch);
+}
+
+static double percentile(std::vector<double> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1));
+    return values[index];
+}
+
+static void runScenario(const char* name, NCursesUI& ui, VirtualScreen& screen, const KeyScript& script) {
+    std::vector<double> times;
+    size_t rows = 0;
+    size_t cells = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < script.size(); ++i) {
+        ui.processKeys(script[i]);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ui.renderFrame();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        times.push_back(elapsed.count());
+        rows += screen.lastFrame().rowsDrawn;
+        cells += screen.lastFrame().cellsChanged;
+        bytes += screen.lastFrame().bytesEmitted;
+    }
+    double total = 0;
+    for (size_t i = 0; i < times.size(); ++i) {
+        total += times[i];
+    }
+    double frames = static_cast<double>(times.size());
+    std::printf("  %-16s %6zu frames  avg %7.3f ms  p50 %7.3f  p99 %7.3f  max %7.3f  "
+                "rows %6.1f  cells %8.1f  bytes %8.1f\n",
+                name, times.size(), total / frames, percentile(times, 0.5), percentile(times, 0.99),
+                *std::max_element(times.begin(), times.end()), static_cast<double>(rows) / frames,
+                static_cast<double>(cells) / frames, static_cast<double>(bytes) / frames);
+}
+
+int main(int argc, char* argv[]) {
+    size_t lines = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], NULL, 10)) : 200000;
+    int columns = 160;
+    int rows = 48;
+    if (argc > 2) {
+        std::sscanf(argv[2], "%dx%d", &columns, &rows);
+    }
+    bool ansi = argc > 3 && std::string(argv[3]) == "ansi";
+    generateInput(lines);
+    std::printf("input: %zu lines, terminal %dx%d, %s\n", lines, columns, rows, ansi ? "ansi" : "virtual");
+
+    Editor editor;
+    editor.openFile(kInputFile);
+    // 等后台载入完成，各场景都在完整的行索引上测量
+    while (editor.isLoading()) {
+        if (!editor.pollLoad()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    int null = open("/dev/null", O_WRONLY);
+    std::unique_ptr<VirtualScreen> output(ansi ? new AnsiScreen(null, rows - 1, columns)
+                                               : new VirtualScreen(rows - 1, columns));
+    VirtualScreen& screen = *output;
+    NCursesUI ui(editor, screen);
+    ui.renderFrame();
+
+    KeyScript scroll;
+    typeKeys(scroll, "j", 2000);
+    runScenario("scroll j", ui, screen, scroll);
+
+    KeyScript page;
+    typeKeys(page, "\x06", 500);
+    runScenario("page Ctrl-F", ui, screen, page);
+
+    KeyScript horizontal;
+    typeKeys(horizontal, "l", 400);
+    typeKeys(horizontal, "h", 400);
+    runScenario("scroll l/h", ui, screen, horizontal);
+
+    KeyScript insert;
+    typeKeys(insert, "i");
+    typeKeys(insert, "int value = 42; ", 100);
+    typeKeys(insert, "\x1b");
+    runScenario("insert typing", ui, screen, insert);
+
+    KeyScript comment;
+    typeKeys(comment, "i/*\x1b");
+    typeKeys(comment, "x", 2);
+    runScenario("open comment", ui, screen, comment);
+
+    KeyScript search;
+    typeKeys(search, "/error\n");
+    typeKeys(search, "n", 500);
+    runScenario("search n", ui, screen, search);
+
+    KeyScript wrap;
+    sendBatch(wrap, ":set wrap\n");
+    typeKeys(wrap, "j", 2000);
+    typeKeys(wrap, "\x06", 200);
+    runScenario("wrap scroll", ui, screen, wrap);
+
+    editor.shutdown();
+    output.reset();
+    close(null);
+    std::remove(kInputFile);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file aho_corasick.h
+ * @brief 多模式串匹配（Aho–Corasick 自动机）
+ *
+ * 大纲：
+ * 1. 加入一组模式串后一次编译成确定的状态机
+ * 2. 在一段文本中一遍找出所有模式串的全部出现（可以重叠）
+ * 3. 在整个片段表中并行统计每个模式串的出现次数
+ *
+ * 只在模式串中出现过的字节有各自的字节类，其余字节共用一类，
+ * 转移表大小为 状态数 × 字节类数。每个字节只查一次表，耗时与模式串个数无关。
+ */
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "piece_table.h"
+
+class ThreadPool;
+
+class AhoCorasick {
+public:
+    struct Hit {
+        size_t end;     // 出现处末尾之后的偏移
+        int pattern;
+    };
+
+    AhoCorasick();
+
+    // 加入模式串并返回其编号，已有的模式串返回原编号，空串返回 -1。
+    // 加入后须调用 build() 才能匹配
+    int add(const std::string& pattern);
+    void build();
+    void clear();
+
+    bool empty() const;
+    size_t size() const;
+    const std::string& pattern(int id) const;
+    size_t maxLength() const;
+
+    // 在 data 中查找全部出现，hits 中的偏移加上 base
+    void findAll(const char* data, size_t length, size_t base, std::vector<Hit>& hits) const;
+    // 统计各模式串在 buffer 中出现的次数，counts 按编号排列
+    void countAll(const PieceTable& buffer, ThreadPool& pool, std::vector<size_t>& counts) const;
+
+private:
+    std::vector<std::string> m_patterns;
+    size_t m_maxLength;
+
+    // 编译结果
+    unsigned short m_classOf[256];
+    size_t m_classCount;
+    std::vector<int> m_next;        // 状态 × 字节类 → 状态
+    std::vector<int> m_fail;
+    std::vector<int> m_output;      // 在该状态结束的模式串，没有时为 -1
+    std::vector<int> m_outputLink;  // 该状态或其最长的有输出的后缀状态，没有时为 -1
+
+    // 每段至少这么多字节才值得交给线程池
+    static const size_t kParallelChunk = 4 * 1024 * 1024;
+
+    int step(int state, unsigned char byte) const {
+        return m_next[static_cast<size_t>(state) * m_classCount + m_classOf[byte]];
+    }
+    // 统计末尾落在 [from, to) 之后的出现，from 之前补扫 maxLength - 1 字节以免漏掉跨界的出现
+    void countRange(const PieceTable& buffer, size_t from, size_t to, std::vector<size_t>& counts) const;
+};
+
+#endif // AHO_CORASICK_H
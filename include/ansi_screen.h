@@ -0,0 +1,51 @@
+/**
+ * @file ansi_screen.h
+ * @brief 直接输出 ANSI 控制序列的终端绘制目标
+ *
+ * 大纲：
+ * 1. 沿用虚拟终端的前后台单元格缓冲，present 时逐行比较
+ * 2. 只输出变化的单元格：选择最短的光标移动方式，属性变化时才输出 SGR，
+ *    行尾变为空白时用清除到行尾代替逐个输出空格
+ * 3. 一帧的全部输出拼成一个字符串，一次 write() 写出
+ *
+ * 不依赖 ncurses，用于没有安装 ncurses 的最小环境。使用备用屏幕，
+ * 退出时恢复终端原来的内容。
+ */
+#ifndef ANSI_SCREEN_H
+#define ANSI_SCREEN_H
+#include "virtual_screen.h"
+#include <string>
+
+class AnsiScreen : public VirtualScreen {
+public:
+    // 输出到文件描述符 fd；与 VirtualScreen 相同，rows 为编辑区的行数，终端还需多一行状态栏
+    AnsiScreen(int fd, int rows, int columns);
+    ~AnsiScreen();
+
+    // 终端尺寸变化后调用；下一帧整屏重绘
+    void resize(int rows, int columns);
+    void present();
+
+    // 退出前恢复终端；可以重复调用
+    void close();
+
+private:
+    int m_fd;
+    bool m_open;
+    // 本帧的输出
+    std::string m_frame;
+    // 终端上实际的光标位置和属性；-1 表示未知，下次必须显式设置
+    int m_outRow;
+    int m_outColumn;
+    int m_outPair;
+    bool m_outReverse;
+    int m_presentedRow;
+    int m_presentedColumn;
+
+    void compose();
+    void moveTo(int row, int column);
+    void setAttributes(bool reverse, short pair);
+    void emit(const std::string& text);
+};
+
+#endif // ANSI_SCREEN_H
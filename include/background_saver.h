@@ -0,0 +1,60 @@
+/**
+ * @file background_saver.h
+ * @brief 后台保存
+ *
+ * 大纲：
+ * 1. 在工作线程中保存缓冲区快照，界面线程不被阻塞
+ * 2. 查询进度和取回保存结果
+ */
+#ifndef BACKGROUND_SAVER_H
+#define BACKGROUND_SAVER_H
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include "piece_table.h"
+
+class BackgroundSaver {
+public:
+    BackgroundSaver();
+    ~BackgroundSaver();
+
+    // 开始保存快照；已有保存在进行时返回 false。beforeInPlace 见 FileSaver::setBeforeInPlace
+    bool start(const PieceTable& snapshot, const std::string& filename,
+               const std::function<void(int)>& beforeInPlace = std::function<void(int)>());
+    bool isRunning() const;
+    size_t getBytesWritten() const;
+    size_t getTotalBytes() const;
+
+    // 取回已结束的保存结果；仍在进行或没有保存时返回 false
+    bool takeResult(bool& succeeded, std::string& filename, std::string& error);
+    // 等待当前保存结束（退出程序前调用）
+    void wait();
+    // 保存结束时在工作线程中调用 callback，用于唤醒界面的事件循环；须在 start 之前设置
+    void setCompletionCallback(const std::function<void()>& callback);
+
+private:
+    enum State {
+        IDLE,
+        RUNNING,
+        FINISHED
+    };
+
+    std::thread m_worker;
+    PieceTable m_snapshot;
+    std::string m_filename;
+    std::string m_error;
+    bool m_succeeded;
+    size_t m_totalBytes;
+    std::atomic<int> m_state;
+    std::atomic<size_t> m_bytesWritten;
+    std::function<void()> m_onComplete;
+    std::function<void(int)> m_beforeInPlace;
+
+    void run();
+
+    BackgroundSaver(const BackgroundSaver&);
+    BackgroundSaver& operator=(const BackgroundSaver&);
+};
+
+#endif // BACKGROUND_SAVER_H
@@ -0,0 +1,123 @@
+/**
+ * @file edit_journal.h
+ * @brief 编辑日志（交换文件）与崩溃恢复
+ *
+ * 大纲：
+ * 1. 交换文件位于被编辑文件旁，文件头记录原文件的大小和修改时间
+ * 2. 每次编辑追加一条紧凑的二进制记录，先写入内存，
+ *    由后台线程定时批量写盘，按键路径上只有一次内存追加
+ * 3. 保存成功后以新文件为基准重写日志
+ * 4. 读取日志并重放记录
+ * 5. 多个会话：文件头记录写日志的进程，记录期间对交换文件持有 flock，
+ *    其他会话据此判断它是否正被使用；新日志从不覆盖已有的交换文件，
+ *    同一文件的第二个交换文件起在名字后加序号
+ */
+#ifndef EDIT_JOURNAL_H
+#define EDIT_JOURNAL_H
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 日志对应的原文件版本
+struct JournalBase {
+    uint64_t size;
+    int64_t modifiedTime;
+};
+
+// 写日志的进程
+struct JournalOwner {
+    uint64_t pid;       // 旧格式的日志没有记录时为 0
+    std::string host;
+};
+
+// 重放用的记录：在 offset 处删除 removedLength 字节后插入 inserted
+struct JournalRecord {
+    uint64_t offset;
+    uint64_t removedLength;
+    std::string inserted;
+};
+
+class EditJournal {
+public:
+    EditJournal();
+    ~EditJournal();
+
+    // 同一文件最多同时存在的交换文件数
+    static const int kMaxJournals = 10;
+
+    // 第 index 个交换文件的路径，index 为 0 时不带序号
+    static std::string journalPathFor(const std::string& filename, int index = 0);
+    // 读取文件当前的大小和修改时间；文件不存在时返回 false
+    static bool statBase(const std::string& filename, JournalBase& base);
+    // 读取日志；末尾不完整的记录（写到一半时崩溃）被忽略。owner 不为空时取出写日志的进程
+    static bool read(const std::string& journalPath, JournalBase& base, std::vector<JournalRecord>& records,
+                     JournalOwner* owner = NULL);
+    // 交换文件是否被其他会话锁住（正在记录，或正等待用户决定恢复还是放弃）
+    static bool isInUse(const std::string& journalPath);
+
+    // 为 filename 开始新的日志，使用第一个尚不存在的交换文件名，不覆盖已有的交换文件
+    bool start(const std::string& filename, const JournalBase& base);
+    // 停止记录并删除交换文件（正常退出或放弃修改时）
+    void discard();
+    // 停止记录但保留交换文件
+    void close();
+    bool isActive() const;
+
+    void append(uint64_t offset, uint64_t removedLength, const char* inserted, size_t insertedLength);
+    void flush();
+
+    // 后台保存开始时调用：之后的记录另外保留一份，
+    // 保存成功后以新文件为基准、只用这些记录重写日志
+    void beginCheckpoint();
+    void commitCheckpoint(const std::string& filename, const JournalBase& base);
+    void abortCheckpoint();
+
+private:
+    std::string m_path;
+    std::string m_filename;     // 日志对应的文件
+    std::FILE* m_file;
+    std::string m_pending;      // 尚未写盘的记录
+    std::string m_checkpoint;   // 保存开始后的记录
+    bool m_capturing;
+    bool m_stopping;
+    std::mutex m_mutex;         // 保护内存中的记录
+    std::mutex m_fileMutex;     // 保护交换文件
+    std::condition_variable m_wakeup;
+    std::thread m_flusher;
+
+    static const int kFlushIntervalMs = 1000;
+
+    // 以 records 为初始内容开始日志
+    bool startWith(const std::string& filename, const JournalBase& base, const std::string& records);
+    bool openFile(const std::string& path, bool replace, const JournalBase& base, const std::string& records);
+    void flushLoop();
+    void stopFlusher();
+    void writePending();
+
+    EditJournal(const EditJournal&);
+    EditJournal& operator=(const EditJournal&);
+};
+
+// 交换文件上的 flock。打开文件时发现遗留的交换文件后锁住它，直到恢复或放弃，
+// 其他会话不会同时重放或删除它；不支持 flock 的平台上总能取得
+class JournalLock {
+public:
+    JournalLock();
+    ~JournalLock();
+
+    // 已被其他会话锁住时返回 false
+    bool acquire(const std::string& path);
+    void release();
+
+private:
+    int m_fd;
+
+    JournalLock(const JournalLock&);
+    JournalLock& operator=(const JournalLock&);
+};
+
+#endif // EDIT_JOURNAL_H
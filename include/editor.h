@@ -17,9 +17,24 @@
  */
 #ifndef EDITOR_H
 #define EDITOR_H
+#include <climits>
+#include <functional>
 #include <string>
 #include <vector>
 #include <utility>
+#include "aho_corasick.h"
+#include "background_saver.h"
+#include "edit_journal.h"
+#include "file_loader.h"
+#include "gap_buffer.h"
+#include "mapped_file.h"
+#include "match_index.h"
+#include "piece_table.h"
+#include "regex.h"
+#include "syntax.h"
+#include "text_layout.h"
+#include "undo_history.h"
+#include "wrap_layout.h"
 
 // 新增 DeleteType 枚举
 enum class DeleteType {
@@ -37,9 +52,26 @@ enum class EditorMode {
     COMMAND
 };
 
+// 一行中出现的一个高亮关键字
+struct KeywordSpan {
+    size_t column;
+    size_t length;
+    int keyword;    // 关键字编号，界面据此选颜色
+};
+
+// 两次取出之间编辑器状态的变化，界面据此只重绘受影响的部分
+struct EditorDamage {
+    static const int kToEnd = INT_MAX;
+
+    int firstLine;      // 内容变化的首行，没有变化时为 -1
+    int lastLine;       // 内容变化的末行（含）；行数变化时为 kToEnd
+    bool cursorMoved;
+    bool modeChanged;
+};
+
 class Editor {
 private:
-    std::vector<std::string> m_lines;
+    PieceTable m_buffer;
     std::string m_currentFile;
     int m_cursorLine;
     int m_cursorColumn;
@@ -48,6 +80,93 @@ private:
     int m_visualStartLine;
     int m_visualStartColumn;
     std::string m_copiedText;
+    BackgroundSaver m_saver;
+    FileLoader m_loader;    // 在工作线程中为映射的文件建立行索引
+    std::shared_ptr<MappedTextBlock> m_mapped;  // 打开的文件以内存映射读取时的映射
+    size_t m_loadTotal;     // 打开时待索引的字节数，用于计算载入进度
+    UndoHistory m_history;
+    EditJournal m_journal;
+    bool m_journalFound;        // 打开文件时发现了上次遗留、等待决定恢复或放弃的交换文件
+    std::string m_foundJournal; // 这个交换文件的路径
+    JournalLock m_foundLock;    // 决定之前锁住它，其他会话不会同时恢复或删除
+    std::string m_journalOwner; // 正在编辑同一文件的其他会话，没有时为空
+    std::string m_message;  // 命令执行后要显示的信息
+
+    // 查找状态
+    std::string m_lastSearch;
+    Regex m_searchRegex;            // 最近一次编译的查找模式
+    bool m_searchBackward;
+    size_t m_searchOrigin;          // 增量查找开始时的光标偏移
+    std::string m_incrementalPattern;
+    bool m_incrementalFound;
+    bool m_incrementalWrapped;
+    MatchIndex m_matchIndex;        // 上次查找的全部匹配，用于计数和高亮
+    bool m_highlightSearch;         // :set hlsearch
+    AhoCorasick m_keywords;         // :hl add 加入的高亮关键字
+    SyntaxHighlighter m_syntax;     // 按文件扩展名选择，:set syntax= 可以改
+    TextLayout m_layout;            // 各行的字素簇边界和显示宽度
+    WrapLayout m_wrapLayout;        // 软换行的折行点
+    bool m_wrap;                    // :set wrap
+    EditorDamage m_damage;
+    int m_damageCursorLine; // 上次取出变化时的光标位置
+    int m_damageCursorColumn;
+
+    // 插入模式下正在输入的行放在间隙缓冲区中，逐字输入和退格不触及片段表。
+    // 缓冲区中其余各行始终是最新的，只有这一行的内容以间隙缓冲区为准
+    GapBuffer m_editGap;
+    int m_editLine;             // 正在编辑的行，-1 表示没有
+    size_t m_editLineStart;     // 该行行首偏移（之前的行不变，因此保持有效）
+    size_t m_editLineLength;    // 该行载入时的长度
+    size_t m_editDirtyBegin;    // 修改过的区域之前未变的字节数
+    size_t m_editCleanSuffix;   // 修改过的区域之后未变的字节数
+
+    // 惰性建立行索引时每次推进的字节数
+    static const size_t kIndexStep = 1024 * 1024;
+
+    // 所有对缓冲区的修改都经过这里，以便记录撤销历史
+    void replaceRange(size_t offset, size_t length, const std::string& text);
+    // 修改缓冲区、写入编辑日志并记录变化的行，撤销/重做也经过这里
+    void applyEdit(size_t offset, const std::string& removed, const std::string& text);
+    void markLinesChanged(int firstLine, int lastLine);
+    // 第 line 行编辑后，若它结束时的词法状态变了，其后各行都要重画
+    void markSyntaxChanged(int line);
+    // 语法高亮读取各行时只取用得到的行首部分
+    SyntaxHighlighter::LineSource syntaxSource() const;
+    // 编译查找模式，与上次相同时沿用；失败时把错误放入 m_message
+    bool compileSearch(const std::string& pattern);
+    // 从 from 开始按方向查找，到达一端后从另一端继续；wrapped 表示是否回绕
+    size_t findWrapping(const Regex& regex, size_t from, bool backward, bool& wrapped) const;
+    bool jumpToMatch(const std::string& pattern, bool backward);
+    // 查找的模式变化后重建匹配索引
+    void updateMatchIndex();
+    // 正在编辑的行当前内容中的各匹配（起始列, 长度）
+    void findEditLineMatches(std::vector<std::pair<size_t, size_t> >& matches) const;
+    // 保存需要就地写入时调用：目标是映射打开的文件时先把映射复制为私有内存
+    std::function<void(int)> privatizeBeforeInPlace() const;
+    // 取出后台保存的结果；succeeded 给出保存是否成功
+    bool takeSaveResult(std::string& message, bool& succeeded);
+    // 交换文件中记录的写日志进程，用于提示
+    static std::string describeJournalOwner(const std::string& journalPath);
+    // 在光标所在行的间隙缓冲区中输入或退格；必要时先载入该行
+    void typeIntoEditLine(const std::string& text);
+    void backspaceInEditLine(size_t count);
+    void loadEditLine();
+    // 按行内偏移读取间隙缓冲区中的内容，供排版就地更新
+    LineLayout::SegmentSource editLineSource() const;
+    // 把间隙缓冲区中修改过的区域写回片段表
+    void commitEditLine();
+    void applyTransaction(const UndoTransaction& transaction, bool reverse);
+    // ex 命令的地址范围：% . $ 行号及 +N/-N，如 10,5000；没有范围时返回 false
+    bool parseAddress(const std::string& command, size_t& pos, int& line);
+    bool parseRange(const std::string& command, size_t& pos, int& firstLine, int& lastLine);
+    // :[范围]s/模式/替换文本/[g]，pos 指向 s
+    bool substituteCommand(const std::string& command, size_t pos, int firstLine, int lastLine);
+    // :hl add 词... | :hl clear | :hl count
+    bool highlightCommand(const std::vector<std::string>& parts);
+
+    size_t cursorOffset() const;
+    void setCursorOffset(size_t offset);
+    int lineLength(int lineIndex) const;
 
 public:
     Editor();
@@ -57,6 +176,37 @@ public:
     bool openFile(const std::string& filename);
     bool saveFile();
     bool saveFileAs(const std::string& filename);
+    // 后台保存：在工作线程中保存当前内容的快照，期间可以继续编辑
+    bool saveFileInBackground(const std::string& filename);
+    bool isSaving() const;
+    int getSaveProgress() const;
+    // 后台保存结束时返回 true 并给出提示信息
+    bool pollSaveResult(std::string& message);
+    void waitForSave();
+    // 后台载入：首屏的行索引在打开时同步建立，其余部分由工作线程扫描
+    bool isLoading() const;
+    int getLoadProgress() const;
+    // 空闲时调用：接上工作线程已扫描的部分，并为已载入的行补上一段查找匹配；
+    // 做了工作时返回 true，此时可能还有剩余
+    bool pollLoad();
+    // 映射打开的文件被其他程序修改或截断时，把映射复制为私有内存，不再受之后的修改影响，
+    // 并返回 true 给出警告；界面定时调用
+    bool checkMappedFile(std::string& message);
+    // 后台工作有进展或结束时在工作线程中调用 notify，界面用它唤醒事件循环
+    void setNotifier(const std::function<void()>& notify);
+
+    // 崩溃恢复：打开文件时若发现遗留的交换文件，由调用方决定恢复还是放弃；
+    // 暂不决定时可以稍后用 :recover / :discard，期间本次的编辑照常记录
+    bool hasRecoverableJournal() const;
+    // 文件正被另一个会话编辑（它的交换文件被锁住）时返回 true，owner 为该会话的描述
+    bool isEditedElsewhere(std::string& owner) const;
+    // 交换文件记录的原文件版本与磁盘上的文件是否一致
+    bool journalMatchesFile() const;
+    bool recoverJournal(std::string& message);
+    void discardJournal();
+    // 退出前调用：等待后台保存结束。用户主动退出（discardJournal 为 true）且没有
+    // 写盘失败时删除交换文件，否则只把日志写盘并保留交换文件
+    void shutdown(bool discardJournal = true);
 
     // 编辑操作
     void insertText(const std::string& text);
@@ -73,21 +223,62 @@ public:
     void moveToLineEnd();
     void moveWordForward();
     void moveWordBackward();
+    void gotoLine(int lineNumber);
+
+    // 撤销/重做：插入模式的一次会话、一次替换命令各为一个事务
+    bool undo();
+    bool redo();
+    void beginEditGroup();
+    void endEditGroup();
 
     // 模式管理
     void setMode(EditorMode mode);
     EditorMode getMode() const;
 
-    // 新增方法
-    const std::vector<std::string>& getLines() const;
+    // 文本访问：按行读取，正在编辑的行从间隙缓冲区读取
+    int getLineCount() const;
+    std::string getLine(int lineIndex) const;
+    int getLineLength(int lineIndex) const;
+    // 读取一行中从 column 开始的至多 length 字节
+    std::string getLineSegment(int lineIndex, size_t column, size_t length) const;
+    // 直接访问片段表前先写回正在编辑的行
+    const PieceTable& getBuffer();
+    // 文件以内存映射打开时行索引按需建立，访问某行前需先确保它已被索引
+    void ensureLineIndexed(int lineIndex);
+    bool isFullyIndexed() const;
+    // 已索引的原始内容是否全部以 \r\n 换行
+    bool hasDosLineEndings() const;
+
     const std::string& getCurrentFile() const;
     std::string getCurrentLineText() const;
     std::pair<int, int> getCursorPosition() const;
+    int getCursorLine() const;
 
     void startVisualMode(EditorMode visualMode);
     void selectText();
-    bool searchText(const std::string& pattern);
+    // 查找：pattern 为正则表达式，从光标处开始，到达文件一端后从另一端继续
+    bool searchText(const std::string& pattern, bool backward = false);
+    // n / N：沿上次查找的方向（reverse 时反向）查找下一个
+    bool searchNext(bool reverse);
+    // 增量查找：输入模式串的过程中光标随之跳到匹配处，取消时回到起点
+    void beginIncrementalSearch(bool backward);
+    bool updateIncrementalSearch(const std::string& pattern);
+    bool finishIncrementalSearch(const std::string& pattern);
+    void cancelIncrementalSearch();
+    const std::string& getLastSearch() const;
+    // 匹配计数：current 为光标处或之前最近一处匹配的序号（从 1 开始，没有时为 0），
+    // total 为匹配总数；还没有查找过时返回 false
+    bool getMatchCount(size_t& current, size_t& total);
+    // 文件还在载入或新载入的行还没查找完时，匹配计数只覆盖一部分
+    bool isMatchCountPartial() const;
+    // 高亮全部匹配（:set hlsearch）时，取得第 lineIndex 行开始的各匹配的（起始列, 长度）
+    void getLineMatches(int lineIndex, std::vector<std::pair<size_t, size_t> >& matches);
+    // 把 oldText（正则表达式）的匹配替换为 newText，其中 & 和 \0 代表整个匹配，
+    // \1 到 \9 代表分组；global 为 false 时每行只替换第一处
     int replaceText(const std::string& oldText, const std::string& newText, bool global = false);
+    // 只替换起点在第 firstLine 到 lastLine 行（含，从 0 开始）中的匹配，lines 为有替换的行数
+    int replaceText(const std::string& oldText, const std::string& newText, bool global,
+                    int firstLine, int lastLine, int& lines);
 
     void clearLines();
     void addEmptyLine();
@@ -108,6 +299,28 @@ public:
 
     // 添加 deleteText 的重载声明
     void deleteText(DeleteType type);
+
+    // 取出自上次调用以来的变化并清空
+    EditorDamage takeDamage();
+    // 取出命令产生的提示信息（如 :meminfo 的报告）；没有时返回 false
+    bool takeMessage(std::string& message);
+    // 关键字高亮：取得第 lineIndex 行 [column, column + length) 中出现的关键字，
+    // 只扫描这一段（两侧各多扫最长关键字的长度），耗时与行长无关
+    void getLineKeywords(int lineIndex, size_t column, size_t length, std::vector<KeywordSpan>& spans) const;
+    // 语法高亮：取得第 lineIndex 行的词法单元，只补算它之前尚未确定的行
+    void getLineSyntax(int lineIndex, std::vector<SyntaxSpan>& spans);
+    // 排版：第 lineIndex 行的字素簇边界和显示列，光标列（字节偏移）据此换算成显示列
+    const LineLayout& getLineLayout(int lineIndex);
+    int getCursorDisplayColumn();
+    // 第 lineIndex 行显示列 [leftColumn, leftColumn + columns) 的内容，可以直接输出到终端
+    std::string getDisplaySegment(int lineIndex, size_t leftColumn, size_t columns);
+    // 软换行（:set wrap）：第 lineIndex 行按 width 列折行后各屏幕行起始的显示列，末尾为整行宽度
+    bool isWrapEnabled() const;
+    const std::vector<size_t>& getWrapRows(int lineIndex, size_t width);
+    // 光标在其所在行内的第几个屏幕行
+    int getCursorWrapRow(size_t width);
+    // 内存占用报告：存储的文本字节与实际分配的字节
+    std::string getMemoryReport() const;
 };
 
 // 新增 VimEditor 类，继承自 Editor
@@ -0,0 +1,46 @@
+/**
+ * @file editor_loop.h
+ * @brief 把编辑器的后台工作接入事件循环，两种终端界面共用
+ *
+ * 大纲：
+ * 1. 工作线程通过编辑器的通知回调唤醒事件循环
+ * 2. 空闲任务：接上后台载入的行索引
+ * 3. 每轮等待之前检查映射的文件是否被其他程序修改、取回后台保存的结果，
+ *    保存或载入期间定时刷新进度，界面需要重画时绘制一帧
+ */
+#ifndef EDITOR_LOOP_H
+#define EDITOR_LOOP_H
+#include <functional>
+#include <string>
+#include "editor.h"
+#include "event_loop.h"
+
+class EditorLoop {
+public:
+    // 保存结果写入 statusMessage；render 在需要重画时于每轮等待之前调用
+    EditorLoop(EventLoop& loop, Editor& editor, std::string& statusMessage,
+               const std::function<void()>& render);
+    ~EditorLoop();
+
+    // 输入等事件改变了界面，下一轮等待之前重画
+    void markDirty();
+
+private:
+    EventLoop& m_loop;
+    Editor& m_editor;
+    std::string& m_statusMessage;
+    std::function<void()> m_render;
+    bool m_dirty;
+    int m_progressTimer;
+    int m_checkTimer;
+
+    static const int kCheckIntervalMs = 1000;
+
+    bool pollLoad();
+    void beforeWait();
+
+    EditorLoop(const EditorLoop&);
+    EditorLoop& operator=(const EditorLoop&);
+};
+
+#endif // EDITOR_LOOP_H
@@ -0,0 +1,93 @@
+/**
+ * @file event_loop.h
+ * @brief 基于 poll() 的事件循环
+ *
+ * 大纲：
+ * 1. 一次 poll() 同时等待输入文件描述符、唤醒管道和 SIGWINCH 管道
+ * 2. 定时器：到期时在循环线程中调用，可以重复
+ * 3. 跨线程投递：工作线程完成时 post() 一个回调，经唤醒管道叫醒循环
+ * 4. 空闲任务：没有待处理的事件时每轮只执行一个任务的一小段，
+ *    之后立即回到 poll() 检查输入，因此后台工作不增加按键延迟
+ * 5. 每轮等待之前调用 beforeWait 回调，界面在这里绘制一帧
+ *
+ * 所有回调都在调用 run() 的线程中执行。SIGWINCH 的处理函数只向管道写一个字节，
+ * 之前已安装的处理函数（如 ncurses 的）仍会被调用。
+ */
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class EventLoop {
+public:
+    typedef std::function<void()> Callback;
+    // 执行一小段工作，返回是否还有剩余；返回 false 后直到下一个事件之前不再调用
+    typedef std::function<bool()> IdleTask;
+
+    EventLoop();
+    ~EventLoop();
+
+    // fd 可读（或已关闭）时调用 onReadable
+    void watch(int fd, const Callback& onReadable);
+    void unwatch(int fd);
+    // 返回定时器编号；repeat 为 true 时每 milliseconds 毫秒调用一次，直到取消
+    int addTimer(int milliseconds, const Callback& callback, bool repeat);
+    void cancelTimer(int id);
+    void addIdleTask(const IdleTask& task);
+    // 终端尺寸变化时调用
+    void onResize(const Callback& callback);
+    void beforeWait(const Callback& callback);
+
+    // 可以在任何线程中调用：把 callback 交给循环线程执行并唤醒循环
+    void post(const Callback& callback);
+    void run();
+    void quit();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Watch {
+        int fd;
+        Callback callback;
+    };
+    struct Timer {
+        int id;
+        Clock::time_point deadline;
+        Clock::duration interval;
+        Callback callback;
+        bool repeat;
+    };
+    struct Idle {
+        IdleTask task;
+        bool pending;
+    };
+
+    std::vector<Watch> m_watches;
+    std::vector<Timer> m_timers;
+    int m_nextTimer;
+    std::vector<Idle> m_idle;
+    size_t m_nextIdle;
+    Callback m_onResize;
+    Callback m_beforeWait;
+    bool m_quit;
+
+    // post() 投递的回调，由 m_postMutex 保护
+    std::mutex m_postMutex;
+    std::vector<Callback> m_posted;
+    int m_wakePipe[2];
+
+    // 距最近的定时器到期还有多少毫秒，没有定时器时为 -1
+    int timeUntilNextTimer() const;
+    void runTimers();
+    void runPosted();
+    // 执行一个空闲任务的一小段；没有待执行的任务时返回 false
+    bool runIdleSlice();
+    void markIdlePending();
+
+    EventLoop(const EventLoop&);
+    EventLoop& operator=(const EventLoop&);
+};
+
+#endif // EVENT_LOOP_H
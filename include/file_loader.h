@@ -0,0 +1,66 @@
+/**
+ * @file file_loader.h
+ * @brief 后台载入文件
+ *
+ * 大纲：
+ * 1. 在工作线程中按顺序扫描映射的文件内容，统计各片段的换行符（系统同时调入页面）
+ * 2. 扫描完的片段排队，由界面线程取走后接到片段表末尾
+ * 3. 查询进度；打开其他文件或退出时取消
+ *
+ * 工作线程只读取文本块中不会再修改的原始内容，不访问片段表，
+ * 因此界面线程在载入期间可以照常浏览、查找和编辑。
+ */
+#ifndef FILE_LOADER_H
+#define FILE_LOADER_H
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "piece_table.h"
+
+class FileLoader {
+public:
+    FileLoader();
+    ~FileLoader();
+
+    // 开始扫描 [data, data + length)，这段内容属于 block；先取消之前的载入
+    void start(const std::shared_ptr<TextBlock>& block, const char* data, size_t length);
+    // 停止扫描并丢弃尚未取走的结果
+    void cancel();
+    bool isRunning() const;
+    size_t getBytesScanned() const;
+    size_t getTotalBytes() const;
+
+    // 取走已扫描的片段，按文件顺序追加到 pieces 和 crlf；没有新结果时返回 false
+    bool takePieces(std::vector<PieceTable::Piece>& pieces, std::vector<size_t>& crlf);
+    // 队列由空变为非空时在工作线程中调用 callback，用于唤醒界面的事件循环。
+    // 界面取走结果之前不再重复调用，载入期间也可以更换
+    void setProgressCallback(const std::function<void()>& callback);
+
+private:
+    // 一批扫描的字节数，是片段长度上限的整数倍
+    static const size_t kBatchBytes = 1024 * 1024;
+
+    std::thread m_worker;
+    std::shared_ptr<TextBlock> m_block;
+    const char* m_data;
+    size_t m_totalBytes;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_cancel;
+    std::atomic<size_t> m_bytesScanned;
+
+    // 以下由 m_mutex 保护
+    mutable std::mutex m_mutex;
+    std::vector<PieceTable::Piece> m_pieces;
+    std::vector<size_t> m_crlf;
+    std::function<void()> m_onProgress;
+
+    void run();
+
+    FileLoader(const FileLoader&);
+    FileLoader& operator=(const FileLoader&);
+};
+
+#endif // FILE_LOADER_H
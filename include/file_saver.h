@@ -0,0 +1,49 @@
+/**
+ * @file file_saver.h
+ * @brief 文件保存引擎
+ *
+ * 大纲：
+ * 1. 直接以缓冲区片段为单位批量写出（writev），不拼接文本
+ * 2. 先写同目录下的临时文件并 fsync，再原子地 rename 覆盖目标
+ * 3. 保留原文件的权限、属主、属组和扩展属性（包括 ACL）
+ * 4. 替换会改变文件身份的情况改为就地写入：原文件有多个硬链接、临时文件无法
+ *    保持原来的属主或扩展属性、目录不可写而文件可写
+ */
+#ifndef FILE_SAVER_H
+#define FILE_SAVER_H
+#include <atomic>
+#include <functional>
+#include <string>
+#include "piece_table.h"
+
+class FileSaver {
+public:
+    explicit FileSaver(const PieceTable& buffer);
+
+    // 保存缓冲区内容，末尾补一个换行符（缓冲区为空时除外）。错误原因可由 getError() 取得。
+    // 替换方式失败时目标文件保持原样；就地写入不是原子的，写入途中失败时内容可能不完整
+    bool save(const std::string& filename);
+    // 就地写入之前在保存所在的线程中调用，fd 为即将写入的目标文件。
+    // 缓冲区引用着这个文件的映射时，调用方需在这里先把映射复制为私有内存
+    void setBeforeInPlace(const std::function<void(int)>& callback);
+
+    const std::string& getError() const;
+    size_t getBytesWritten() const;
+    // 写入过程中同步更新的已写字节数，供其他线程显示进度
+    void setProgressCounter(std::atomic<size_t>* counter);
+
+private:
+    const PieceTable& m_buffer;
+    std::string m_error;
+    size_t m_bytesWritten;
+    std::atomic<size_t>* m_progress;
+    std::function<void(int)> m_beforeInPlace;
+
+    void reportProgress();
+    bool saveInPlace(const std::string& target);
+
+    bool writeContent(int fd);
+    bool fail(const std::string& message);
+};
+
+#endif // FILE_SAVER_H
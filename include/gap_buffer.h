@@ -0,0 +1,42 @@
+/**
+ * @file gap_buffer.h
+ * @brief 间隙缓冲区：正在编辑的行
+ *
+ * 大纲：
+ * 1. 连续存储的文本中间留一段空隙，空隙跟随编辑位置移动
+ * 2. 在空隙处插入和删除只需移动空隙边界，摊还 O(1)
+ * 3. 空隙用完时按倍数扩容，存储在多次使用之间复用
+ */
+#ifndef GAP_BUFFER_H
+#define GAP_BUFFER_H
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class GapBuffer {
+public:
+    GapBuffer();
+
+    // 清空内容，保留已分配的存储
+    void clear();
+    void append(const char* text, size_t length);
+
+    size_t length() const;
+    char at(size_t position) const;
+    std::string substr(size_t position, size_t length) const;
+
+    void insert(size_t position, const char* text, size_t length);
+    void erase(size_t position, size_t length);
+
+private:
+    std::vector<char> m_data;
+    size_t m_gapStart;
+    size_t m_gapEnd;
+
+    static const size_t kMinGap = 64;
+
+    void moveGap(size_t position);
+    void reserveGap(size_t length);
+};
+
+#endif // GAP_BUFFER_H
@@ -0,0 +1,42 @@
+/**
+ * @file line_scanner.h
+ * @brief 换行符扫描
+ *
+ * 大纲：
+ * 1. 统计换行符（\n）和 \r\n 的个数
+ * 2. 定位第 n 个换行符
+ * 3. 查找子串：先按首尾字节批量过滤候选位置，再逐个比较
+ * 4. 跳过可打印的 ASCII 字符，供排版判断一行是否需要逐字符计算宽度
+ * 5. 扫描实现：AVX2、SSE2 和标量版本，运行时按 CPU 能力选择
+ */
+#ifndef LINE_SCANNER_H
+#define LINE_SCANNER_H
+#include <cstddef>
+
+enum class ScanKernel {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+struct LineBreakCounts {
+    size_t lineFeeds;       // \n 的个数（行分隔符）
+    size_t crlf;            // 其中前面紧跟 \r 的个数
+};
+
+LineBreakCounts countLineBreaks(const char* data, size_t length);
+size_t countLineFeeds(const char* data, size_t length);
+// 第 nth 个（从 1 开始）换行符的位置，不存在时返回 length
+size_t findNthLineFeed(const char* data, size_t length, size_t nth);
+// pattern 第一次出现的位置，不存在时返回 length
+size_t findPattern(const char* data, size_t length, const char* pattern, size_t patternLength);
+// 第一个不是可打印 ASCII 字符（0x20–0x7E）的字节的位置，全是时返回 length
+size_t skipPrintableAscii(const char* data, size_t length);
+
+// 当前 CPU 支持的最快实现；基准测试可以强制指定实现
+ScanKernel bestScanKernel();
+ScanKernel activeScanKernel();
+void setScanKernel(ScanKernel kernel);
+const char* scanKernelName(ScanKernel kernel);
+
+#endif // LINE_SCANNER_H
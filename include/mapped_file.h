@@ -0,0 +1,57 @@
+/**
+ * @file mapped_file.h
+ * @brief 只读内存映射文件
+ *
+ * 大纲：
+ * 1. 以只读方式映射整个文件，小文件不映射，由调用方直接读入内存
+ * 2. 作为片段表的原始文本块使用，页面按需由系统调入
+ * 3. 防护其他程序对文件的修改：
+ *    - 文件被截断后访问映射末尾会收到 SIGBUS，处理函数在出错的位置换上全零的页，
+ *      进程不会崩溃，丢失的内容读作 \0
+ *    - 保留文件描述符，changedOnDisk() 据大小、修改时间和 SIGBUS 判断文件是否被改过；
+ *      发现后 makePrivate() 把每一页复制为进程私有，之后的修改不再影响缓冲区
+ *
+ * 限制：发现修改之前，其他程序就地写入的内容会直接出现在缓冲区中（撤销历史和
+ * 交换文件的偏移可能随之失效），被截断部分的内容无法找回。
+ */
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "piece_table.h"
+
+class MappedTextBlock : public TextBlock {
+public:
+    // 小于这个大小的文件直接读入内存：复制代价可以忽略，也不受其他程序修改的影响
+    static const size_t kMinMappedSize = 16u << 20;
+
+    // 映射失败（包括小文件、受防护的映射已满和不支持映射的平台）时返回空指针，
+    // 调用方应退回普通读取
+    static std::shared_ptr<MappedTextBlock> open(const std::string& filename);
+    ~MappedTextBlock();
+
+    // 映射之后文件是否被其他程序修改或截断；makePrivate() 之后总是返回 false
+    bool changedOnDisk() const;
+    // 把映射的每一页复制为进程私有，内存占用随之变为整个文件的大小；
+    // 可以在任何线程中调用（就地保存时在保存线程中调用）
+    void makePrivate();
+    bool isPrivate() const;
+    // fd 打开的是否就是映射的文件
+    bool refersTo(int fd) const;
+
+private:
+    MappedTextBlock(void* address, size_t length, int fd, int64_t modifiedTime, size_t slot);
+
+    void* m_address;
+    size_t m_length;
+    int m_fd;
+    int64_t m_modifiedTime;
+    size_t m_slot;          // 在 SIGBUS 防护表中的位置
+    std::atomic<bool> m_private;
+    std::mutex m_privateMutex;
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,80 @@
+/**
+ * @file match_index.h
+ * @brief 全文匹配索引
+ *
+ * 大纲：
+ * 1. 把行索引切分给线程池，并行查找一个正则表达式的全部匹配
+ * 2. 匹配按（行, 列）排序存放，可按位置求序号，用于高亮全部匹配和显示匹配计数
+ * 3. 编辑时只把涉及的行标记为待更新，下次查询前重新查找这些行
+ * 4. 文件还在载入时只查找已索引的完整行，之后载入的行由 extend 分段补上
+ *
+ * 模式能匹配换行时，一处编辑可能影响之前各行开始的匹配，此时编辑后整个重建。
+ */
+#ifndef MATCH_INDEX_H
+#define MATCH_INDEX_H
+#include <cstddef>
+#include <vector>
+#include "piece_table.h"
+#include "regex.h"
+
+class ThreadPool;
+
+class MatchIndex {
+public:
+    struct Match {
+        size_t line;
+        size_t column;  // 行内起始字节
+        size_t length;  // 能匹配换行的模式，长度可以超过行尾
+    };
+
+    MatchIndex();
+
+    // 按 regex 查找 buffer 中已索引的各行的全部匹配并重建索引
+    void build(const PieceTable& buffer, const Regex& regex, ThreadPool& pool);
+    void clear();
+    bool isActive() const;
+    const Regex& regex() const;
+
+    // 编辑后调用：从 line 行开始删除了 removedLines 个换行、插入了 insertedLines 个，
+    // 涉及的行待重新查找，其后各行的匹配随之移动
+    void applyEdit(size_t line, size_t removedLines, size_t insertedLines);
+    // 只修改了 line 行的内容
+    void invalidateLine(size_t line);
+    // 重新查找待更新的行；查询前调用
+    void refresh(const PieceTable& buffer, ThreadPool& pool);
+    // 接着查找新近完整的行，一次至多约 maxBytes 字节
+    void extend(const PieceTable& buffer, ThreadPool& pool, size_t maxBytes);
+    // 已查找过的行数，其后的行尚未查找
+    size_t coveredLines() const;
+    bool isBehind(const PieceTable& buffer) const;
+
+    size_t count() const;
+    // 起点不晚于 (line, column) 的匹配个数，即光标处或之前最近一处匹配的序号（从 1 开始）
+    size_t ordinalAt(size_t line, size_t column) const;
+    // line 行开始的匹配，返回 [first, last) 两个下标
+    std::pair<size_t, size_t> lineRange(size_t line) const;
+    const Match& at(size_t index) const;
+
+private:
+    Regex m_regex;
+    bool m_active;
+    bool m_rebuild;             // 需要整个重建
+    std::vector<Match> m_matches;
+    std::vector<size_t> m_staleLines;
+    // 已查找过的行数；载入期间最后一个已索引的行可能还不完整，等它补全后再查找
+    size_t m_coveredLines;
+
+    // 待更新的行超过这个数时并行查找
+    static const size_t kParallelThreshold = 4096;
+
+    static size_t completeLines(const PieceTable& buffer);
+    // 按字节数把 [firstLine, lastLine) 均分给线程池查找，匹配追加到 m_matches
+    void scanRange(const PieceTable& buffer, size_t firstLine, size_t lastLine, ThreadPool& pool);
+    // 查找起点在 [firstLine, lastLine) 各行中的匹配，追加到 out
+    void scanLines(const PieceTable& buffer, RegexMatcher& matcher, size_t firstLine, size_t lastLine,
+                   std::vector<Match>& out) const;
+    void scanParallel(const PieceTable& buffer, const std::vector<std::pair<size_t, size_t> >& ranges,
+                      ThreadPool& pool, std::vector<Match>& out) const;
+};
+
+#endif // MATCH_INDEX_H
@@ -0,0 +1,222 @@
+/**
+ * @file piece_table.h
+ * @brief 片段表（piece table）文本缓冲区
+ *
+ * 大纲：
+ * 1. 文本块：原始文件内容和只追加缓冲区
+ * 2. 片段表类声明
+ *    - 按字节偏移插入和删除
+ *    - 行号与偏移的换算
+ *    - 不复制文本的片段迭代器
+ * 3. 私有成员
+ *    - 平衡树（treap）存放的片段序列
+ *    - 文本块所有权
+ */
+#ifndef PIECE_TABLE_H
+#define PIECE_TABLE_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 文本块：一段连续字节，已写入的内容永不移动或修改，
+// 因此片段可以直接持有指向其中的指针
+class TextBlock {
+public:
+    explicit TextBlock(size_t capacity);
+    TextBlock(const char* text, size_t length);
+    virtual ~TextBlock() {}
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t available() const { return m_capacity - m_size; }
+
+    // 追加字节，返回写入位置；调用方需保证剩余容量足够
+    const char* append(const char* text, size_t length);
+
+protected:
+    // 供子类接管外部内存（如内存映射），此时块为只读
+    TextBlock();
+
+    const char* m_data;
+    size_t m_size;
+    size_t m_capacity;
+
+private:
+    std::unique_ptr<char[]> m_bytes;
+
+    TextBlock(const TextBlock&);
+    TextBlock& operator=(const TextBlock&);
+};
+
+class PieceTable {
+private:
+    struct Node;
+    typedef std::shared_ptr<const Node> NodePtr;
+
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    // 片段：指向某个文本块中的一段字节
+    struct Piece {
+        const char* data;
+        size_t length;
+        size_t lineFeeds;   // 片段内换行符个数
+    };
+
+    // 原始内容中已索引部分的换行统计，用于识别 \r\n 换行的文件
+    struct LineBreakSummary {
+        size_t lineFeeds;
+        size_t crlf;
+    };
+
+    // 内存占用统计
+    struct MemoryStats {
+        size_t textBytes;           // 文本总长度
+        size_t originalBytes;       // 原始内容（文件）占用
+        size_t addBytesUsed;        // 追加缓冲区已写入的字节
+        size_t addBytesAllocated;   // 追加缓冲区已分配的字节
+        size_t pieces;
+        size_t pieceBytes;          // 树节点占用（估算）
+    };
+
+    // 偏移对应的行列位置（列为行内字节偏移）
+    struct Position {
+        size_t line;
+        size_t column;
+    };
+
+    // 按顺序遍历一段字节范围内的连续片段，不复制文本。
+    // 与标准容器的迭代器一样，缓冲区修改后迭代器失效
+    class SpanIterator {
+    public:
+        bool next(const char*& data, size_t& length);
+
+    private:
+        friend class PieceTable;
+        std::vector<const Node*> m_stack;
+        size_t m_skip;
+        size_t m_remaining;
+
+        const char* m_tail;
+        size_t m_tailLength;
+
+        SpanIterator(const Node* root, size_t offset, size_t length,
+                     const char* tail, size_t tailLength);
+        void pushLeftPath(const Node* node);
+    };
+
+    PieceTable();
+
+    // 以给定内容重置缓冲区（作为只读的原始缓冲区）
+    void reset(const char* text, size_t length);
+    // 直接采用文本块的前 length 字节作为原始缓冲区，不复制，也暂不建立行索引
+    void adopt(const std::shared_ptr<TextBlock>& original, size_t length);
+    void clear();
+
+    // 惰性行索引：尚未索引的原始内容作为文本末尾的一段待处理区域，
+    // 可以读取和保存，但行号换算只覆盖已索引的部分
+    size_t indexMore(size_t maxBytes);
+    void indexAll();
+    bool isFullyIndexed() const;
+    size_t indexedLength() const;
+    const char* pendingData() const;
+    size_t pendingLength() const;
+    // 把原始内容的一段按片段长度上限切开并统计换行，结果追加到 pieces 和 crlf
+    // （各片段内的 \r\n 个数）。不访问任何缓冲区，可以在工作线程中调用
+    static void scanOriginal(const char* data, size_t length, std::vector<Piece>& pieces,
+                             std::vector<size_t>& crlf);
+    // 接上 scanOriginal 对待处理区域的统计结果。编辑等操作可能已经同步索引了其中一部分，
+    // 这部分跳过；与待处理区域开头不相接的结果丢弃。返回新索引的字节数
+    size_t appendScanned(const std::vector<Piece>& pieces, const std::vector<size_t>& crlf);
+    LineBreakSummary originalLineBreaks() const;
+
+    void insert(size_t offset, const char* text, size_t length);
+    void insert(size_t offset, const std::string& text);
+    void erase(size_t offset, size_t length);
+
+    size_t length() const;
+    size_t lineCount() const;
+    size_t pieceCount() const;
+
+    // 以下换算都只沿树下降一次，再在单个片段内扫描，耗时 O(log n)；
+    // 未完全索引时 lineCount() 只计算已索引部分
+    // 行首偏移；line 超出已索引的行时返回 indexedLength()（完全索引后即 length()）
+    size_t lineStart(size_t line) const;
+    // 行长度，不含换行符
+    size_t lineLength(size_t line) const;
+    // 偏移所在的行号
+    size_t lineOfOffset(size_t offset) const;
+    Position positionOf(size_t offset) const;
+    size_t offsetOf(size_t line, size_t column) const;
+
+    SpanIterator spans(size_t offset, size_t length) const;
+    std::string substr(size_t offset, size_t length) const;
+    std::string getLine(size_t line) const;
+    char at(size_t offset) const;
+    // 包含 offset 的一段连续字节（一个片段或待处理区域），start 为这段的起始偏移；
+    // offset 超出范围时 length 为 0
+    void chunkAt(size_t offset, const char*& data, size_t& length, size_t& start) const;
+
+    // 在 [from, to) 中查找完整落在范围内的 pattern，
+    // 返回第一个（find）或最后一个（rfind）匹配的起始偏移，没有时返回 npos
+    size_t find(const std::string& pattern, size_t from = 0, size_t to = npos) const;
+    size_t rfind(const std::string& pattern, size_t from = 0, size_t to = npos) const;
+
+    MemoryStats memoryStats() const;
+
+private:
+    struct Node {
+        Piece piece;
+        uint32_t priority;
+        NodePtr left;
+        NodePtr right;
+        size_t length;      // 子树总字节数
+        size_t lineFeeds;   // 子树换行符总数
+        size_t pieces;      // 子树片段数
+    };
+
+    // 节点一经创建便不再修改，修改操作沿路径复制节点，
+    // 因此复制整个 PieceTable 只需复制根指针和文本块列表。
+    // 副本不再修改时可作为快照交给其他线程只读访问：
+    // 原表之后的追加只写入文本块中尚未被引用的位置
+
+    NodePtr m_root;
+    std::vector<std::shared_ptr<TextBlock> > m_blocks;
+    size_t m_originalBytes;
+    std::shared_ptr<TextBlock> m_addBlock;
+    const char* m_pending;          // 尚未建立索引的原始内容
+    size_t m_pendingLength;
+    bool m_pendingAfterCR;          // 已索引部分是否以 \r 结尾
+    LineBreakSummary m_originalBreaks;
+    uint32_t m_seed;
+
+    static const size_t kAddBlockSize = 64 * 1024;
+    static const size_t kMaxPieceLength = 64 * 1024;
+    // 一次索引的数据超过此大小时并行扫描
+    static const size_t kParallelIndexBytes = 8 * 1024 * 1024;
+    // 反向查找时每次正向扫描的窗口大小
+    static const size_t kSearchWindow = 1024 * 1024;
+
+    uint32_t nextPriority();
+    Piece appendToAddBuffer(const char* text, size_t length);
+    void appendText(NodePtr& left, const char* text, size_t length);
+    void ensureIndexed(size_t offset);
+    // 已统计的片段接到树的末尾，待处理区域随之缩短；pieces 须从待处理区域开头连续排列
+    void appendPieces(const std::vector<Piece>& pieces, const std::vector<size_t>& crlf);
+
+    static NodePtr makeNode(const Piece& piece, uint32_t priority,
+                            const NodePtr& left, const NodePtr& right);
+    static size_t lengthOf(const NodePtr& node);
+    static size_t lineFeedsOf(const NodePtr& node);
+    static size_t piecesOf(const NodePtr& node);
+    static NodePtr merge(const NodePtr& left, const NodePtr& right);
+    static void split(const NodePtr& node, size_t offset, NodePtr& left, NodePtr& right);
+    static bool extendLast(const NodePtr& node, const char* end, size_t length, NodePtr& result);
+
+    NodePtr buildTree(const std::vector<Piece>& pieces);
+    static Piece makePiece(const char* data, size_t length);
+};
+
+#endif // PIECE_TABLE_H
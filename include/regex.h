@@ -0,0 +1,137 @@
+/**
+ * @file regex.h
+ * @brief 正则表达式引擎
+ *
+ * 大纲：
+ * 1. 匹配输入：可由多段不连续的内存组成（如片段表）
+ * 2. 编译后的正则表达式：不可变，可在线程间共享
+ * 3. 匹配器：惰性 DFA 的状态缓存和 NFA 模拟的工作区，每个线程各用一个
+ *
+ * 语法：字面字符、. [...] [^...] \d \w \s \D \W \S \n \t \xHH、
+ * * + ? {n} {n,} {n,m} 及其非贪婪形式、|、(...)、(?:...)、^ $（行首、行尾）。
+ * . 和取反的字符类按 UTF-8 字符匹配，且不匹配换行；只有显式写出 \n 的模式才能跨行。
+ *
+ * 模式串先编译成 Thompson NFA 程序。查找时正向惰性 DFA 找到最左匹配的终点，
+ * 反向 DFA 从终点找回起点；需要分组时再在匹配范围内做一次 NFA 模拟（Pike VM）。
+ * DFA 状态在用到时才构造并缓存，缓存超出上限时清空重建，频繁重建时改用 NFA 模拟。
+ * 每个字节的处理耗时与输入无关，总耗时与输入长度成线性关系，不会回溯。
+ */
+#ifndef REGEX_H
+#define REGEX_H
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "piece_table.h"
+
+// 匹配输入：按偏移取得连续的字节段
+class RegexInput {
+public:
+    virtual ~RegexInput() {}
+    virtual size_t length() const = 0;
+    // 包含 offset 的一段连续字节，start 为这段在输入中的起始偏移；offset 须小于 length()
+    virtual void chunkAt(size_t offset, const char*& data, size_t& length, size_t& start) const = 0;
+};
+
+// 一整块连续内存
+class MemoryInput : public RegexInput {
+public:
+    MemoryInput(const char* data, size_t length) : m_data(data), m_length(length) {}
+    size_t length() const { return m_length; }
+    void chunkAt(size_t, const char*& data, size_t& length, size_t& start) const {
+        data = m_data;
+        length = m_length;
+        start = 0;
+    }
+
+private:
+    const char* m_data;
+    size_t m_length;
+};
+
+// 片段表：每段是一个片段，不复制文本
+class PieceTableInput : public RegexInput {
+public:
+    explicit PieceTableInput(const PieceTable& table) : m_table(table), m_length(table.length()) {}
+    size_t length() const { return m_length; }
+    void chunkAt(size_t offset, const char*& data, size_t& length, size_t& start) const {
+        m_table.chunkAt(offset, data, length, start);
+    }
+
+private:
+    const PieceTable& m_table;
+    size_t m_length;
+};
+
+struct RegexMatch {
+    static const size_t npos = static_cast<size_t>(-1);
+
+    size_t start;
+    size_t end;
+    // 分组 i 的范围为 [groups[2i], groups[2i+1])，分组 0 是整个匹配；
+    // 未参与匹配的分组为 npos
+    std::vector<size_t> groups;
+
+    size_t length() const { return end - start; }
+};
+
+struct RegexProgram;
+class RegexDfa;
+
+class Regex {
+public:
+    Regex();
+
+    // 编译失败时返回 false，error 为错误说明
+    bool compile(const std::string& pattern, std::string& error);
+    bool isCompiled() const;
+    const std::string& pattern() const;
+    // 捕获分组个数，不含分组 0
+    size_t groupCount() const;
+    // 模式串不含元字符时可以直接按字面查找，literal() 为要查找的字节串
+    bool isLiteral() const;
+    const std::string& literal() const;
+    // 模式中显式写出了换行，匹配可能跨行
+    bool matchesLineFeed() const;
+
+private:
+    friend class RegexMatcher;
+
+    std::string m_pattern;
+    std::string m_literal;
+    bool m_isLiteral;
+    size_t m_groups;
+    std::shared_ptr<const RegexProgram> m_forward;
+    std::shared_ptr<const RegexProgram> m_reverse;
+};
+
+class RegexMatcher {
+public:
+    explicit RegexMatcher(const Regex& regex);
+    ~RegexMatcher();
+
+    // 查找完全落在 [from, to) 中的第一个匹配（最左，分支按书写顺序优先）。
+    // ^ $ 按整个输入判断，from 和 to 只限制匹配的范围。
+    // wantGroups 为 false 时 match.groups 只含分组 0
+    bool search(const RegexInput& input, size_t from, size_t to, RegexMatch& match,
+                bool wantGroups = false);
+    // 查找起点在 [from, to) 中的最后一个匹配，匹配本身可以延伸到 to 之后
+    bool searchLast(const RegexInput& input, size_t from, size_t to, RegexMatch& match,
+                    bool wantGroups = false);
+
+private:
+    Regex m_regex;
+    std::unique_ptr<RegexDfa> m_forward;
+    std::unique_ptr<RegexDfa> m_reverse;
+
+    // 反向查找时每次正向扫描的窗口大小
+    static const size_t kSearchWindow = 1024 * 1024;
+
+    bool simulate(const RegexInput& input, size_t from, size_t to, bool anchored,
+                  bool wantGroups, RegexMatch& match) const;
+
+    RegexMatcher(const RegexMatcher&);
+    RegexMatcher& operator=(const RegexMatcher&);
+};
+
+#endif // REGEX_H
@@ -0,0 +1,69 @@
+/**
+ * @file renderer.h
+ * @brief 把编辑器的状态绘制到 Screen
+ *
+ * 大纲：
+ * 1. 视口跟随光标，只绘制可见的行
+ * 2. 记录上一帧绘制的内容，只重绘变化的行、屏幕行和状态栏
+ * 3. 一行内依次叠加当前行反显、语法高亮、关键字和查找匹配
+ * 4. 把终端光标放到光标所在字素簇的第一列
+ *
+ * 与具体的终端无关：NCursesUI 用它绘制到 ncurses，基准测试绘制到虚拟终端。
+ */
+#ifndef RENDERER_H
+#define RENDERER_H
+#include "editor.h"
+#include "screen.h"
+#include "viewport.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+class Renderer {
+public:
+    Renderer(Editor& editor, Screen& screen);
+
+    // 绘制一帧；statusMessage 为状态栏末尾的提示或正在输入的命令行
+    void renderFrame(const std::string& statusMessage);
+    // 下一帧整屏重绘（如终端内容被外部破坏后）
+    void invalidate();
+
+    Viewport& viewport();
+    // 软换行时一行折成的屏幕行数，按当前的视口宽度计算
+    Viewport::RowCounter rowCounter();
+
+private:
+    Editor& m_editor;
+    Screen& m_screen;
+    Viewport m_viewport;
+
+    // 上一帧实际绘制的状态，用于判断本帧需要重绘的部分
+    bool m_fullRedraw;
+    int m_drawnTopLine;
+    int m_drawnLeftColumn;
+    int m_drawnCursorLine;
+    // 软换行时各屏幕行显示的（行, 行内屏幕行），没有内容的屏幕行为 (-1, 0)
+    bool m_drawnWrap;
+    std::vector<std::pair<int, int> > m_drawnRows;
+    std::vector<std::pair<int, int> > m_screenRows;
+    std::string m_drawnStatus;
+    int m_drawnStatusColor;
+
+    // 绘制一行时取得的查找匹配，复用以免每行分配
+    std::vector<std::pair<size_t, size_t> > m_lineMatches;
+    std::vector<KeywordSpan> m_lineKeywords;
+    std::vector<SyntaxSpan> m_lineSyntax;
+
+    void renderContent(const EditorDamage& damage);
+    void renderWrapped(const EditorDamage& damage, int cursorLine);
+    void renderLine(int line, bool current);
+    // 在屏幕第 row 行画出第 line 行显示列 [left, left + columns) 的内容
+    void renderRow(int row, int line, size_t left, size_t columns, bool current);
+    void paintSpan(int row, const LineLayout& layout, size_t left, size_t right, size_t column, size_t length,
+                   bool reverse, short pair);
+    void placeCursor();
+    void renderStatusBar(const std::string& statusMessage);
+    std::string getModeString();
+};
+
+#endif // RENDERER_H
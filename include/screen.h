@@ -0,0 +1,63 @@
+/**
+ * @file screen.h
+ * @brief 绘制目标：编辑区和状态栏的抽象
+ *
+ * 大纲：
+ * 1. 颜色对编号：模式、查找匹配、关键字和语法高亮，以及各颜色对的前景色和背景色
+ * 2. 按行写入已排版的文本，再按列改变属性
+ * 3. 每帧结束时输出到终端（或内存）
+ *
+ * Renderer 只通过这个接口绘制，终端实现（ncurses）和内存中的虚拟终端
+ * 可以互换，后者用于基准测试和没有终端的环境。
+ */
+#ifndef SCREEN_H
+#define SCREEN_H
+#include <string>
+
+class Screen {
+public:
+    // 状态栏按模式使用的颜色对
+    static const short kNormalPair = 1;
+    static const short kInsertPair = 2;
+    static const short kCommandPair = 3;
+    static const short kVisualPair = 4;
+    // 查找匹配高亮
+    static const short kMatchPair = 5;
+    // 高亮关键字使用的颜色对：从 kKeywordPair 开始共 kKeywordColors 个
+    static const short kKeywordPair = 6;
+    static const short kKeywordColors = 6;
+    // 语法高亮的颜色对：kSyntaxPair + 词法单元种类
+    static const short kSyntaxPair = 12;
+
+    // 颜色编号，与 ANSI 和 ncurses 的颜色编号相同
+    static const short kBlack = 0;
+    static const short kRed = 1;
+    static const short kGreen = 2;
+    static const short kYellow = 3;
+    static const short kBlue = 4;
+    static const short kMagenta = 5;
+    static const short kCyan = 6;
+    static const short kWhite = 7;
+
+    // 颜色对 pair 的前景色和背景色；pair 为 0（默认颜色）或超出已定义的范围时返回 false
+    static bool pairColors(short pair, short& foreground, short& background);
+
+    virtual ~Screen() {}
+
+    // 编辑区的行数和列数，不含状态栏
+    virtual int rows() const = 0;
+    virtual int columns() const = 0;
+
+    // 清除整个编辑区
+    virtual void clear() = 0;
+    // 清除编辑区第 row 行，再从行首写入 text；text 已排版，显示宽度不超过 columns()
+    virtual void drawRow(int row, const std::string& text) = 0;
+    // 改变第 row 行 [column, column + count) 列的属性，count 为 -1 时到行尾；pair 为 0 时使用默认颜色
+    virtual void setStyle(int row, int column, int count, bool reverse, short pair) = 0;
+    virtual void drawStatus(const std::string& text, short pair) = 0;
+    virtual void setCursor(int row, int column) = 0;
+    // 一帧结束：把本帧的改动一次输出
+    virtual void present() = 0;
+};
+
+#endif // SCREEN_H
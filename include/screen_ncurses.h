@@ -0,0 +1,44 @@
+/**
+ * @file screen_ncurses.h
+ * @brief 基于 ncurses 的终端绘制目标
+ *
+ * 大纲：
+ * 1. 初始化 ncurses、颜色对和括号粘贴，创建编辑区和状态栏两个窗口
+ * 2. 绘制操作映射到窗口，一帧结束时 doupdate 一次输出
+ */
+#ifndef SCREEN_NCURSES_H
+#define SCREEN_NCURSES_H
+#include "screen.h"
+#include <ncurses.h>
+#include <string>
+
+class NCursesScreen : public Screen {
+public:
+    // 括号粘贴（bracketed paste）的起止序列映射成的键码
+    static const int kKeyPasteBegin = KEY_MAX + 1;
+    static const int kKeyPasteEnd = KEY_MAX + 2;
+
+    NCursesScreen();
+    ~NCursesScreen();
+
+    int rows() const;
+    int columns() const;
+    void clear();
+    void drawRow(int row, const std::string& text);
+    void setStyle(int row, int column, int count, bool reverse, short pair);
+    void drawStatus(const std::string& text, short pair);
+    void setCursor(int row, int column);
+    void present();
+
+    // getch() 返回 KEY_RESIZE 后调用：按新的终端尺寸调整窗口
+    void resize();
+    // 退出前恢复终端；可以重复调用
+    void close();
+
+private:
+    WINDOW* m_mainWin;
+    WINDOW* m_statusWin;
+    bool m_open;
+};
+
+#endif // SCREEN_NCURSES_H
@@ -0,0 +1,132 @@
+/**
+ * @file syntax.h
+ * @brief 语法高亮
+ *
+ * 大纲：
+ * 1. 词法单元种类和语言描述表（C/C++、JSON、YAML、日志）
+ * 2. 由语言描述表驱动的逐行词法分析
+ * 3. 每行结束时的词法状态缓存：编辑后从修改的行开始重新分析，
+ *    直到某行的结束状态与缓存一致，之后各行的缓存仍然有效
+ *
+ * 状态只在需要时计算：绘制某行前补算它之前尚未确定的各行，
+ * 因此只高亮视口中的行，输入时的开销与文件长度无关。
+ * 每行只分析前 kMaxColumns 个字节（同 vim 的 synmaxcol），超长的行之后的部分不高亮，
+ * 输入时的开销也就与行的长度无关；代价是块注释的开头出现在这之后时不影响后面的行。
+ */
+#ifndef SYNTAX_H
+#define SYNTAX_H
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class SyntaxKind : unsigned char {
+    NORMAL,
+    KEYWORD,
+    TYPE,
+    STRING,
+    NUMBER,
+    COMMENT,
+    PREPROCESSOR,
+    KEY,        // JSON/YAML 的键
+    ERROR,      // 日志级别
+    WARNING,
+    INFO
+};
+
+struct SyntaxSpan {
+    size_t column;
+    size_t length;
+    SyntaxKind kind;
+};
+
+struct SyntaxWord {
+    const char* word;
+    SyntaxKind kind;
+};
+
+// 键的写法：JSON 为 "key":，YAML 为行首的 key:
+enum class SyntaxKeys {
+    NONE,
+    QUOTED,
+    PLAIN
+};
+
+// 一种语言的描述表，未用到的字段为 NULL
+struct SyntaxLanguage {
+    const char* name;
+    const char* extensions;     // 以空格分隔，如 ".c .h"
+    const SyntaxWord* words;    // 以 { NULL } 结尾
+    const char* lineComment;
+    const char* blockOpen;
+    const char* blockClose;
+    const char* quotes;
+    const char* numberChars;    // 数字中除字母和数字外还可以出现的字符
+    bool preprocessor;          // # 开头的行是预处理指令
+    SyntaxKeys keys;
+};
+
+class SyntaxHighlighter {
+public:
+    // 按行号取得一行开头至多 maxLength 个字节
+    typedef std::function<std::string(size_t line, size_t maxLength)> LineSource;
+
+    static const size_t kMaxColumns = 3000;
+
+    SyntaxHighlighter();
+
+    static const SyntaxLanguage* languageForFile(const std::string& filename);
+    static const SyntaxLanguage* languageByName(const std::string& name);
+
+    // language 为 NULL 时关闭高亮
+    void setLanguage(const SyntaxLanguage* language);
+    const SyntaxLanguage* language() const;
+
+    // 内容整个替换后调用
+    void reset();
+    // 编辑后调用：从 line 行开始删除了 removedLines 个换行、插入了 insertedLines 个
+    void applyEdit(size_t line, size_t removedLines, size_t insertedLines);
+    void invalidateLine(size_t line);
+    // 编辑后第 line 行结束时的状态是否与缓存不同（如输入了 /*），不同时其后各行的高亮都可能变化
+    bool endStateChanged(size_t line, const LineSource& source);
+
+    // 分析第 line 行，spans 为其中的词法单元（不含普通文本）；
+    // 刚由 endStateChanged() 或 highlight() 分析过且之后没有编辑时沿用上次的结果
+    void highlight(size_t line, const LineSource& source, std::vector<SyntaxSpan>& spans);
+
+private:
+    enum CharClass {
+        CHAR_OTHER,
+        CHAR_IDENT,
+        CHAR_DIGIT,
+        CHAR_QUOTE
+    };
+    // 行结束时的状态
+    enum LexState {
+        STATE_NORMAL,
+        STATE_BLOCK_COMMENT
+    };
+
+    const SyntaxLanguage* m_language;
+    unsigned char m_classOf[256];
+    std::unordered_map<std::string, SyntaxKind> m_words;
+
+    // m_states[i] 为第 i 行结束时的状态，前 m_known 行算过；
+    // m_firstStale 之前的都有效，从它到 m_lastEdit 的各行被编辑过，需要重新分析
+    std::vector<unsigned char> m_states;
+    size_t m_known;
+    size_t m_firstStale;
+    size_t m_lastEdit;
+    // 最近分析过的一行的词法单元：输入后先比较行尾状态、再绘制，同一行不必分析两遍
+    std::vector<SyntaxSpan> m_lineSpans;
+    size_t m_spansLine;
+    bool m_spansValid;
+
+    unsigned char startState(size_t line, const LineSource& source);
+    // 以 state 开始分析一行，返回行尾的状态；spans 为 NULL 时只求状态
+    unsigned char lex(const std::string& text, unsigned char state, std::vector<SyntaxSpan>* spans) const;
+    size_t lexPlainKey(const std::string& text, std::vector<SyntaxSpan>* spans) const;
+};
+
+#endif // SYNTAX_H
@@ -0,0 +1,115 @@
+/**
+ * @file text_layout.h
+ * @brief 文本排版：字素簇边界和显示宽度
+ *
+ * 大纲：
+ * 1. 码点的显示宽度：东亚宽字符占 2 列，组合符号等占 0 列
+ * 2. 一行的排版：各字素簇的起始字节和起始显示列，制表符展开到下一个制表位
+ * 3. 按行缓存排版结果，编辑后只丢弃受影响的行；行内的编辑就地更新缓存：
+ *    从编辑处之前的字素簇重新排版到与原来的字素簇重新对齐为止，其后的只平移，
+ *    长行上输入时不必取出整行重新排版
+ *
+ * 光标仍以字节偏移表示，移动和绘制时经排版换算成字素簇和显示列。
+ * 成段的可打印 ASCII 用 SIMD 扫描跳过，只记录其他的字素簇，其间的字节偏移与显示列
+ * 一一对应，纯 ASCII 的行不占额外内存，就地更新时需要平移的记录也只有这些字素簇。字素簇按常见规则近似：组合符号、变体选择符、
+ * 肤色修饰符附着在前一个字符上，零宽连接符连接前后两个字符，区域指示符两两成对。
+ * 不是合法 UTF-8 的字节各自成簇，显示为 ?。
+ */
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 码点的显示宽度：0、1 或 2
+int codePointWidth(unsigned long codePoint);
+
+class LineLayout {
+public:
+    static const size_t kTabStop = 8;
+    // 按行内偏移取得编辑后的一段内容，超出行尾的部分截掉
+    typedef std::function<std::string(size_t start, size_t length)> SegmentSource;
+
+    LineLayout();
+
+    void build(const char* data, size_t length);
+    // 行内从 column 开始的 removed 个字节换成了 inserted 个字节，source 提供编辑后的内容；
+    // 在编辑之后一小段内没能与原来的字素簇对齐时返回 false，由调用方重新排版
+    bool applyEdit(size_t column, size_t removed, size_t inserted, const SegmentSource& source);
+
+    size_t length() const;
+    // 整行的显示宽度
+    size_t width() const;
+
+    // 字节偏移所在字素簇的起点
+    size_t clusterStart(size_t byte) const;
+    // 下一个/上一个字素簇的起点，已在行尾/行首时不动
+    size_t nextCluster(size_t byte) const;
+    size_t previousCluster(size_t byte) const;
+    // 字节偏移所在字素簇的起始显示列；byte 为行长时返回整行宽度
+    size_t columnOf(size_t byte) const;
+    // 覆盖显示列 column 的字素簇的起点；column 超出行宽时返回行长
+    size_t byteAt(size_t column) const;
+
+    // 把 [leftColumn, leftColumn + columns) 列的内容转换成可以直接输出的文本：
+    // 制表符展开成空格，控制字符显示为 ^X，被视口边缘截断的宽字符用空格补齐。
+    // segment 为该行从 segmentStart 字节开始的内容，须覆盖这几列涉及的字素簇
+    void render(const std::string& segment, size_t segmentStart, size_t leftColumn, size_t columns,
+                std::string& out) const;
+
+private:
+    // 不是单个可打印 ASCII 字符的字素簇：多字节字符、宽字符、制表符、控制字符，
+    // 以及带组合符号等的字符
+    struct Cluster {
+        size_t start;
+        size_t end;
+        size_t column;
+        size_t endColumn;
+        bool tab;           // 宽度随起始列变化
+    };
+    struct State;
+
+    size_t m_length;
+    size_t m_width;
+    // 按位置排列的不规则字素簇；它们之间的字节都各自成簇，字节与显示列一一对应
+    std::vector<Cluster> m_clusters;
+
+    // 就地更新时，编辑之后至多再排版这么多字节等待对齐
+    static const size_t kResyncBytes = 256;
+
+    // 起点不晚于 byte 的不规则字素簇个数
+    size_t clusterIndex(size_t byte) const;
+    static bool startsBefore(const Cluster& cluster, size_t byte);
+    static size_t layoutCodePoint(const char* data, size_t available, size_t position, size_t lineLength,
+                                  State& state, std::vector<Cluster>& clusters);
+    static void closeCluster(State& state, std::vector<Cluster>& clusters);
+};
+
+class TextLayout {
+public:
+    // 按行号取得一行的文本
+    typedef std::function<std::string(size_t)> LineSource;
+
+    TextLayout();
+
+    // 取得第 line 行的排版，不在缓存中时从 source 取文本计算
+    const LineLayout& line(size_t line, const LineSource& source);
+
+    void clear();
+    // 编辑后调用：从 line 行开始删除了 removedLines 个换行、插入了 insertedLines 个
+    void applyEdit(size_t line, size_t removedLines, size_t insertedLines);
+    void invalidateLine(size_t line);
+    // 行内的编辑：缓存中有这一行时就地更新，更新不了时丢弃
+    void editLine(size_t line, size_t column, size_t removed, size_t inserted,
+                  const LineLayout::SegmentSource& source);
+
+private:
+    // 缓存的行数超过这么多时整个清空，视口中的行总能放下
+    static const size_t kCacheLines = 1024;
+
+    std::unordered_map<size_t, LineLayout> m_lines;
+};
+
+#endif // TEXT_LAYOUT_H
@@ -0,0 +1,61 @@
+/**
+ * @file thread_pool.h
+ * @brief 固定大小的线程池
+ *
+ * 大纲：
+ * 1. 提交任务并取得 future
+ * 2. 把区间切分给各线程并行执行
+ * 3. 进程共享的默认线程池
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool {
+public:
+    // threads 为 0 时使用硬件线程数
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    size_t size() const;
+
+    template <typename F>
+    std::future<typename std::result_of<F()>::type> submit(F task) {
+        typedef typename std::result_of<F()>::type Result;
+        std::shared_ptr<std::packaged_task<Result()> > job =
+            std::make_shared<std::packaged_task<Result()> >(task);
+        std::future<Result> result = job->get_future();
+        enqueue([job]() { (*job)(); });
+        return result;
+    }
+
+    // 把 [0, count) 切成若干连续区间，由各线程执行 body(begin, end)，
+    // 调用线程也参与执行，返回时全部区间已完成。
+    // 不要在本线程池的任务中调用，否则可能因等待自身而死锁
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body);
+
+    static ThreadPool& shared();
+
+private:
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()> > m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_stopping;
+
+    void enqueue(const std::function<void()>& job);
+    void workerLoop();
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif // THREAD_POOL_H
@@ -4,23 +4,46 @@
  * 
  * 大纲：
  * 1. 定义UI类
- * 2. 终端渲染方法
- * 3. 用户输入处理
+ * 2. 终端渲染方法：经 Renderer 绘制到 AnsiScreen，每帧只输出变化的部分
+ * 3. 用户输入处理：终端只在启动时切换到原始模式一次，
+ *    由事件循环同时等待输入、终端尺寸变化和后台工作
  * 4. 状态栏和消息显示
+ *
+ * 不依赖 ncurses，没有安装 ncurses 时使用这个界面。
  */
 #ifndef UI_H
 #define UI_H
 #include <string>
+#ifndef _WIN32
+#include <termios.h>
+#endif
+#include "../include/ansi_screen.h"
 #include "../include/editor.h"
+#include "../include/renderer.h"
 class UI {
 public:
     UI(Editor& editor);
+    ~UI();
+    void run();
     void render();
+    // 阻塞读取一个按键并处理
     void handleInput();
-    void displayStatusBar();
+    void handleKey(int ch);
     void displayMessage(const std::string& message);
 private:
     Editor& m_editor;
     std::string m_statusMessage;
+    AnsiScreen m_screen;
+    Renderer m_renderer;
+    bool m_quit;
+    #ifndef _WIN32
+    bool m_rawMode;
+    struct termios m_savedMode;
+    #endif
+    // 终端尺寸变化时调整绘制目标，下一帧整屏重绘
+    void updateSize();
+    void enableRawMode();
+    // 恢复终端原来的模式和屏幕内容；可以重复调用
+    void restoreTerminal();
 };
 #endif // UI_H
@@ -2,33 +2,52 @@
 #define UI_NCURSES_H
 
 #include "editor.h"
-#include <ncurses.h>
+#include "renderer.h"
+#include "screen_ncurses.h"
+#include <memory>
 #include <string>
+#include <vector>
 
 // 原有的类定义保持不变
 class NCursesUI {
 private:
     Editor& m_editor;
-    WINDOW* m_mainWin;
-    WINDOW* m_statusWin;
+    // 交互运行时持有的终端；无终端运行时为空，绘制到构造时给出的 Screen
+    std::unique_ptr<NCursesScreen> m_terminal;
+    Renderer m_renderer;
     std::string m_statusMessage;
 
-    void initScreen();
-    void renderContent();
-    void renderStatusBar();
-    std::string getModeString();
+    // 插入模式下尚未提交的输入，以及正在接收的粘贴内容
+    std::string m_typedText;
+    std::string m_pasteBuffer;
+    bool m_pasting;
+    // 增量查找的模式串有变化，在本批输入处理完后再查找
+    bool m_searchPending;
+
+    void closeScreen();
+    // 逐个处理一批按键，再提交合并的输入
+    void dispatchKeys(const std::vector<int>& keys);
 
     void handleNormalMode(int ch);
     void handleInsertMode(int ch);
     void handleCommandMode(int ch);
     void processCommand();
+    void flushTypedText();
+    void insertPaste();
+    bool isSearchCommand() const;
+    void updateSearch();
 
 public:
     NCursesUI(Editor& editor);
+    // 不初始化终端，绘制到 screen（如虚拟终端），按键由 processKeys 送入
+    NCursesUI(Editor& editor, Screen& screen);
     ~NCursesUI();
 
     void run();
     void processKeyInput(int ch);
+    // 与 run 相同地处理一批同时到达的按键：逐个处理，再提交合并的输入和增量查找
+    void processKeys(const std::vector<int>& keys);
+    void renderFrame();
 };
 
 #endif // UI_NCURSES_H 
\ No newline at end of file
@@ -0,0 +1,59 @@
+/**
+ * @file undo_history.h
+ * @brief 撤销/重做历史
+ *
+ * 大纲：
+ * 1. 编辑增量：位置、删除的字节、插入的字节
+ * 2. 事务：一组增量，作为一次撤销的单位
+ * 3. 撤销栈和重做栈
+ */
+#ifndef UNDO_HISTORY_H
+#define UNDO_HISTORY_H
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// 一次编辑：在 offset 处删除 removed，再插入 inserted。
+// 只保存变化的字节，内存占用与改动大小成正比，与缓冲区大小无关
+struct EditDelta {
+    size_t offset;
+    std::string removed;
+    std::string inserted;
+};
+
+struct UndoTransaction {
+    std::vector<EditDelta> deltas;
+    size_t cursorBefore;    // 事务开始前的光标偏移
+    size_t cursorAfter;     // 事务结束后的光标偏移
+};
+
+class UndoHistory {
+public:
+    UndoHistory();
+
+    // 事务可以嵌套，最外层结束时才提交；
+    // 不在事务中记录的编辑各自成为一个事务
+    void beginTransaction(size_t cursor);
+    void endTransaction(size_t cursor);
+    void record(size_t offset, const std::string& removed, const std::string& inserted, size_t cursor);
+
+    bool canUndo() const;
+    bool canRedo() const;
+    // 取出要撤销/重做的事务并移到另一个栈，调用方负责把它应用到缓冲区
+    const UndoTransaction* undo();
+    const UndoTransaction* redo();
+
+    void clear();
+    // 历史记录占用的字节数（只计算增量文本）
+    size_t getMemoryUsage() const;
+
+private:
+    std::vector<UndoTransaction> m_undoStack;
+    std::vector<UndoTransaction> m_redoStack;
+    UndoTransaction m_current;
+    int m_depth;
+
+    bool mergeInto(EditDelta& last, size_t offset, const std::string& removed, const std::string& inserted);
+};
+
+#endif // UNDO_HISTORY_H
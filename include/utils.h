@@ -15,4 +15,8 @@
 #endif
 // 跨平台的UTF-8输出函数声明
 void printUTF8(const std::string& text);
+// 把字节数格式化为 B/KB/MB/GB
+std::string formatBytes(size_t bytes);
+// 整数加千位分隔符，如 1,209,554
+std::string formatCount(size_t count);
 #endif // UTILS_H
@@ -0,0 +1,51 @@
+/**
+ * @file viewport.h
+ * @brief 窗口视口：可见的行列范围
+ *
+ * 大纲：
+ * 1. 记录窗口顶部的行号和左侧的列号
+ * 2. 光标移出可见范围时滚动，使光标重新可见
+ * 3. 屏幕行与缓冲区行的换算
+ * 4. 软换行：顶部以（行, 行内屏幕行）定位，滚动时只询问经过的行折成几个屏幕行
+ */
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+#include <functional>
+
+class Viewport {
+public:
+    Viewport();
+
+    // 窗口尺寸变化时调用
+    void resize(int rows, int columns);
+    // 滚动到光标可见为止；光标已可见时不滚动
+    void follow(int cursorLine, int cursorColumn);
+    // 直接滚动若干行（翻页），不检查光标
+    void scrollBy(int lines);
+
+    // 软换行时使用：rowCount 给出一行折成的屏幕行数
+    typedef std::function<int(int)> RowCounter;
+    // cursorRow 为光标在其所在行内的屏幕行序号
+    void followWrapped(int cursorLine, int cursorRow, const RowCounter& rowCount);
+    // 按屏幕行滚动，不越过第一行和最后一行
+    void scrollRows(int rows, int lineCount, const RowCounter& rowCount);
+    // 顶部的行从第几个屏幕行开始显示
+    int topRow() const;
+
+    int topLine() const;
+    int leftColumn() const;
+    int rows() const;
+    int columns() const;
+    // 最后一个可见行的下一行
+    int bottomLine() const;
+    bool isLineVisible(int line) const;
+
+private:
+    int m_topLine;
+    int m_topRow;
+    int m_leftColumn;
+    int m_rows;
+    int m_columns;
+};
+
+#endif // VIEWPORT_H
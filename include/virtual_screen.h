@@ -0,0 +1,81 @@
+/**
+ * @file virtual_screen.h
+ * @brief 内存中的虚拟终端
+ *
+ * 大纲：
+ * 1. 编辑区和状态栏各行的单元格：字素簇、是否反显、颜色对
+ * 2. 绘制写入后台缓冲，present 时与前台缓冲比较，统计本帧变化的单元格
+ * 3. 取得某行的文本和光标位置，供基准测试检查输出
+ *
+ * 不需要终端，基准测试用它衡量每帧的绘制开销。宽字符占两个单元格，
+ * 第二个单元格的宽度为 0。
+ */
+#ifndef VIRTUAL_SCREEN_H
+#define VIRTUAL_SCREEN_H
+#include "screen.h"
+#include "text_layout.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class VirtualScreen : public Screen {
+public:
+    struct Cell {
+        std::string glyph;
+        unsigned char width;
+        bool reverse;
+        short pair;
+
+        bool operator==(const Cell& other) const;
+        bool operator!=(const Cell& other) const;
+        // 默认颜色的空格，即清除后的单元格
+        bool isBlank() const;
+    };
+
+    // 一帧的统计
+    struct FrameStats {
+        size_t rowsDrawn;       // 本帧写入的行数（含状态栏）
+        size_t cellsChanged;    // 与上一帧相比内容或属性变化的单元格数
+        size_t bytesEmitted;    // 变化的单元格中字符的字节数，即任何终端都至少要输出的内容；
+                                // AnsiScreen 为实际输出的字节数（含控制序列）
+    };
+
+    VirtualScreen(int rows, int columns);
+
+    // 改变尺寸后下一帧的所有单元格都算作变化
+    virtual void resize(int rows, int columns);
+
+    int rows() const;
+    int columns() const;
+    void clear();
+    void drawRow(int row, const std::string& text);
+    void setStyle(int row, int column, int count, bool reverse, short pair);
+    void drawStatus(const std::string& text, short pair);
+    void setCursor(int row, int column);
+    void present();
+
+    const FrameStats& lastFrame() const;
+    // 已输出的第 row 行的文本，row 为 rows() 时是状态栏
+    std::string rowText(int row) const;
+    const Cell& cell(int row, int column) const;
+    int cursorRow() const;
+    int cursorColumn() const;
+
+protected:
+    int m_rows;
+    int m_columns;
+    // 各有 m_rows + 1 行，最后一行为状态栏
+    std::vector<Cell> m_back;
+    std::vector<Cell> m_front;
+    int m_cursorRow;
+    int m_cursorColumn;
+    size_t m_rowsDrawn;
+    FrameStats m_lastFrame;
+
+private:
+    LineLayout m_layout;
+
+    void writeRow(int row, const std::string& text);
+};
+
+#endif // VIRTUAL_SCREEN_H
@@ -0,0 +1,48 @@
+/**
+ * @file wrap_layout.h
+ * @brief 软换行：把一行按窗口宽度折成若干屏幕行
+ *
+ * 大纲：
+ * 1. 计算一行的折行点（各屏幕行起始的显示列），放不下的宽字符整个移到下一屏幕行
+ * 2. 按行缓存折行点，只在编辑或窗口宽度变化时失效
+ * 3. 显示列到行内屏幕行序号的换算（二分查找）
+ *
+ * 视口以（顶部行, 行内屏幕行）定位，滚动和跟随光标时只计算经过的行，
+ * 不需要测量视口之上的各行；很长的行也只二分查找它的折行点。
+ */
+#ifndef WRAP_LAYOUT_H
+#define WRAP_LAYOUT_H
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "text_layout.h"
+
+class WrapLayout {
+public:
+    WrapLayout();
+
+    // 窗口宽度变化时所有折行点失效
+    void setWidth(size_t columns);
+    size_t width() const;
+
+    // 第 line 行各屏幕行起始的显示列，第一项为 0，末尾有一个整行宽度的哨兵
+    const std::vector<size_t>& rowStarts(size_t line, const LineLayout& layout);
+    // 第 line 行折成的屏幕行数，至少为 1
+    size_t rowCount(size_t line, const LineLayout& layout);
+    // 显示列 column 在第几个屏幕行（从 0 开始）
+    size_t rowOf(size_t line, const LineLayout& layout, size_t column);
+
+    void clear();
+    // 编辑后调用：从 line 行开始删除了 removedLines 个换行、插入了 insertedLines 个
+    void applyEdit(size_t line, size_t removedLines, size_t insertedLines);
+    void invalidateLine(size_t line);
+
+private:
+    // 缓存的行数超过这么多时整个清空
+    static const size_t kCacheLines = 1024;
+
+    size_t m_width;
+    std::unordered_map<size_t, std::vector<size_t> > m_lines;
+};
+
+#endif // WRAP_LAYOUT_H
@@ -0,0 +1,163 @@
+/**
+ * @file aho_corasick.cpp
+ * @brief 多模式串匹配实现
+ */
+#include "../include/aho_corasick.h"
+#include "../include/thread_pool.h"
+#include <algorithm>
+#include <cstring>
+
+AhoCorasick::AhoCorasick() : m_maxLength(0), m_classCount(1) {
+    std::memset(m_classOf, 0, sizeof(m_classOf));
+    build();
+}
+
+int AhoCorasick::add(const std::string& pattern) {
+    if (pattern.empty()) {
+        return -1;
+    }
+    std::vector<std::string>::const_iterator it = std::find(m_patterns.begin(), m_patterns.end(), pattern);
+    if (it != m_patterns.end()) {
+        return static_cast<int>(it - m_patterns.begin());
+    }
+    m_patterns.push_back(pattern);
+    m_maxLength = std::max(m_maxLength, pattern.size());
+    return static_cast<int>(m_patterns.size() - 1);
+}
+
+void AhoCorasick::build() {
+    // 模式串中出现过的字节各占一类，其余都是第 0 类
+    std::memset(m_classOf, 0, sizeof(m_classOf));
+    m_classCount = 1;
+    for (size_t p = 0; p < m_patterns.size(); ++p) {
+        for (size_t i = 0; i < m_patterns[p].size(); ++i) {
+            unsigned char byte = static_cast<unsigned char>(m_patterns[p][i]);
+            if (m_classOf[byte] == 0) {
+                m_classOf[byte] = static_cast<unsigned short>(m_classCount++);
+            }
+        }
+    }
+
+    // 先建字典树，-1 表示没有这条边
+    m_next.assign(m_classCount, -1);
+    m_output.assign(1, -1);
+    for (size_t p = 0; p < m_patterns.size(); ++p) {
+        int state = 0;
+        for (size_t i = 0; i < m_patterns[p].size(); ++i) {
+            size_t slot = static_cast<size_t>(state) * m_classCount +
+                          m_classOf[static_cast<unsigned char>(m_patterns[p][i])];
+            if (m_next[slot] < 0) {
+                m_next[slot] = static_cast<int>(m_output.size());
+                m_next.resize(m_next.size() + m_classCount, -1);
+                m_output.push_back(-1);
+            }
+            state = m_next[slot];
+        }
+        m_output[state] = static_cast<int>(p);
+    }
+
+    // 按层广度优先求失败链接，同时把缺少的边补成失败后的转移，得到确定的状态机
+    size_t states = m_output.size();
+    m_fail.assign(states, 0);
+    m_outputLink.assign(states, -1);
+    std::vector<int> queue;
+    queue.reserve(states);
+    for (size_t c = 0; c < m_classCount; ++c) {
+        int& target = m_next[c];
+        if (target < 0) {
+            target = 0;
+        } else {
+            queue.push_back(target);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int state = queue[head];
+        int fail = m_fail[state];
+        m_outputLink[state] = m_output[state] >= 0 ? state : m_outputLink[fail];
+        for (size_t c = 0; c < m_classCount; ++c) {
+            int& target = m_next[static_cast<size_t>(state) * m_classCount + c];
+            int fallback = m_next[static_cast<size_t>(fail) * m_classCount + c];
+            if (target < 0) {
+                target = fallback;
+            } else {
+                m_fail[target] = fallback;
+                queue.push_back(target);
+            }
+        }
+    }
+}
+
+void AhoCorasick::clear() {
+    m_patterns.clear();
+    m_maxLength = 0;
+    build();
+}
+
+bool AhoCorasick::empty() const {
+    return m_patterns.empty();
+}
+
+size_t AhoCorasick::size() const {
+    return m_patterns.size();
+}
+
+const std::string& AhoCorasick::pattern(int id) const {
+    return m_patterns[static_cast<size_t>(id)];
+}
+
+size_t AhoCorasick::maxLength() const {
+    return m_maxLength;
+}
+
+void AhoCorasick::findAll(const char* data, size_t length, size_t base, std::vector<Hit>& hits) const {
+    int state = 0;
+    for (size_t i = 0; i < length; ++i) {
+        state = step(state, static_cast<unsigned char>(data[i]));
+        for (int s = m_outputLink[state]; s >= 0; s = m_outputLink[m_fail[s]]) {
+            Hit hit = { base + i + 1, m_output[s] };
+            hits.push_back(hit);
+        }
+    }
+}
+
+void AhoCorasick::countRange(const PieceTable& buffer, size_t from, size_t to,
+                             std::vector<size_t>& counts) const {
+    size_t lead = std::min(from, m_maxLength > 0 ? m_maxLength - 1 : 0);
+    size_t offset = from - lead;
+    int state = 0;
+    PieceTable::SpanIterator spans = buffer.spans(offset, to - offset);
+    const char* data;
+    size_t length;
+    while (spans.next(data, length)) {
+        for (size_t i = 0; i < length; ++i) {
+            state = step(state, static_cast<unsigned char>(data[i]));
+            // 补扫的部分只用来建立状态
+            if (offset + i >= from) {
+                for (int s = m_outputLink[state]; s >= 0; s = m_outputLink[m_fail[s]]) {
+                    ++counts[static_cast<size_t>(m_output[s])];
+                }
+            }
+        }
+        offset += length;
+    }
+}
+
+void AhoCorasick::countAll(const PieceTable& buffer, ThreadPool& pool, std::vector<size_t>& counts) const {
+    counts.assign(m_patterns.size(), 0);
+    if (m_patterns.empty()) {
+        return;
+    }
+    size_t length = buffer.length();
+    size_t parts = std::max<size_t>(1, std::min(length / kParallelChunk, pool.size() + 1));
+    std::vector<std::vector<size_t> > partial(parts, std::vector<size_t>(m_patterns.size(), 0));
+    pool.parallelFor(parts, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            countRange(buffer, length / parts * k, k + 1 == parts ? length : length / parts * (k + 1), partial[k]);
+        }
+    });
+    for (size_t k = 0; k < parts; ++k) {
+        for (size_t p = 0; p < counts.size(); ++p) {
+            counts[p] += partial[k][p];
+        }
+    }
+}
@@ -0,0 +1,175 @@
+/**
+ * @file ansi_screen.cpp
+ * @brief 直接输出 ANSI 控制序列的终端绘制目标实现
+ */
+#include "../include/ansi_screen.h"
+#include "../include/utils.h"
+#include <cerrno>
+#include <string>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// 隐藏光标后再绘制，避免光标在屏幕上跳动
+static const char* const kHideCursor = "\x1b[?25l";
+static const char* const kShowCursor = "\x1b[?25h";
+
+AnsiScreen::AnsiScreen(int fd, int rows, int columns) :
+    VirtualScreen(rows, columns),
+    m_fd(fd),
+    m_open(true),
+    m_outRow(-1),
+    m_outColumn(-1),
+    m_outPair(-1),
+    m_outReverse(false),
+    m_presentedRow(-1),
+    m_presentedColumn(-1) {
+    // 切换到备用屏幕并清屏
+    emit("\x1b[?1049h\x1b[0m\x1b[H\x1b[2J");
+}
+
+AnsiScreen::~AnsiScreen() {
+    close();
+}
+
+void AnsiScreen::close() {
+    if (!m_open) {
+        return;
+    }
+    m_open = false;
+    emit(std::string("\x1b[0m") + kShowCursor + "\x1b[?1049l");
+}
+
+void AnsiScreen::resize(int rows, int columns) {
+    VirtualScreen::resize(rows, columns);
+    // 终端改变尺寸时可能移动了原有内容，清屏后整屏重绘
+    m_outRow = -1;
+    m_outColumn = -1;
+    m_outPair = -1;
+    m_presentedRow = -1;
+    emit("\x1b[0m\x1b[2J");
+}
+
+void AnsiScreen::present() {
+    m_frame.clear();
+    compose();
+    VirtualScreen::present();
+    m_lastFrame.bytesEmitted = m_frame.size();
+    if (!m_frame.empty()) {
+        emit(m_frame);
+    }
+}
+
+// 逐行比较前后台缓冲，只输出变化的单元格；宽字符的后半格随前半格输出
+void AnsiScreen::compose() {
+    size_t columns = static_cast<size_t>(m_columns);
+    bool changed = false;
+    for (int row = 0; row <= m_rows; ++row) {
+        const Cell* back = &m_back[static_cast<size_t>(row) * columns];
+        const Cell* front = &m_front[static_cast<size_t>(row) * columns];
+        // 从 blankFrom 列起到行尾都是空白
+        int blankFrom = m_columns;
+        while (blankFrom > 0 && back[blankFrom - 1].isBlank()) {
+            --blankFrom;
+        }
+        for (int column = 0; column < m_columns;) {
+            if (back[column] == front[column] || back[column].width == 0) {
+                ++column;
+                continue;
+            }
+            if (!changed) {
+                m_frame += kHideCursor;
+                changed = true;
+            }
+            // 其余部分变成空白时清除到行尾，比逐个输出空格短
+            if (column >= blankFrom && m_columns - column > 4) {
+                moveTo(row, column);
+                setAttributes(false, 0);
+                m_frame += "\x1b[K";
+                break;
+            }
+            moveTo(row, column);
+            setAttributes(back[column].reverse, back[column].pair);
+            m_frame += back[column].glyph;
+            column += back[column].width;
+            // 写满最后一列后终端处于待换行状态，光标位置不可靠
+            m_outColumn = column < m_columns ? column : -1;
+        }
+    }
+
+    if (changed || m_cursorRow != m_presentedRow || m_cursorColumn != m_presentedColumn) {
+        moveTo(m_cursorRow, m_cursorColumn);
+        m_presentedRow = m_cursorRow;
+        m_presentedColumn = m_cursorColumn;
+    }
+    if (changed) {
+        m_frame += kShowCursor;
+    }
+}
+
+// 选择最短的方式把光标移到 (row, column)：原地不动、回车换行、向右移动、
+// 重新输出中间未变的单元格，或者绝对定位
+void AnsiScreen::moveTo(int row, int column) {
+    if (m_outColumn >= 0 && row == m_outRow && column == m_outColumn) {
+        return;
+    }
+    if (m_outColumn >= 0 && row == m_outRow && column > m_outColumn) {
+        std::string forward = "\x1b[" + std::to_string(column - m_outColumn) + "C";
+        // 中间的单元格属性与当前相同且都是单列时，直接输出它们可能更短
+        const Cell* cells = &m_back[static_cast<size_t>(row) * m_columns];
+        std::string gap;
+        bool reprint = true;
+        for (int i = m_outColumn; i < column && reprint; ++i) {
+            reprint = cells[i].width == 1 && cells[i].reverse == m_outReverse && cells[i].pair == m_outPair &&
+                      gap.size() + cells[i].glyph.size() < forward.size();
+            gap += cells[i].glyph;
+        }
+        m_frame += reprint ? gap : forward;
+    } else if (m_outColumn >= 0 && row == m_outRow + 1 && column == 0) {
+        m_frame += "\r\n";
+    } else if (m_outColumn >= 0 && row == m_outRow && column == 0) {
+        m_frame += "\r";
+    } else {
+        m_frame += "\x1b[" + std::to_string(row + 1) + ";" + std::to_string(column + 1) + "H";
+    }
+    m_outRow = row;
+    m_outColumn = column;
+}
+
+// 属性变化时输出一个完整的 SGR：先复位，再设置反显和颜色
+void AnsiScreen::setAttributes(bool reverse, short pair) {
+    if (pair == m_outPair && reverse == m_outReverse) {
+        return;
+    }
+    m_frame += "\x1b[0";
+    if (reverse) {
+        m_frame += ";7";
+    }
+    short foreground = 0;
+    short background = 0;
+    if (pairColors(pair, foreground, background)) {
+        m_frame += ";3" + std::to_string(foreground) + ";4" + std::to_string(background);
+    }
+    m_frame += "m";
+    m_outPair = pair;
+    m_outReverse = reverse;
+}
+
+// 一次写出；被信号打断或只写出一部分时继续
+void AnsiScreen::emit(const std::string& text) {
+    #ifdef _WIN32
+    printUTF8(text);
+    #else
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t result = ::write(m_fd, text.data() + written, text.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        written += static_cast<size_t>(result);
+    }
+    #endif
+}
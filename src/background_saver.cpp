@@ -0,0 +1,84 @@
+/**
+ * @file background_saver.cpp
+ * @brief 后台保存实现
+ */
+#include "../include/background_saver.h"
+#include "../include/file_saver.h"
+
+BackgroundSaver::BackgroundSaver() :
+    m_succeeded(false),
+    m_totalBytes(0),
+    m_state(IDLE),
+    m_bytesWritten(0) {}
+
+BackgroundSaver::~BackgroundSaver() {
+    wait();
+}
+
+bool BackgroundSaver::start(const PieceTable& snapshot, const std::string& filename,
+                            const std::function<void(int)>& beforeInPlace) {
+    if (m_state.load() == RUNNING) {
+        return false;
+    }
+    // 上一次的结果未被取回时直接丢弃
+    wait();
+    // 快照与编辑中的缓冲区共享片段和文本块，复制代价与文件大小无关
+    m_snapshot = snapshot;
+    m_filename = filename;
+    m_beforeInPlace = beforeInPlace;
+    m_error.clear();
+    m_succeeded = false;
+    m_totalBytes = snapshot.length() + (snapshot.length() > 0 ? 1 : 0);
+    m_bytesWritten.store(0);
+    m_state.store(RUNNING);
+    m_worker = std::thread(&BackgroundSaver::run, this);
+    return true;
+}
+
+void BackgroundSaver::run() {
+    FileSaver saver(m_snapshot);
+    saver.setProgressCounter(&m_bytesWritten);
+    saver.setBeforeInPlace(m_beforeInPlace);
+    m_succeeded = saver.save(m_filename);
+    m_error = saver.getError();
+    m_state.store(FINISHED);
+    if (m_onComplete) {
+        m_onComplete();
+    }
+}
+
+void BackgroundSaver::setCompletionCallback(const std::function<void()>& callback) {
+    m_onComplete = callback;
+}
+
+bool BackgroundSaver::isRunning() const {
+    return m_state.load() == RUNNING;
+}
+
+size_t BackgroundSaver::getBytesWritten() const {
+    return m_bytesWritten.load(std::memory_order_relaxed);
+}
+
+size_t BackgroundSaver::getTotalBytes() const {
+    return m_totalBytes;
+}
+
+bool BackgroundSaver::takeResult(bool& succeeded, std::string& filename, std::string& error) {
+    if (m_state.load() != FINISHED) {
+        return false;
+    }
+    wait();
+    succeeded = m_succeeded;
+    filename = m_filename;
+    error = m_error;
+    // 释放快照对文本的引用
+    m_snapshot.clear();
+    m_state.store(IDLE);
+    return true;
+}
+
+void BackgroundSaver::wait() {
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
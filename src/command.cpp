@@ -26,6 +26,7 @@ std::vector<std::string> CommandProcessor::splitCommand(const std::string& comma
 }
 bool CommandProcessor::executeCommand(const std::string& cmd, const std::vector<std::string>& args) {
     if (cmd == "quit" || cmd == "q") {
+        m_editor.shutdown();
         exit(0);  // 直接退出
     }
     
@@ -44,18 +45,17 @@ bool CommandProcessor::executeCommand(const std::string& cmd, const std::vector<
     }
     
     if (cmd == "new" || cmd == "n") {
-        // 使用新增的公共方法
+        // 清空后的缓冲区本身就是一个空行
         m_editor.clearLines();
-        m_editor.addEmptyLine();
         m_editor.resetCurrentFile();
         return true;
     }
 
     if (cmd == "replace" || cmd == "r") {
-        if (args.size() < 2) {
-            return false; // 需要旧文本和新文本
+        if (args.empty()) {
+            return false; // 需要模式，替换文本省略时删除匹配
         }
-        return m_editor.replaceText(args[0], args[1], true);
+        return m_editor.replaceText(args[0], args.size() > 1 ? args[1] : "", true) > 0;
     }
     
     return false;
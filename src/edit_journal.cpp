@@ -0,0 +1,404 @@
+/**
+ * @file edit_journal.cpp
+ * @brief 编辑日志实现
+ *
+ * 文件格式（本机字节序）：
+ *   文件头  8 字节魔数 "VIMJRNL2"，u64 原文件大小，i64 原文件修改时间，
+ *           u64 进程号，64 字节主机名（不足时补 \0）；
+ *           旧格式 "VIMJRNL1" 没有进程号和主机名，仍可读取
+ *   记录    u8 类型(1)，u64 偏移，u64 删除长度，u64 插入长度，插入的字节
+ */
+#include "../include/edit_journal.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+static const char kMagic[8] = { 'V', 'I', 'M', 'J', 'R', 'N', 'L', '2' };
+static const char kMagicV1[8] = { 'V', 'I', 'M', 'J', 'R', 'N', 'L', '1' };
+static const size_t kHostLength = 64;
+static const unsigned char kReplaceRecord = 1;
+
+const int EditJournal::kFlushIntervalMs;
+const int EditJournal::kMaxJournals;
+
+template <typename T>
+static void putValue(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool getValue(std::FILE* file, T& value) {
+    return std::fread(&value, sizeof(value), 1, file) == 1;
+}
+
+EditJournal::EditJournal() :
+    m_file(NULL),
+    m_capturing(false),
+    m_stopping(false) {}
+
+EditJournal::~EditJournal() {
+    close();
+}
+
+static uint64_t currentProcessId() {
+    #ifdef _WIN32
+    return static_cast<uint64_t>(_getpid());
+    #else
+    return static_cast<uint64_t>(getpid());
+    #endif
+}
+
+static std::string currentHost() {
+    char host[kHostLength + 1] = { 0 };
+    #ifdef _WIN32
+    DWORD length = sizeof(host) - 1;
+    GetComputerNameA(host, &length);
+    #else
+    gethostname(host, kHostLength);
+    #endif
+    host[kHostLength] = '\0';
+    return host;
+}
+
+std::string EditJournal::journalPathFor(const std::string& filename, int index) {
+    size_t slash = filename.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+    std::string name = slash == std::string::npos ? filename : filename.substr(slash + 1);
+    std::string path = directory + "." + name + ".vimints-swp";
+    return index == 0 ? path : path + std::to_string(index);
+}
+
+bool EditJournal::statBase(const std::string& filename, JournalBase& base) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        return false;
+    }
+    base.size = static_cast<uint64_t>(info.st_size);
+    base.modifiedTime = static_cast<int64_t>(info.st_mtime);
+    return true;
+}
+
+bool EditJournal::read(const std::string& journalPath, JournalBase& base,
+                       std::vector<JournalRecord>& records, JournalOwner* owner) {
+    std::FILE* file = std::fopen(journalPath.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[8];
+    bool ok = std::fread(magic, sizeof(magic), 1, file) == 1;
+    bool current = ok && std::memcmp(magic, kMagic, sizeof(magic)) == 0;
+    ok = ok && (current || std::memcmp(magic, kMagicV1, sizeof(magic)) == 0) &&
+         getValue(file, base.size) && getValue(file, base.modifiedTime);
+    uint64_t pid = 0;
+    char host[kHostLength + 1] = { 0 };
+    if (ok && current) {
+        ok = getValue(file, pid) && std::fread(host, 1, kHostLength, file) == kHostLength;
+    }
+    if (owner) {
+        owner->pid = pid;
+        owner->host = host;
+    }
+    records.clear();
+    while (ok) {
+        unsigned char kind;
+        JournalRecord record;
+        uint64_t insertedLength;
+        if (!getValue(file, kind) || kind != kReplaceRecord ||
+            !getValue(file, record.offset) || !getValue(file, record.removedLength) ||
+            !getValue(file, insertedLength)) {
+            break;
+        }
+        record.inserted.resize(static_cast<size_t>(insertedLength));
+        if (insertedLength > 0 &&
+            std::fread(&record.inserted[0], 1, record.inserted.size(), file) != record.inserted.size()) {
+            break;
+        }
+        records.push_back(record);
+    }
+    std::fclose(file);
+    return ok;
+}
+
+bool EditJournal::isInUse(const std::string& journalPath) {
+    #ifdef _WIN32
+    (void)journalPath;
+    return false;
+    #else
+    int fd = ::open(journalPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool busy = flock(fd, LOCK_SH | LOCK_NB) != 0 && errno == EWOULDBLOCK;
+    ::close(fd);
+    return busy;
+    #endif
+}
+
+// 调用方持有 m_fileMutex。新日志先完整写入临时文件并加锁，再放到 path：
+// replace 为 true 时原子地替换自己的旧日志；否则 path 已存在时失败，
+// 不会覆盖其他会话或上次遗留的交换文件。磁盘上的交换文件始终是完整的
+bool EditJournal::openFile(const std::string& path, bool replace, const JournalBase& base,
+                           const std::string& records) {
+    std::string temp = path + "." + std::to_string(currentProcessId()) + ".tmp";
+    std::FILE* file = std::fopen(temp.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    std::string header(kMagic, sizeof(kMagic));
+    putValue(header, base.size);
+    putValue(header, base.modifiedTime);
+    putValue(header, currentProcessId());
+    std::string host = currentHost();
+    host.resize(kHostLength, '\0');
+    header += host;
+    bool ok = std::fwrite(header.data(), 1, header.size(), file) == header.size() &&
+              std::fwrite(records.data(), 1, records.size(), file) == records.size() &&
+              std::fflush(file) == 0;
+
+    #ifdef _WIN32
+    // Windows 上不能替换打开着的文件：关闭后移动，再重新打开
+    ok = std::fclose(file) == 0 && ok;
+    file = NULL;
+    if (ok && replace && m_file) {
+        std::fclose(m_file);
+        m_file = NULL;
+    }
+    ok = ok && MoveFileExA(temp.c_str(), path.c_str(),
+                           (replace ? MOVEFILE_REPLACE_EXISTING : 0) | MOVEFILE_WRITE_THROUGH);
+    if (ok) {
+        file = std::fopen(path.c_str(), "ab");
+        ok = file != NULL;
+    }
+    #else
+    // 锁随打开的文件一起放到 path，之后一直使用这个文件，中间没有不加锁的时刻
+    ok = ok && fdatasync(fileno(file)) == 0 && flock(fileno(file), LOCK_EX | LOCK_NB) == 0;
+    if (ok && replace) {
+        ok = rename(temp.c_str(), path.c_str()) == 0;
+    } else if (ok) {
+        // link 在 path 已存在时失败，相当于 O_EXCL 创建
+        ok = link(temp.c_str(), path.c_str()) == 0;
+        if (!ok && errno != EEXIST) {
+            // 不支持硬链接的文件系统：先独占地创建占位文件，再用新日志替换它
+            int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+            ok = fd >= 0 && ::close(fd) == 0 && rename(temp.c_str(), path.c_str()) == 0;
+        }
+        std::remove(temp.c_str());
+    }
+    #endif
+    if (!ok) {
+        if (file) {
+            std::fclose(file);
+        }
+        std::remove(temp.c_str());
+        return false;
+    }
+    if (m_file) {
+        std::fclose(m_file);
+    }
+    m_file = file;
+    m_path = path;
+    return true;
+}
+
+bool EditJournal::start(const std::string& filename, const JournalBase& base) {
+    return startWith(filename, base, std::string());
+}
+
+bool EditJournal::startWith(const std::string& filename, const JournalBase& base, const std::string& records) {
+    close();
+    {
+        std::lock_guard<std::mutex> lock(m_fileMutex);
+        bool opened = false;
+        for (int i = 0; i < kMaxJournals && !opened; ++i) {
+            opened = openFile(journalPathFor(filename, i), false, base, records);
+        }
+        if (!opened) {
+            return false;
+        }
+    }
+    m_filename = filename;
+    m_stopping = false;
+    m_flusher = std::thread(&EditJournal::flushLoop, this);
+    return true;
+}
+
+void EditJournal::stopFlusher() {
+    if (!m_flusher.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_all();
+    m_flusher.join();
+}
+
+void EditJournal::close() {
+    stopFlusher();
+    writePending();
+    {
+        std::lock_guard<std::mutex> lock(m_fileMutex);
+        if (m_file) {
+            std::fclose(m_file);
+            m_file = NULL;
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capturing = false;
+    m_checkpoint.clear();
+}
+
+void EditJournal::discard() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.clear();
+    }
+    close();
+    if (!m_path.empty()) {
+        std::remove(m_path.c_str());
+        m_path.clear();
+    }
+}
+
+bool EditJournal::isActive() const {
+    return m_flusher.joinable();
+}
+
+// 按键路径：只在内存中追加一条记录
+void EditJournal::append(uint64_t offset, uint64_t removedLength, const char* inserted, size_t insertedLength) {
+    bool active = isActive();
+    if (!active && !m_capturing) {
+        return;
+    }
+    std::string record;
+    record.reserve(1 + 3 * sizeof(uint64_t) + insertedLength);
+    putValue(record, kReplaceRecord);
+    putValue(record, offset);
+    putValue(record, removedLength);
+    putValue(record, static_cast<uint64_t>(insertedLength));
+    record.append(inserted, insertedLength);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (active) {
+        m_pending += record;
+    }
+    if (m_capturing) {
+        m_checkpoint += record;
+    }
+}
+
+// 取出记录和写盘都在文件锁内完成，检查点换日志不会夹在两者之间，
+// 保存前取出的记录也就不会写进新日志
+void EditJournal::writePending() {
+    std::lock_guard<std::mutex> fileLock(m_fileMutex);
+    std::string batch;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        batch.swap(m_pending);
+    }
+    if (batch.empty() || !m_file) {
+        return;
+    }
+    std::fwrite(batch.data(), 1, batch.size(), m_file);
+    std::fflush(m_file);
+    #ifndef _WIN32
+    fdatasync(fileno(m_file));
+    #endif
+}
+
+void EditJournal::flush() {
+    writePending();
+}
+
+void EditJournal::flushLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping) {
+        m_wakeup.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs));
+        if (m_stopping) {
+            break;
+        }
+        lock.unlock();
+        writePending();
+        lock.lock();
+    }
+}
+
+void EditJournal::beginCheckpoint() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capturing = true;
+    m_checkpoint.clear();
+}
+
+void EditJournal::commitCheckpoint(const std::string& filename, const JournalBase& base) {
+    // 锁的顺序与 writePending 相同：先文件锁，再记录锁
+    std::unique_lock<std::mutex> fileLock(m_fileMutex);
+    std::string records;
+    {
+        // 保存前的记录已体现在新文件中，全部丢弃
+        std::lock_guard<std::mutex> lock(m_mutex);
+        records.swap(m_checkpoint);
+        m_capturing = false;
+        m_pending.clear();
+    }
+    if (isActive() && filename == m_filename) {
+        openFile(m_path, true, base, records);
+        return;
+    }
+    // 另存为其他文件时换到新文件的交换文件，旧文件的日志在换上新日志后删除
+    std::string oldPath = m_path;
+    fileLock.unlock();
+    startWith(filename, base, records);
+    if (!oldPath.empty() && oldPath != m_path) {
+        std::remove(oldPath.c_str());
+    }
+}
+
+JournalLock::JournalLock() :
+    m_fd(-1) {}
+
+JournalLock::~JournalLock() {
+    release();
+}
+
+bool JournalLock::acquire(const std::string& path) {
+    release();
+    #ifndef _WIN32
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        return false;
+    }
+    if (flock(m_fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    #else
+    (void)path;
+    #endif
+    return true;
+}
+
+void JournalLock::release() {
+    #ifndef _WIN32
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    #endif
+    m_fd = -1;
+}
+
+void EditJournal::abortCheckpoint() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capturing = false;
+    m_checkpoint.clear();
+}
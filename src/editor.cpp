@@ -10,9 +10,21 @@
  * 5. 模式管理方法实现
  */
 #include "../include/editor.h"
+#include "../include/file_saver.h"
+#include "../include/mapped_file.h"
+#include "../include/thread_pool.h"
+#include "../include/utils.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <sstream>
+
+const int EditorDamage::kToEnd;
 // 构造函数
 Editor::Editor() : 
     m_cursorLine(0),
@@ -21,124 +33,691 @@ Editor::Editor() :
     m_visualMode(EditorMode::NORMAL),
     m_visualStartLine(0),
     m_visualStartColumn(0),
-    m_copiedText("") {}
+    m_copiedText(""),
+    m_loadTotal(0),
+    m_journalFound(false),
+    m_searchBackward(false),
+    m_searchOrigin(0),
+    m_incrementalFound(false),
+    m_incrementalWrapped(false),
+    m_highlightSearch(false),
+    m_wrap(false),
+    m_damageCursorLine(0),
+    m_damageCursorColumn(0),
+    m_editLine(-1),
+    m_editLineStart(0),
+    m_editLineLength(0),
+    m_editDirtyBegin(0),
+    m_editCleanSuffix(0) {
+    m_damage.firstLine = 0;
+    m_damage.lastLine = EditorDamage::kToEnd;
+    m_damage.cursorMoved = false;
+    m_damage.modeChanged = false;
+}
 // 析构函数
 Editor::~Editor() {}
 // 打开文件
 bool Editor::openFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "无法打开文件: " << filename << std::endl;
-        return false;
-    }
-    
-    m_lines.clear();
-    std::string line;
-    while (std::getline(file, line)) {
-        m_lines.push_back(line);
+    // 之前的文件可能还在载入
+    m_loader.cancel();
+    m_loadTotal = 0;
+    // 大文件使用只读内存映射：不复制文件内容，行索引在浏览时按需建立，
+    // 因此首屏显示的耗时与文件大小无关
+    std::shared_ptr<MappedTextBlock> mapped = MappedTextBlock::open(filename);
+    m_mapped = mapped;
+    if (mapped) {
+        size_t length = mapped->size();
+        // 文件末尾的换行符视为最后一行的结束符，保存时补回
+        if (mapped->data()[length - 1] == '\n') {
+            length--;
+        }
+        m_editLine = -1;
+        m_buffer.adopt(mapped, length);
+    } else {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "无法打开文件: " << filename << std::endl;
+            return false;
+        }
+
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!content.empty() && content[content.size() - 1] == '\n') {
+            content.erase(content.size() - 1);
+        }
+        m_editLine = -1;
+        m_buffer.reset(content.data(), content.size());
     }
-    
+
+    m_history.clear();
+    m_matchIndex.clear();
+    m_syntax.setLanguage(SyntaxHighlighter::languageForFile(filename));
+    m_layout.clear();
+    m_wrapLayout.clear();
+    m_cursorLine = 0;
+    m_cursorColumn = 0;
+    ensureLineIndexed(0);
     m_currentFile = filename;
+    markLinesChanged(0, EditorDamage::kToEnd);
+    // 首屏已经可以显示，其余的行索引交给工作线程
+    if (mapped && !m_buffer.isFullyIndexed()) {
+        m_loadTotal = m_buffer.indexedLength() + m_buffer.pendingLength();
+        m_loader.start(mapped, m_buffer.pendingData(), m_buffer.pendingLength());
+    }
+
+    // 已有的交换文件：被其他会话锁住的说明文件正在别处编辑；没有锁的是上次异常退出
+    // 遗留的，锁住它等待用户选择恢复或放弃。本次的编辑总是记录在新的交换文件中
+    m_journal.discard();
+    m_foundLock.release();
+    m_journalFound = false;
+    m_foundJournal.clear();
+    m_journalOwner.clear();
+    for (int i = 0; i < EditJournal::kMaxJournals; ++i) {
+        std::string path = EditJournal::journalPathFor(filename, i);
+        if (!std::ifstream(path.c_str()).good()) {
+            continue;
+        }
+        if (!m_journalFound && m_foundLock.acquire(path)) {
+            m_journalFound = true;
+            m_foundJournal = path;
+        } else if (m_journalOwner.empty() && EditJournal::isInUse(path)) {
+            m_journalOwner = describeJournalOwner(path);
+        }
+    }
+    JournalBase base;
+    if (EditJournal::statBase(filename, base)) {
+        m_journal.start(filename, base);
+    }
     return true;
 }
 // 保存文件
 bool Editor::saveFile() {
     if (m_currentFile.empty()) {
-        std::cerr << "未指定文件名" << std::endl;
+        m_message = "未指定文件名";
         return false;
     }
     return saveFileAs(m_currentFile);
 }
 // 另存为
 bool Editor::saveFileAs(const std::string& filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "无法保存文件: " << filename << std::endl;
+    // 写临时文件后原子替换，原文件（包括仍被映射引用的内容）不会被截断
+    commitEditLine();
+    FileSaver saver(m_buffer);
+    saver.setBeforeInPlace(privatizeBeforeInPlace());
+    if (!saver.save(filename)) {
+        m_message = "保存失败: " + filename + " (" + saver.getError() + ")";
         return false;
     }
-    
-    for (const auto& line : m_lines) {
-        file << line << std::endl;
+
+    // 已写入文件的编辑不再需要日志
+    JournalBase base;
+    if (EditJournal::statBase(filename, base)) {
+        m_journal.beginCheckpoint();
+        m_journal.commitCheckpoint(filename, base);
     }
-    
     m_currentFile = filename;
     return true;
 }
-// 插入文本
-void Editor::insertText(const std::string& text) {
-    // 如果文本为空，插入一个空行
-    if (text.empty()) {
-        if (m_lines.empty()) {
-            m_lines.push_back("");
-        } else {
-            m_lines.insert(m_lines.begin() + static_cast<std::vector<std::string>::size_type>(m_cursorLine) + 1, "");
-            m_cursorLine++;
+// 后台保存
+bool Editor::saveFileInBackground(const std::string& filename) {
+    if (filename.empty()) {
+        m_message = "未指定文件名";
+        return false;
+    }
+    if (m_saver.isRunning()) {
+        m_message = "正在保存，请等待保存结束后再试";
+        return false;
+    }
+    // 复制片段表只复制根指针，快照与缓冲区共享全部文本
+    commitEditLine();
+    if (!m_saver.start(m_buffer, filename, privatizeBeforeInPlace())) {
+        return false;
+    }
+    // 保存期间的编辑另外保留，保存成功后作为新日志的内容
+    m_journal.beginCheckpoint();
+    return true;
+}
+
+bool Editor::isSaving() const {
+    return m_saver.isRunning();
+}
+
+int Editor::getSaveProgress() const {
+    size_t total = m_saver.getTotalBytes();
+    if (total == 0) {
+        return 100;
+    }
+    return static_cast<int>(m_saver.getBytesWritten() * 100 / total);
+}
+
+bool Editor::pollSaveResult(std::string& message) {
+    bool succeeded = false;
+    return takeSaveResult(message, succeeded);
+}
+// 取出后台保存的结果，按成败提交或放弃保存期间的日志检查点
+bool Editor::takeSaveResult(std::string& message, bool& succeeded) {
+    succeeded = false;
+    std::string filename;
+    std::string error;
+    if (!m_saver.takeResult(succeeded, filename, error)) {
+        return false;
+    }
+    JournalBase base;
+    if (succeeded && EditJournal::statBase(filename, base)) {
+        m_journal.commitCheckpoint(filename, base);
+    } else {
+        m_journal.abortCheckpoint();
+    }
+    if (succeeded) {
+        m_currentFile = filename;
+        message = "已保存 " + filename;
+    } else {
+        message = "保存失败: " + error;
+    }
+    return true;
+}
+
+void Editor::waitForSave() {
+    m_saver.wait();
+}
+
+// 就地保存会覆盖映射所在的文件，之后才写出的片段会读到已被覆盖的内容，
+// 因此先把映射复制为私有内存
+std::function<void(int)> Editor::privatizeBeforeInPlace() const {
+    std::shared_ptr<MappedTextBlock> mapped = m_mapped;
+    if (!mapped) {
+        return std::function<void(int)>();
+    }
+    return [mapped](int fd) {
+        if (mapped->refersTo(fd)) {
+            mapped->makePrivate();
         }
+    };
+}
+
+bool Editor::checkMappedFile(std::string& message) {
+    if (!m_mapped || !m_mapped->changedOnDisk()) {
+        return false;
+    }
+    m_mapped->makePrivate();
+    message = "警告：" + m_currentFile + " 已被其他程序修改或截断，缓冲区中未编辑的内容可能已随之改变或丢失";
+    return true;
+}
+
+bool Editor::isLoading() const {
+    return !m_buffer.isFullyIndexed();
+}
+
+int Editor::getLoadProgress() const {
+    if (m_loadTotal == 0) {
+        return 100;
+    }
+    return static_cast<int>((m_loadTotal - m_buffer.pendingLength()) * 100 / m_loadTotal);
+}
+
+// 后台扫描的片段接在已索引部分之后，不改变文本内容，编辑中的行和撤销历史都不受影响
+bool Editor::pollLoad() {
+    bool progressed = false;
+    std::vector<PieceTable::Piece> pieces;
+    std::vector<size_t> crlf;
+    int previousLines = getLineCount();
+    if (m_loader.takePieces(pieces, crlf) && m_buffer.appendScanned(pieces, crlf) > 0) {
+        // 原来的最后一行可能只索引了一部分，现在补全了
+        size_t last = static_cast<size_t>(previousLines - 1);
+        m_syntax.invalidateLine(last);
+        m_layout.invalidateLine(last);
+        m_wrapLayout.invalidateLine(last);
+        markLinesChanged(previousLines - 1, EditorDamage::kToEnd);
+        progressed = true;
+    }
+    // 新载入的行每次只查找一段匹配，不拖慢输入
+    if (m_matchIndex.isBehind(m_buffer)) {
+        int covered = static_cast<int>(m_matchIndex.coveredLines());
+        m_matchIndex.extend(m_buffer, ThreadPool::shared(), kIndexStep);
+        if (m_highlightSearch) {
+            markLinesChanged(covered, EditorDamage::kToEnd);
+        }
+        progressed = true;
+    }
+    return progressed;
+}
+
+bool Editor::isMatchCountPartial() const {
+    return isLoading() || m_matchIndex.isBehind(m_buffer);
+}
+
+void Editor::setNotifier(const std::function<void()>& notify) {
+    m_saver.setCompletionCallback(notify);
+    m_loader.setProgressCallback(notify);
+}
+
+bool Editor::hasRecoverableJournal() const {
+    return m_journalFound;
+}
+
+bool Editor::isEditedElsewhere(std::string& owner) const {
+    owner = m_journalOwner;
+    return !owner.empty();
+}
+
+std::string Editor::describeJournalOwner(const std::string& journalPath) {
+    JournalBase base;
+    JournalOwner owner;
+    std::vector<JournalRecord> records;
+    if (!EditJournal::read(journalPath, base, records, &owner) || owner.pid == 0) {
+        return "另一个会话";
+    }
+    return "进程 " + std::to_string(owner.pid) + (owner.host.empty() ? "" : "，主机 " + owner.host);
+}
+
+bool Editor::journalMatchesFile() const {
+    JournalBase recorded;
+    JournalBase current;
+    std::vector<JournalRecord> records;
+    return EditJournal::read(m_foundJournal, recorded, records) &&
+           EditJournal::statBase(m_currentFile, current) &&
+           recorded.size == current.size && recorded.modifiedTime == current.modifiedTime;
+}
+
+// 重放交换文件中的编辑，整个恢复过程作为一个撤销事务
+bool Editor::recoverJournal(std::string& message) {
+    JournalBase recorded;
+    std::vector<JournalRecord> records;
+    if (!m_journalFound || !EditJournal::read(m_foundJournal, recorded, records)) {
+        message = "无法读取交换文件";
+        return false;
+    }
+
+    // 重放的编辑照常记入本次会话的交换文件，写盘之后才删除遗留的交换文件
+    size_t applied = 0;
+    beginEditGroup();
+    for (; applied < records.size(); ++applied) {
+        const JournalRecord& record = records[applied];
+        if (record.offset > m_buffer.length() || record.removedLength > m_buffer.length() - record.offset) {
+            break;
+        }
+        replaceRange(static_cast<size_t>(record.offset), static_cast<size_t>(record.removedLength), record.inserted);
+    }
+    endEditGroup();
+    setCursorOffset(0);
+    if (m_journal.isActive()) {
+        m_journal.flush();
+        std::remove(m_foundJournal.c_str());
+    }
+    m_foundLock.release();
+    m_journalFound = false;
+    m_foundJournal.clear();
+
+    std::ostringstream text;
+    text << "已恢复 " << applied << " 处修改";
+    if (applied < records.size()) {
+        text << "，" << records.size() - applied << " 条记录与文件内容不符，已忽略";
+    }
+    message = text.str();
+    return true;
+}
+
+void Editor::discardJournal() {
+    if (!m_journalFound) {
         return;
     }
-    
-    // 如果行列表为空，直接添加新行
-    if (m_lines.empty()) {
-        m_lines.push_back(text);
-        m_cursorColumn = text.length(); // 更新光标列
+    std::remove(m_foundJournal.c_str());
+    m_foundLock.release();
+    m_journalFound = false;
+    m_foundJournal.clear();
+}
+
+void Editor::shutdown(bool discardJournal) {
+    m_loader.cancel();
+    waitForSave();
+    std::string message;
+    bool succeeded = true;
+    if (takeSaveResult(message, succeeded) && !succeeded) {
+        // 最后一次写盘失败，交换文件是未保存编辑的唯一副本
+        discardJournal = false;
+    }
+    if (discardJournal) {
+        m_journal.discard();
+    } else {
+        m_journal.close();
+    }
+}
+// 替换一段文本并记录撤销增量
+void Editor::replaceRange(size_t offset, size_t length, const std::string& text) {
+    commitEditLine();
+    std::string removed = length > 0 ? m_buffer.substr(offset, length) : std::string();
+    m_history.record(offset, removed, text, cursorOffset());
+    applyEdit(offset, removed, text);
+}
+
+void Editor::applyEdit(size_t offset, const std::string& removed, const std::string& text) {
+    m_buffer.erase(offset, removed.size());
+    m_buffer.insert(offset, text);
+    m_journal.append(offset, removed.size(), text.data(), text.size());
+
+    // 换行数不变时只有编辑涉及的几行变化，否则其后各行都会移动
+    int line = static_cast<int>(m_buffer.lineOfOffset(offset));
+    long removedLines = std::count(removed.begin(), removed.end(), '\n');
+    long insertedLines = std::count(text.begin(), text.end(), '\n');
+    markLinesChanged(line, removedLines == insertedLines ? line + static_cast<int>(insertedLines)
+                                                         : EditorDamage::kToEnd);
+    m_matchIndex.applyEdit(static_cast<size_t>(line), static_cast<size_t>(removedLines),
+                           static_cast<size_t>(insertedLines));
+    m_syntax.applyEdit(static_cast<size_t>(line), static_cast<size_t>(removedLines),
+                       static_cast<size_t>(insertedLines));
+    m_layout.applyEdit(static_cast<size_t>(line), static_cast<size_t>(removedLines),
+                       static_cast<size_t>(insertedLines));
+    m_wrapLayout.applyEdit(static_cast<size_t>(line), static_cast<size_t>(removedLines),
+                           static_cast<size_t>(insertedLines));
+    if (removedLines == insertedLines) {
+        markSyntaxChanged(line + static_cast<int>(insertedLines));
+    }
+    if (m_highlightSearch && m_matchIndex.isActive() && m_matchIndex.regex().matchesLineFeed()) {
+        // 跨行的匹配可能从之前的行开始，高亮整个重画
+        markLinesChanged(0, EditorDamage::kToEnd);
+    }
+}
+
+// 只取语法高亮需要的行首部分，不复制整行
+SyntaxHighlighter::LineSource Editor::syntaxSource() const {
+    return [this](size_t line, size_t maxLength) { return getLineSegment(static_cast<int>(line), 0, maxLength); };
+}
+
+void Editor::markSyntaxChanged(int line) {
+    if (m_syntax.endStateChanged(static_cast<size_t>(line), syntaxSource())) {
+        markLinesChanged(line, EditorDamage::kToEnd);
+    }
+}
+
+void Editor::markLinesChanged(int firstLine, int lastLine) {
+    if (m_damage.firstLine < 0) {
+        m_damage.firstLine = firstLine;
+        m_damage.lastLine = lastLine;
+    } else {
+        m_damage.firstLine = std::min(m_damage.firstLine, firstLine);
+        m_damage.lastLine = std::max(m_damage.lastLine, lastLine);
+    }
+}
+
+// 载入光标所在行，记录的修改区域为空
+void Editor::loadEditLine() {
+    commitEditLine();
+    size_t line = static_cast<size_t>(m_cursorLine);
+    m_editLine = m_cursorLine;
+    m_editLineStart = m_buffer.lineStart(line);
+    m_editLineLength = m_buffer.lineLength(line);
+    m_editDirtyBegin = m_editLineLength;
+    m_editCleanSuffix = m_editLineLength;
+    m_editGap.clear();
+    PieceTable::SpanIterator spans = m_buffer.spans(m_editLineStart, m_editLineLength);
+    const char* data;
+    size_t length;
+    while (spans.next(data, length)) {
+        m_editGap.append(data, length);
+    }
+}
+
+// 排版就地更新时只取正在编辑的行中编辑处附近的内容
+LineLayout::SegmentSource Editor::editLineSource() const {
+    return [this](size_t start, size_t length) { return m_editGap.substr(start, length); };
+}
+
+void Editor::typeIntoEditLine(const std::string& text) {
+    if (m_editLine != m_cursorLine) {
+        loadEditLine();
+    }
+    size_t column = static_cast<size_t>(m_cursorColumn);
+    size_t offset = m_editLineStart + column;
+    m_history.record(offset, std::string(), text, offset);
+    m_journal.append(offset, 0, text.data(), text.size());
+    m_editGap.insert(column, text.data(), text.size());
+
+    m_editDirtyBegin = std::min(m_editDirtyBegin, column);
+    m_editCleanSuffix = std::min(m_editCleanSuffix, m_editGap.length() - column - text.size());
+    m_cursorColumn += static_cast<int>(text.size());
+    markLinesChanged(m_cursorLine, m_cursorLine);
+    m_syntax.invalidateLine(static_cast<size_t>(m_cursorLine));
+    m_layout.editLine(static_cast<size_t>(m_cursorLine), column, 0, text.size(), editLineSource());
+    m_wrapLayout.invalidateLine(static_cast<size_t>(m_cursorLine));
+    markSyntaxChanged(m_cursorLine);
+}
+
+// 删除光标前的 count 个字节（一个字素簇）
+void Editor::backspaceInEditLine(size_t count) {
+    if (m_editLine != m_cursorLine) {
+        loadEditLine();
+    }
+    size_t column = static_cast<size_t>(m_cursorColumn) - count;
+    size_t offset = m_editLineStart + column;
+    std::string removed = m_editGap.substr(column, count);
+    m_history.record(offset, removed, std::string(), offset + count);
+    m_journal.append(offset, count, NULL, 0);
+    m_editGap.erase(column, count);
+
+    m_editDirtyBegin = std::min(m_editDirtyBegin, column);
+    m_editCleanSuffix = std::min(m_editCleanSuffix, m_editGap.length() - column);
+    m_cursorColumn -= static_cast<int>(count);
+    markLinesChanged(m_cursorLine, m_cursorLine);
+    m_syntax.invalidateLine(static_cast<size_t>(m_cursorLine));
+    m_layout.editLine(static_cast<size_t>(m_cursorLine), column, count, 0, editLineSource());
+    m_wrapLayout.invalidateLine(static_cast<size_t>(m_cursorLine));
+    markSyntaxChanged(m_cursorLine);
+}
+
+// 只替换修改过的区域，写回的开销与输入量成正比，而不是与行长成正比
+void Editor::commitEditLine() {
+    if (m_editLine < 0) {
         return;
     }
-    
+    size_t newLength = m_editGap.length();
+    if (m_editDirtyBegin + m_editCleanSuffix < std::max(newLength, m_editLineLength) ||
+        newLength != m_editLineLength) {
+        size_t changedLength = newLength - m_editDirtyBegin - m_editCleanSuffix;
+        m_buffer.erase(m_editLineStart + m_editDirtyBegin, m_editLineLength - m_editDirtyBegin - m_editCleanSuffix);
+        m_buffer.insert(m_editLineStart + m_editDirtyBegin, m_editGap.substr(m_editDirtyBegin, changedLength));
+        m_matchIndex.invalidateLine(static_cast<size_t>(m_editLine));
+    }
+    m_editLine = -1;
+}
+
+bool Editor::takeMessage(std::string& message) {
+    if (m_message.empty()) {
+        return false;
+    }
+    message.swap(m_message);
+    m_message.clear();
+    return true;
+}
+
+std::string Editor::getMemoryReport() const {
+    PieceTable::MemoryStats stats = m_buffer.memoryStats();
+    size_t lines = m_buffer.lineCount();
+    size_t overhead = stats.pieceBytes;
+    std::ostringstream report;
+    report << "文本 " << formatBytes(stats.textBytes) << " / " << lines << " 行"
+           << " | 原始 " << formatBytes(stats.originalBytes)
+           << " | 追加 " << formatBytes(stats.addBytesUsed) << "/" << formatBytes(stats.addBytesAllocated)
+           << " | 片段 " << stats.pieces << " 个 " << formatBytes(stats.pieceBytes)
+           << " (每行 " << (lines > 0 ? overhead / lines : 0) << " B)";
+    report << " | 撤销 " << formatBytes(m_history.getMemoryUsage());
+    return report.str();
+}
+
+EditorDamage Editor::takeDamage() {
+    EditorDamage damage = m_damage;
+    damage.cursorMoved = m_cursorLine != m_damageCursorLine || m_cursorColumn != m_damageCursorColumn;
+    m_damageCursorLine = m_cursorLine;
+    m_damageCursorColumn = m_cursorColumn;
+    m_damage.firstLine = -1;
+    m_damage.lastLine = -1;
+    m_damage.cursorMoved = false;
+    m_damage.modeChanged = false;
+    return damage;
+}
+// 应用事务：reverse 为 true 时撤销，否则重做
+void Editor::applyTransaction(const UndoTransaction& transaction, bool reverse) {
+    const std::vector<EditDelta>& deltas = transaction.deltas;
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        const EditDelta& delta = deltas[reverse ? deltas.size() - 1 - i : i];
+        const std::string& from = reverse ? delta.inserted : delta.removed;
+        const std::string& to = reverse ? delta.removed : delta.inserted;
+        applyEdit(delta.offset, from, to);
+    }
+    setCursorOffset(reverse ? transaction.cursorBefore : transaction.cursorAfter);
+}
+bool Editor::undo() {
+    commitEditLine();
+    const UndoTransaction* transaction = m_history.undo();
+    if (!transaction) {
+        return false;
+    }
+    applyTransaction(*transaction, true);
+    return true;
+}
+bool Editor::redo() {
+    commitEditLine();
+    const UndoTransaction* transaction = m_history.redo();
+    if (!transaction) {
+        return false;
+    }
+    applyTransaction(*transaction, false);
+    return true;
+}
+void Editor::beginEditGroup() {
+    m_history.beginTransaction(cursorOffset());
+}
+void Editor::endEditGroup() {
+    m_history.endTransaction(cursorOffset());
+}
+// 光标所在位置的字节偏移
+size_t Editor::cursorOffset() const {
+    return m_buffer.lineStart(static_cast<size_t>(m_cursorLine)) + static_cast<size_t>(m_cursorColumn);
+}
+// 把光标放到给定字节偏移处
+void Editor::setCursorOffset(size_t offset) {
+    commitEditLine();
+    while (!m_buffer.isFullyIndexed() && m_buffer.indexedLength() < offset) {
+        m_buffer.indexMore(kIndexStep);
+    }
+    PieceTable::Position position = m_buffer.positionOf(offset);
+    m_cursorLine = static_cast<int>(position.line);
+    m_cursorColumn = static_cast<int>(position.column);
+    ensureLineIndexed(m_cursorLine);
+}
+// 确保第 lineIndex 行及其下一行的行首已建立索引。
+// 光标所在行始终满足此条件，因此编辑操作可以直接使用行长度
+void Editor::ensureLineIndexed(int lineIndex) {
+    while (!m_buffer.isFullyIndexed() && getLineCount() <= lineIndex + 1) {
+        m_buffer.indexMore(kIndexStep);
+    }
+}
+bool Editor::isFullyIndexed() const {
+    return m_buffer.isFullyIndexed();
+}
+bool Editor::hasDosLineEndings() const {
+    PieceTable::LineBreakSummary breaks = m_buffer.originalLineBreaks();
+    return breaks.lineFeeds > 0 && breaks.crlf == breaks.lineFeeds;
+}
+int Editor::lineLength(int lineIndex) const {
+    if (lineIndex == m_editLine) {
+        return static_cast<int>(m_editGap.length());
+    }
+    return static_cast<int>(m_buffer.lineLength(static_cast<size_t>(lineIndex)));
+}
+// 插入文本
+void Editor::insertText(const std::string& text) {
     // 确保光标行有效
     if (m_cursorLine < 0) {
         m_cursorLine = 0;
     }
-    if (m_cursorLine >= static_cast<int>(m_lines.size())) {
-        m_lines.push_back(""); // 如��超出范围，添加新��
-        m_cursorLine = static_cast<int>(m_lines.size()) - 1;
+    if (m_cursorLine >= getLineCount()) {
+        m_cursorLine = getLineCount() - 1;
+    }
+
+    // 如果文本为空，在当前行下方插入一个空行
+    if (text.empty()) {
+        commitEditLine();
+        if (m_buffer.length() > 0) {
+            size_t lineEnd = m_buffer.lineStart(static_cast<size_t>(m_cursorLine)) +
+                             static_cast<size_t>(lineLength(m_cursorLine));
+            replaceRange(lineEnd, 0, "\n");
+            m_cursorLine++;
+        }
+        return;
     }
 
-    // 获取当前行的引用
-    std::string& currentLine = m_lines[static_cast<std::vector<std::string>::size_type>(m_cursorLine)];
-    
     // 确保光标列有效
     if (m_cursorColumn < 0) {
         m_cursorColumn = 0;
     }
-    if (m_cursorColumn > static_cast<int>(currentLine.length())) {
-        m_cursorColumn = static_cast<int>(currentLine.length());
+    if (m_cursorColumn > lineLength(m_cursorLine)) {
+        m_cursorColumn = lineLength(m_cursorLine);
     }
 
-    // 在当前行的光标位置插入文本
-    currentLine = currentLine.substr(0, m_cursorColumn) + text + currentLine.substr(m_cursorColumn);
-    
-    // 更新光标位置
-    m_cursorColumn += text.length();
+    // 插入模式下的单行输入直接写入间隙缓冲区
+    if (m_currentMode == EditorMode::INSERT && text.find('\n') == std::string::npos) {
+        typeIntoEditLine(text);
+        return;
+    }
+
+    // 在光标位置插入文本，并把光标移到插入内容之后
+    size_t offset = cursorOffset();
+    replaceRange(offset, 0, text);
+    setCursorOffset(offset + text.size());
 }
 // 删除文本
 void Editor::deleteText() {
-    if (!m_lines.empty() && m_cursorLine < static_cast<int>(m_lines.size())) {
-        std::string& currentLine = m_lines[static_cast<std::vector<std::string>::size_type>(m_cursorLine)];
-        
-        // 如果光标不在行首，删除光标前的字符
-        if (m_cursorColumn > 0 && m_cursorColumn <= static_cast<int>(currentLine.length())) {
-            currentLine.erase(m_cursorColumn - 1, 1);
-            m_cursorColumn--;
-        } 
-        // 如果光标在行首且不是第一行，合并当前行和上一行
-        else if (m_cursorLine > 0) {
-            std::string prevLine = m_lines[static_cast<std::vector<std::string>::size_type>(m_cursorLine - 1)];
-            m_cursorColumn = prevLine.length();
-            m_lines[static_cast<std::vector<std::string>::size_type>(m_cursorLine - 1)] += currentLine;
-            m_lines.erase(m_lines.begin() + static_cast<std::vector<std::string>::size_type>(m_cursorLine));
-            m_cursorLine--;
+    if (m_cursorLine < 0 || m_cursorLine >= getLineCount()) {
+        return;
+    }
+    // 如果光标不在行首，删除光标前的字素簇
+    if (m_cursorColumn > 0 && m_cursorColumn <= lineLength(m_cursorLine)) {
+        size_t column = static_cast<size_t>(m_cursorColumn);
+        size_t count = column - getLineLayout(m_cursorLine).previousCluster(column);
+        if (m_currentMode == EditorMode::INSERT) {
+            backspaceInEditLine(count);
+        } else {
+            replaceRange(cursorOffset() - count, count, "");
+            m_cursorColumn -= static_cast<int>(count);
         }
-
-        // 如果删除后没有行，添加一个空行
-        if (m_lines.empty()) {
-            m_lines.push_back("");
+    }
+    // 如果光标在行首且不是第一行，合并当前行和上一行
+    else if (m_cursorLine > 0) {
+        commitEditLine();
+        size_t lineBegin = m_buffer.lineStart(static_cast<size_t>(m_cursorLine));
+        m_cursorColumn = lineLength(m_cursorLine - 1);
+        replaceRange(lineBegin - 1, 1, "");
+        m_cursorLine--;
+    }
+}
+// 按类型删除文本：字符删除光标下的字符（同 vim 的 x）
+void Editor::deleteText(DeleteType type) {
+    switch (type) {
+        case DeleteType::CHARACTER:
+            if (m_cursorColumn < lineLength(m_cursorLine)) {
+                size_t column = static_cast<size_t>(m_cursorColumn);
+                replaceRange(cursorOffset(), getLineLayout(m_cursorLine).nextCluster(column) - column, "");
+                setCursorColumn(m_cursorColumn);
+            }
+            break;
+        case DeleteType::WORD: {
+            std::string currentLine = getCurrentLineText();
+            size_t wordEnd = currentLine.find_first_of(" \t", static_cast<size_t>(m_cursorColumn));
+            if (wordEnd == std::string::npos) {
+                wordEnd = currentLine.length();
+            }
+            replaceRange(cursorOffset(), wordEnd - static_cast<size_t>(m_cursorColumn), "");
+            setCursorColumn(m_cursorColumn);
+            break;
         }
+        case DeleteType::LINE:
+            removeLine(m_cursorLine);
+            break;
     }
 }
 // 复制文本
 void Editor::copyText() {
-    if (m_cursorLine >= 0 && m_cursorLine < static_cast<int>(m_lines.size())) {
-        m_copiedText = m_lines[static_cast<std::vector<std::string>::size_type>(m_cursorLine)];
+    if (m_cursorLine >= 0 && m_cursorLine < getLineCount()) {
+        m_copiedText = getLine(m_cursorLine);
     }
 }
 // 粘贴文本
@@ -150,77 +729,136 @@ void Editor::pasteText() {
 }
 // 光标移动方法
 void Editor::moveCursorUp() {
+    commitEditLine();
     if (m_cursorLine > 0) {
+        // 保持显示列不变，落在新行中覆盖该列的字素簇上
+        size_t column = getLineLayout(m_cursorLine).columnOf(static_cast<size_t>(m_cursorColumn));
         m_cursorLine--;
-        // 保持光标列在新行的有效范围内
-        if (m_cursorColumn > static_cast<int>(m_lines[m_cursorLine].length())) {
-            m_cursorColumn = static_cast<int>(m_lines[m_cursorLine].length());
-        }
+        m_cursorColumn = static_cast<int>(getLineLayout(m_cursorLine).byteAt(column));
     }
 }
 void Editor::moveCursorDown() {
-    if (m_cursorLine < static_cast<int>(m_lines.size()) - 1) {
+    commitEditLine();
+    ensureLineIndexed(m_cursorLine + 1);
+    if (m_cursorLine < getLineCount() - 1) {
+        size_t column = getLineLayout(m_cursorLine).columnOf(static_cast<size_t>(m_cursorColumn));
         m_cursorLine++;
-        // 保持光标列在新行的有效范围内
-        if (m_cursorColumn > static_cast<int>(m_lines[m_cursorLine].length())) {
-            m_cursorColumn = static_cast<int>(m_lines[m_cursorLine].length());
-        }
+        m_cursorColumn = static_cast<int>(getLineLayout(m_cursorLine).byteAt(column));
     }
 }
 void Editor::moveCursorLeft() {
     if (m_cursorColumn > 0) {
-        m_cursorColumn--;
+        m_cursorColumn = static_cast<int>(
+            getLineLayout(m_cursorLine).previousCluster(static_cast<size_t>(m_cursorColumn)));
     } else if (m_cursorLine > 0) {
         // 如果在行首，移动到上一行末尾
+        commitEditLine();
         m_cursorLine--;
-        m_cursorColumn = static_cast<int>(m_lines[m_cursorLine].length());
+        m_cursorColumn = lineLength(m_cursorLine);
     }
 }
 void Editor::moveCursorRight() {
-    if (m_cursorColumn < static_cast<int>(m_lines[m_cursorLine].length())) {
-        m_cursorColumn++;
-    } else if (m_cursorLine < static_cast<int>(m_lines.size()) - 1) {
+    if (m_cursorColumn < lineLength(m_cursorLine)) {
+        m_cursorColumn = static_cast<int>(
+            getLineLayout(m_cursorLine).nextCluster(static_cast<size_t>(m_cursorColumn)));
+    } else if (m_cursorLine < getLineCount() - 1) {
         // 如果在行尾，移动到下一行行首
+        commitEditLine();
         m_cursorLine++;
         m_cursorColumn = 0;
+        ensureLineIndexed(m_cursorLine);
     }
 }
 // 模式管理
 void Editor::setMode(EditorMode mode) {
+    // 一次插入模式会话中的全部输入作为一个撤销事务
+    if (mode == EditorMode::INSERT && m_currentMode != EditorMode::INSERT) {
+        beginEditGroup();
+    } else if (mode != EditorMode::INSERT && m_currentMode == EditorMode::INSERT) {
+        commitEditLine();
+        endEditGroup();
+    }
+    m_damage.modeChanged = m_damage.modeChanged || mode != m_currentMode;
     m_currentMode = mode;
 }
 EditorMode Editor::getMode() const {
     return m_currentMode;
 }
-// 新增的公共访问方法实现
-const std::vector<std::string>& Editor::getLines() const {
-    return m_lines;
+// 文本访问方法
+int Editor::getLineCount() const {
+    return static_cast<int>(m_buffer.lineCount());
+}
+
+std::string Editor::getLine(int lineIndex) const {
+    if (lineIndex == m_editLine) {
+        return m_editGap.substr(0, m_editGap.length());
+    }
+    if (lineIndex >= 0 && lineIndex < getLineCount()) {
+        return m_buffer.getLine(static_cast<size_t>(lineIndex));
+    }
+    return "";
+}
+
+int Editor::getLineLength(int lineIndex) const {
+    if (lineIndex < 0 || lineIndex >= getLineCount()) {
+        return 0;
+    }
+    return lineLength(lineIndex);
+}
+
+std::string Editor::getLineSegment(int lineIndex, size_t column, size_t length) const {
+    if (lineIndex == m_editLine) {
+        return m_editGap.substr(column, length);
+    }
+    if (lineIndex < 0 || lineIndex >= getLineCount()) {
+        return "";
+    }
+    size_t line = static_cast<size_t>(lineIndex);
+    size_t lineLength = m_buffer.lineLength(line);
+    if (column >= lineLength) {
+        return "";
+    }
+    return m_buffer.substr(m_buffer.lineStart(line) + column, std::min(length, lineLength - column));
+}
+
+const PieceTable& Editor::getBuffer() {
+    commitEditLine();
+    return m_buffer;
 }
+
 const std::string& Editor::getCurrentFile() const {
     return m_currentFile;
 }
 
 std::string Editor::getCurrentLineText() const {
-    if (m_cursorLine >= 0 && m_cursorLine < static_cast<int>(m_lines.size())) {
-        return m_lines[static_cast<std::vector<std::string>::size_type>(m_cursorLine)];
-    }
-    return "";
+    return getLine(m_cursorLine);
 }
 
 std::pair<int, int> Editor::getCursorPosition() const {
     return {m_cursorLine, m_cursorColumn};
 }
 
+int Editor::getCursorLine() const {
+    return m_cursorLine;
+}
+
+// 跳转到指定行（从 1 开始），超出范围时停在首行或末行
+void Editor::gotoLine(int lineNumber) {
+    ensureLineIndexed(lineNumber - 1);
+    m_cursorLine = std::max(0, std::min(lineNumber - 1, getLineCount() - 1));
+    setCursorColumn(m_cursorColumn);
+}
+
 void Editor::moveToLineStart() {
     m_cursorColumn = 0;
 }
 
 void Editor::moveToLineEnd() {
-    m_cursorColumn = static_cast<int>(m_lines[m_cursorLine].length());
+    m_cursorColumn = lineLength(m_cursorLine);
 }
 
 void Editor::moveWordForward() {
-    std::string currentLine = m_lines[m_cursorLine];
+    std::string currentLine = getLine(m_cursorLine);
     while (m_cursorColumn < static_cast<int>(currentLine.length()) && 
            std::isalnum(currentLine[m_cursorColumn])) {
         m_cursorColumn++;
@@ -233,7 +871,7 @@ void Editor::moveWordForward() {
 }
 
 void Editor::moveWordBackward() {
-    std::string currentLine = m_lines[m_cursorLine];
+    std::string currentLine = getLine(m_cursorLine);
     // Skip leading whitespace
     while (m_cursorColumn > 0 && std::isspace(currentLine[m_cursorColumn - 1])) {
         m_cursorColumn--;
@@ -270,40 +908,423 @@ void Editor::selectText() {
     }
 }
 
-bool Editor::searchText(const std::string& pattern) {
-    for (size_t i = 0; i < m_lines.size(); ++i) {
-        size_t pos = m_lines[i].find(pattern);
-        if (pos != std::string::npos) {
-            m_cursorLine = static_cast<int>(i);
-            m_cursorColumn = static_cast<int>(pos);
+bool Editor::compileSearch(const std::string& pattern) {
+    if (m_searchRegex.isCompiled() && m_searchRegex.pattern() == pattern) {
+        return true;
+    }
+    std::string error;
+    if (!m_searchRegex.compile(pattern, error)) {
+        m_message = "无效的模式: " + error;
+        return false;
+    }
+    return true;
+}
+
+size_t Editor::findWrapping(const Regex& regex, size_t from, bool backward, bool& wrapped) const {
+    if (regex.isLiteral()) {
+        // 不含元字符的模式直接按字面查找
+        // 反向时 from 之前开始的匹配，正向时 from 及之后开始的匹配
+        const std::string& pattern = regex.literal();
+        size_t tail = pattern.size() - 1;
+        size_t hit = backward ? m_buffer.rfind(pattern, 0, from + tail) : m_buffer.find(pattern, from);
+        wrapped = hit == PieceTable::npos;
+        if (wrapped) {
+            hit = backward ? m_buffer.rfind(pattern, from) : m_buffer.find(pattern, 0, from + tail);
+        }
+        return hit;
+    }
+    RegexMatcher matcher(regex);
+    PieceTableInput input(m_buffer);
+    RegexMatch match;
+    size_t length = m_buffer.length();
+    bool found = backward ? matcher.searchLast(input, 0, from, match)
+                          : matcher.search(input, from, length, match);
+    wrapped = !found;
+    if (wrapped) {
+        found = backward ? matcher.searchLast(input, from, length, match)
+                         : matcher.search(input, 0, length, match);
+    }
+    return found ? match.start : PieceTable::npos;
+}
+
+bool Editor::jumpToMatch(const std::string& pattern, bool backward) {
+    commitEditLine();
+    if (!compileSearch(pattern)) {
+        return false;
+    }
+    updateMatchIndex();
+    size_t cursor = cursorOffset();
+    bool wrapped = false;
+    size_t hit = findWrapping(m_searchRegex, backward ? cursor : cursor + 1, backward, wrapped);
+    if (hit == PieceTable::npos) {
+        m_message = "未找到: " + pattern;
+        return false;
+    }
+    if (wrapped) {
+        m_message = backward ? "已到达文件开头，从末尾继续查找" : "已到达文件末尾，从开头继续查找";
+    }
+    setCursorOffset(hit);
+    return true;
+}
+
+bool Editor::searchText(const std::string& pattern, bool backward) {
+    if (pattern.empty() || pattern.find('\n') != std::string::npos) {
+        return false;
+    }
+    m_lastSearch = pattern;
+    m_searchBackward = backward;
+    return jumpToMatch(pattern, backward);
+}
+
+bool Editor::searchNext(bool reverse) {
+    if (m_lastSearch.empty()) {
+        m_message = "没有上次查找的内容";
+        return false;
+    }
+    return jumpToMatch(m_lastSearch, m_searchBackward != reverse);
+}
+
+void Editor::beginIncrementalSearch(bool backward) {
+    commitEditLine();
+    m_searchOrigin = cursorOffset();
+    m_searchBackward = backward;
+    m_incrementalPattern.clear();
+    m_incrementalFound = false;
+    m_incrementalWrapped = false;
+}
+
+// 每次都从起点重新查找，模式串变长或变短时结果都与直接查找一致
+bool Editor::updateIncrementalSearch(const std::string& pattern) {
+    m_incrementalPattern = pattern;
+    m_incrementalFound = false;
+    m_incrementalWrapped = false;
+    // 输入到一半的模式可能还不完整（如只输入了左括号），此时视为没有匹配
+    std::string error;
+    if (!pattern.empty() && m_searchRegex.compile(pattern, error)) {
+        size_t from = m_searchBackward ? m_searchOrigin : m_searchOrigin + 1;
+        size_t hit = findWrapping(m_searchRegex, from, m_searchBackward, m_incrementalWrapped);
+        if (hit != PieceTable::npos) {
+            setCursorOffset(hit);
+            m_incrementalFound = true;
             return true;
         }
     }
+    setCursorOffset(m_searchOrigin);
     return false;
 }
 
+bool Editor::finishIncrementalSearch(const std::string& pattern) {
+    if (pattern.empty()) {
+        // 空模式串沿用上次的查找
+        cancelIncrementalSearch();
+        return searchNext(false);
+    }
+    if (pattern != m_incrementalPattern) {
+        updateIncrementalSearch(pattern);
+    }
+    m_lastSearch = pattern;
+    if (!compileSearch(pattern)) {
+        return false;
+    }
+    updateMatchIndex();
+    if (!m_incrementalFound) {
+        m_message = "未找到: " + pattern;
+    } else if (m_incrementalWrapped) {
+        m_message = m_searchBackward ? "已到达文件开头，从末尾继续查找" : "已到达文件末尾，从开头继续查找";
+    }
+    return m_incrementalFound;
+}
+
+void Editor::cancelIncrementalSearch() {
+    setCursorOffset(m_searchOrigin);
+    m_incrementalPattern.clear();
+}
+
+const std::string& Editor::getLastSearch() const {
+    return m_lastSearch;
+}
+
+void Editor::updateMatchIndex() {
+    if (m_matchIndex.isActive() && m_matchIndex.regex().pattern() == m_searchRegex.pattern()) {
+        return;
+    }
+    // 按行切分给线程池并行查找；文件还在载入时只查已索引的行，其余随载入补上
+    m_matchIndex.build(m_buffer, m_searchRegex, ThreadPool::shared());
+    if (m_highlightSearch) {
+        markLinesChanged(0, EditorDamage::kToEnd);
+    }
+}
+
+// 正在编辑的行在间隙缓冲区中，匹配索引里该行的条目是开始编辑之前的，直接查找该行的当前内容
+void Editor::findEditLineMatches(std::vector<std::pair<size_t, size_t> >& matches) const {
+    std::string text = m_editGap.substr(0, m_editGap.length());
+    MemoryInput input(text.data(), text.size());
+    RegexMatcher matcher(m_matchIndex.regex());
+    RegexMatch match;
+    size_t pos = 0;
+    while (pos <= text.size() && matcher.search(input, pos, text.size(), match)) {
+        matches.push_back(std::make_pair(match.start, match.length()));
+        pos = match.end > match.start ? match.end : match.end + 1;
+    }
+}
+
+bool Editor::getMatchCount(size_t& current, size_t& total) {
+    if (!m_matchIndex.isActive()) {
+        return false;
+    }
+    m_matchIndex.refresh(m_buffer, ThreadPool::shared());
+    size_t cursorLine = static_cast<size_t>(m_cursorLine);
+    size_t cursorColumn = static_cast<size_t>(m_cursorColumn);
+    current = m_matchIndex.ordinalAt(cursorLine, cursorColumn);
+    total = m_matchIndex.count();
+    if (m_editLine < 0 || static_cast<size_t>(m_editLine) >= m_matchIndex.coveredLines()) {
+        return true;
+    }
+    // 用编辑行的当前匹配替换索引中该行的条目
+    size_t editLine = static_cast<size_t>(m_editLine);
+    std::pair<size_t, size_t> range = m_matchIndex.lineRange(editLine);
+    std::vector<std::pair<size_t, size_t> > live;
+    findEditLineMatches(live);
+    total = total - (range.second - range.first) + live.size();
+    if (cursorLine == editLine) {
+        current = range.first;
+        while (current - range.first < live.size() && live[current - range.first].first <= cursorColumn) {
+            ++current;
+        }
+    } else if (cursorLine > editLine) {
+        current = current - (range.second - range.first) + live.size();
+    }
+    return true;
+}
+
+void Editor::getLineMatches(int lineIndex, std::vector<std::pair<size_t, size_t> >& matches) {
+    matches.clear();
+    if (!m_highlightSearch || !m_matchIndex.isActive()) {
+        return;
+    }
+    if (lineIndex == m_editLine) {
+        findEditLineMatches(matches);
+        return;
+    }
+    m_matchIndex.refresh(m_buffer, ThreadPool::shared());
+    std::pair<size_t, size_t> range = m_matchIndex.lineRange(static_cast<size_t>(lineIndex));
+    for (size_t i = range.first; i < range.second; ++i) {
+        const MatchIndex::Match& match = m_matchIndex.at(i);
+        matches.push_back(std::make_pair(match.column, match.length));
+    }
+}
+
+// 展开替换文本中的 & \0-\9 \n \t，其余转义字符按字面处理
+static std::string expandReplacement(const std::string& replacement, const PieceTable& buffer,
+                                     const RegexMatch& match) {
+    std::string result;
+    for (size_t i = 0; i < replacement.size(); ++i) {
+        char c = replacement[i];
+        int group = -1;
+        if (c == '&') {
+            group = 0;
+        } else if (c == '\\' && i + 1 < replacement.size()) {
+            c = replacement[++i];
+            if (c >= '0' && c <= '9') {
+                group = c - '0';
+            } else if (c == 'n') {
+                c = '\n';
+            } else if (c == 't') {
+                c = '\t';
+            }
+        }
+        if (group < 0) {
+            result += c;
+        } else if (static_cast<size_t>(2 * group + 1) < match.groups.size() &&
+                   match.groups[2 * group] != RegexMatch::npos) {
+            size_t start = match.groups[2 * group];
+            result += buffer.substr(start, match.groups[2 * group + 1] - start);
+        }
+    }
+    return result;
+}
+
+// 一处替换编辑：把 [offset, offset + length) 换成 text。
+// 相距很近的几处匹配（通常在同一行）合并为一处，中间未变的文本也放进 text
+struct SubstituteEdit {
+    size_t offset;
+    size_t length;
+    std::string text;
+};
+
+// 两处匹配之间未变的文本不超过这个长度时合并为一处编辑
+static const size_t kSubstituteCoalesce = 256;
+// 替换范围超过这个字节数时分段并行查找
+static const size_t kParallelSubstitute = 4 * 1024 * 1024;
+
+// 在起点落在 [firstLine, lastLine) 各行中的匹配处替换，匹配本身不超过 to。
+// 每处编辑的文本一次构造完成；返回替换的次数，lines 累加有替换的行数
+static size_t substituteLines(const PieceTable& buffer, const Regex& regex, const std::string& replacement,
+                              bool global, size_t firstLine, size_t lastLine, size_t to,
+                              std::vector<SubstituteEdit>& edits, size_t& lines) {
+    size_t length = buffer.length();
+    size_t lineCount = buffer.lineCount();
+    size_t limit = lastLine < lineCount ? buffer.lineStart(lastLine) : length + 1;
+    bool expand = replacement.find_first_of("&\\") != std::string::npos;
+    RegexMatcher matcher(regex);
+    PieceTableInput input(buffer);
+    RegexMatch match;
+    size_t count = 0;
+    size_t firstEdit = edits.size();
+    size_t previousEnd = PieceTable::npos;
+    size_t nextLineStart = 0;   // 上一处匹配所在行的下一行行首
+    size_t pos = buffer.lineStart(firstLine);
+    while (pos <= to) {
+        if (regex.isLiteral()) {
+            size_t hit = buffer.find(regex.literal(), pos, to);
+            if (hit == PieceTable::npos) {
+                break;
+            }
+            match.start = hit;
+            match.end = hit + regex.literal().size();
+            match.groups.assign(2, match.start);
+            match.groups[1] = match.end;
+        } else if (!matcher.search(input, pos, to, match, expand)) {
+            break;
+        }
+        if (match.start >= limit) {
+            break;
+        }
+        if (match.start == match.end && match.start == previousEnd) {
+            // 紧接在上一处匹配之后的空匹配不算
+            pos = match.start + 1;
+            continue;
+        }
+        if (match.start >= nextLineStart) {
+            size_t line = buffer.lineOfOffset(match.start);
+            nextLineStart = line + 1 < lineCount ? buffer.lineStart(line + 1) : length + 1;
+            ++lines;
+        }
+        ++count;
+
+        // 与上一处编辑相距很近时接在它后面，否则开始新的一处
+        if (edits.size() > firstEdit && match.start - previousEnd <= kSubstituteCoalesce) {
+            SubstituteEdit& edit = edits.back();
+            edit.text += buffer.substr(previousEnd, match.start - previousEnd);
+        } else {
+            SubstituteEdit edit;
+            edit.offset = match.start;
+            edit.length = 0;
+            edits.push_back(edit);
+        }
+        SubstituteEdit& edit = edits.back();
+        edit.text += expand ? expandReplacement(replacement, buffer, match) : replacement;
+        edit.length = match.end - edit.offset;
+        previousEnd = match.end;
+
+        pos = match.end > match.start ? match.end : match.end + 1;
+        if (!global) {
+            // 非全局替换时每行只替换第一处
+            pos = std::max(pos, nextLineStart);
+        }
+    }
+    return count;
+}
+
 int Editor::replaceText(const std::string& oldText, const std::string& newText, bool global) {
-    int replacementCount = 0;
-    for (auto& line : m_lines) {
-        size_t pos = 0;
-        while ((pos = line.find(oldText, pos)) != std::string::npos) {
-            line.replace(pos, oldText.length(), newText);
-            pos += newText.length();
-            replacementCount++;
-            
-            if (!global) break;
+    int lines = 0;
+    return replaceText(oldText, newText, global, 0, INT_MAX, lines);
+}
+
+int Editor::replaceText(const std::string& oldText, const std::string& newText, bool global,
+                        int firstLine, int lastLine, int& lines) {
+    lines = 0;
+    if (oldText.empty() || oldText.find('\n') != std::string::npos) {
+        return 0;
+    }
+    Regex regex;
+    std::string error;
+    if (!regex.compile(oldText, error)) {
+        m_message = "无效的模式: " + error;
+        return 0;
+    }
+    commitEditLine();
+    m_buffer.indexAll();
+    size_t lineCount = m_buffer.lineCount();
+    size_t first = static_cast<size_t>(std::max(firstLine, 0));
+    size_t last = std::min(static_cast<size_t>(std::max(lastLine, 0)), lineCount - 1) + 1;
+    if (first >= last) {
+        return 0;
+    }
+    // 不跨行的模式只需查到范围末行的行尾
+    size_t rangeBegin = m_buffer.lineStart(first);
+    size_t rangeEnd = last < lineCount ? m_buffer.lineStart(last) - 1 : m_buffer.length();
+    size_t to = regex.matchesLineFeed() ? m_buffer.length() : rangeEnd;
+
+    // 范围较大且匹配不跨行时按字节数均分成若干段，各段的匹配互不影响，可以并行构造
+    std::vector<std::pair<size_t, size_t> > ranges;
+    ThreadPool& pool = ThreadPool::shared();
+    size_t parts = 1;
+    if (!regex.matchesLineFeed() && rangeEnd - rangeBegin > kParallelSubstitute) {
+        parts = std::min(last - first, (pool.size() + 1) * 4);
+    }
+    size_t begin = first;
+    for (size_t k = 1; k <= parts && begin < last; ++k) {
+        size_t end = last;
+        if (k < parts) {
+            size_t split = rangeBegin + (rangeEnd - rangeBegin) / parts * k;
+            end = std::min(last, m_buffer.lineOfOffset(split) + 1);
+        }
+        if (end > begin) {
+            ranges.push_back(std::make_pair(begin, end));
+            begin = end;
+        }
+    }
+    std::vector<std::vector<SubstituteEdit> > edits(ranges.size());
+    std::vector<size_t> counts(ranges.size(), 0);
+    std::vector<size_t> lineCounts(ranges.size(), 0);
+    const PieceTable& buffer = m_buffer;
+    pool.parallelFor(ranges.size(), [&](size_t from, size_t until) {
+        for (size_t r = from; r < until; ++r) {
+            size_t end = ranges[r].second == last ? to : buffer.lineStart(ranges[r].second) - 1;
+            counts[r] = substituteLines(buffer, regex, newText, global, ranges[r].first, ranges[r].second,
+                                        end, edits[r], lineCounts[r]);
+        }
+    });
+
+    // 各处编辑互不重叠，从后往前应用使前面的偏移保持有效；整个替换作为一个撤销事务
+    size_t count = 0;
+    beginEditGroup();
+    for (size_t r = ranges.size(); r > 0; --r) {
+        const std::vector<SubstituteEdit>& part = edits[r - 1];
+        for (size_t i = part.size(); i > 0; --i) {
+            replaceRange(part[i - 1].offset, part[i - 1].length, part[i - 1].text);
         }
+        count += counts[r - 1];
+        lines += static_cast<int>(lineCounts[r - 1]);
     }
-    return replacementCount;
+    endEditGroup();
+    // 跨行的匹配被替换后行数可能减少
+    m_cursorLine = std::min(m_cursorLine, getLineCount() - 1);
+    setCursorColumn(m_cursorColumn);
+    return static_cast<int>(count);
 }
 
 // 实现新增的公共方法
 void Editor::clearLines() {
-    m_lines.clear();
+    m_loader.cancel();
+    m_loadTotal = 0;
+    m_editLine = -1;
+    m_buffer.clear();
+    m_history.clear();
+    m_matchIndex.clear();
+    m_syntax.reset();
+    m_layout.clear();
+    m_wrapLayout.clear();
+    markLinesChanged(0, EditorDamage::kToEnd);
+    m_journal.discard();
+    m_cursorLine = 0;
+    m_cursorColumn = 0;
 }
 
 void Editor::addEmptyLine() {
-    m_lines.push_back("");
+    commitEditLine();
+    replaceRange(m_buffer.length(), 0, "\n");
 }
 
 void Editor::resetCurrentFile() {
@@ -412,12 +1433,14 @@ void VimEditor::handleCommandModeInput(char key) {
             switchMode(EditorMode::NORMAL);
             break;
         case 'q': 
-            // 退出编辑器
+            // 退出编辑器，先等待后台保存结束
+            shutdown();
             exit(0);
             break;
         case 's': 
             // 保存并退出
             if (saveFile()) {
+                shutdown();
                 exit(0);
             } else {
                 // m_statusMessage = "保存失败，无法退出";
@@ -468,25 +1491,45 @@ void VimEditor::deleteText(DeleteType type) {
 
 // 实现新增的方法
 void Editor::updateLine(int lineIndex, const std::string& newContent) {
-    if (lineIndex >= 0 && lineIndex < static_cast<int>(m_lines.size())) {
-        m_lines[static_cast<std::vector<std::string>::size_type>(lineIndex)] = newContent;
+    commitEditLine();
+    if (lineIndex >= 0 && lineIndex < getLineCount()) {
+        size_t start = m_buffer.lineStart(static_cast<size_t>(lineIndex));
+        replaceRange(start, static_cast<size_t>(lineLength(lineIndex)), newContent);
+        setCursorColumn(m_cursorColumn);
     }
 }
 
 void Editor::removeLine(int lineIndex) {
-    if (lineIndex >= 0 && lineIndex < static_cast<int>(m_lines.size())) {
-        m_lines.erase(m_lines.begin() + static_cast<std::vector<std::string>::size_type>(lineIndex));
-        
-        // 如果删除后没有行，添加一个空行
-        if (m_lines.empty()) {
-            m_lines.push_back("");
+    commitEditLine();
+    ensureLineIndexed(lineIndex);
+    if (lineIndex >= 0 && lineIndex < getLineCount()) {
+        size_t start = m_buffer.lineStart(static_cast<size_t>(lineIndex));
+        size_t length = static_cast<size_t>(lineLength(lineIndex));
+        if (lineIndex + 1 < getLineCount()) {
+            // 连同行尾换行符一起删除
+            replaceRange(start, length + 1, "");
+        } else if (lineIndex > 0) {
+            // 最后一行：删除它前面的换行符
+            replaceRange(start - 1, length + 1, "");
+        } else {
+            // 唯一的一行只清空内容，缓冲区始终至少有一行
+            replaceRange(start, length, "");
+        }
+
+        if (m_cursorLine >= getLineCount()) {
+            m_cursorLine = getLineCount() - 1;
         }
+        setCursorColumn(m_cursorColumn);
     }
 }
 
 void Editor::insertLine(int lineIndex, const std::string& line) {
-    if (lineIndex >= 0 && lineIndex <= static_cast<int>(m_lines.size())) {
-        m_lines.insert(m_lines.begin() + static_cast<std::vector<std::string>::size_type>(lineIndex), line);
+    commitEditLine();
+    ensureLineIndexed(lineIndex);
+    if (lineIndex >= 0 && lineIndex < getLineCount()) {
+        replaceRange(m_buffer.lineStart(static_cast<size_t>(lineIndex)), 0, line + "\n");
+    } else if (lineIndex == getLineCount()) {
+        replaceRange(m_buffer.length(), 0, "\n" + line);
     }
 }
 
@@ -496,37 +1539,298 @@ int Editor::getCursorColumn() const {
 
 void Editor::setCursorColumn(int column) {
     // 确保列在有效范围内
-    if (!m_lines.empty()) {
-        int maxColumn = m_lines[m_cursorLine].length();
-        m_cursorColumn = std::max(0, std::min(column, maxColumn));
+    int maxColumn = lineLength(m_cursorLine);
+    column = std::max(0, std::min(column, maxColumn));
+    // 不停在多字节字符中间
+    m_cursorColumn = static_cast<int>(getLineLayout(m_cursorLine).clusterStart(static_cast<size_t>(column)));
+}
+
+// 行号和偏移的上限：更大的数按上限计，相加也不会溢出
+static const int kMaxAddress = INT_MAX / 2;
+
+static int readAddressNumber(const std::string& command, size_t& pos) {
+    int value = 0;
+    while (pos < command.size() && std::isdigit(static_cast<unsigned char>(command[pos]))) {
+        int digit = command[pos++] - '0';
+        value = value <= (kMaxAddress - digit) / 10 ? value * 10 + digit : kMaxAddress;
+    }
+    return value;
+}
+
+// 只跳过一个 ex 地址的文本，不解析，也就不必为 $ 建立完整的行索引
+static bool skipAddress(const std::string& command, size_t& pos) {
+    if (pos >= command.size()) {
+        return false;
+    }
+    char c = command[pos];
+    if (std::isdigit(static_cast<unsigned char>(c))) {
+        readAddressNumber(command, pos);
+    } else if (c == '.' || c == '$') {
+        ++pos;
+    } else if (c != '+' && c != '-') {
+        return false;
+    }
+    while (pos < command.size() && (command[pos] == '+' || command[pos] == '-')) {
+        ++pos;
+        readAddressNumber(command, pos);
+    }
+    return true;
+}
+
+// 返回命令开头范围文本之后的位置，与 parseRange() 停下的位置相同
+static size_t skipRange(const std::string& command) {
+    size_t pos = 0;
+    if (pos < command.size() && command[pos] == '%') {
+        return pos + 1;
+    }
+    if (skipAddress(command, pos) && pos < command.size() && command[pos] == ',') {
+        ++pos;
+        skipAddress(command, pos);
+    }
+    return pos;
+}
+
+// 解析一个 ex 地址：行号、.（光标行）或 $（末行），可带 +N/-N 偏移
+bool Editor::parseAddress(const std::string& command, size_t& pos, int& line) {
+    if (pos < command.size() && std::isdigit(static_cast<unsigned char>(command[pos]))) {
+        line = readAddressNumber(command, pos) - 1;
+    } else if (pos < command.size() && command[pos] == '.') {
+        line = m_cursorLine;
+        ++pos;
+    } else if (pos < command.size() && command[pos] == '$') {
+        // 末行需要完整的行索引
+        m_buffer.indexAll();
+        line = getLineCount() - 1;
+        ++pos;
+    } else if (pos < command.size() && (command[pos] == '+' || command[pos] == '-')) {
+        line = m_cursorLine;
     } else {
-        m_cursorColumn = 0;
+        return false;
+    }
+    while (pos < command.size() && (command[pos] == '+' || command[pos] == '-')) {
+        int sign = command[pos++] == '+' ? 1 : -1;
+        size_t start = pos;
+        int offset = readAddressNumber(command, pos);
+        line += sign * (pos > start ? offset : 1);
+        line = std::max(-kMaxAddress, std::min(line, kMaxAddress));
+    }
+    return true;
+}
+
+bool Editor::parseRange(const std::string& command, size_t& pos, int& firstLine, int& lastLine) {
+    firstLine = lastLine = m_cursorLine;
+    if (pos < command.size() && command[pos] == '%') {
+        ++pos;
+        m_buffer.indexAll();
+        firstLine = 0;
+        lastLine = getLineCount() - 1;
+        return true;
+    }
+    if (!parseAddress(command, pos, firstLine)) {
+        return false;
+    }
+    lastLine = firstLine;
+    if (pos < command.size() && command[pos] == ',') {
+        ++pos;
+        if (!parseAddress(command, pos, lastLine)) {
+            return false;
+        }
     }
+    if (firstLine > lastLine) {
+        std::swap(firstLine, lastLine);
+    }
+    return true;
+}
+
+// 读到未转义的 delimiter 为止；\delimiter 表示分隔符本身，其余转义原样保留
+static std::string readSubstituteField(const std::string& command, size_t& pos, char delimiter) {
+    std::string field;
+    while (pos < command.size() && command[pos] != delimiter) {
+        if (command[pos] == '\\' && pos + 1 < command.size()) {
+            if (command[pos + 1] != delimiter) {
+                field += '\\';
+            }
+            ++pos;
+        }
+        field += command[pos++];
+    }
+    if (pos < command.size()) {
+        ++pos;
+    }
+    return field;
+}
+
+bool Editor::substituteCommand(const std::string& command, size_t pos, int firstLine, int lastLine) {
+    char delimiter = command[pos + 1];
+    pos += 2;
+    std::string pattern = readSubstituteField(command, pos, delimiter);
+    std::string replacement = readSubstituteField(command, pos, delimiter);
+    bool global = false;
+    for (; pos < command.size(); ++pos) {
+        if (command[pos] == 'g') {
+            global = true;
+        } else if (!std::isspace(static_cast<unsigned char>(command[pos]))) {
+            m_message = std::string("无效的标志: ") + command[pos];
+            return false;
+        }
+    }
+    if (pattern.empty()) {
+        // 空模式沿用上次查找的内容
+        if (m_lastSearch.empty()) {
+            m_message = "没有上次查找的内容";
+            return false;
+        }
+        pattern = m_lastSearch;
+    }
+    ensureLineIndexed(lastLine);
+    if (firstLine < 0 || lastLine >= getLineCount()) {
+        m_message = "范围无效";
+        return false;
+    }
+    m_message.clear();
+    int lines = 0;
+    int count = replaceText(pattern, replacement, global, firstLine, lastLine, lines);
+    if (count > 0) {
+        m_message = "已替换 " + formatCount(static_cast<size_t>(count)) + " 处，共 " +
+                    formatCount(static_cast<size_t>(lines)) + " 行";
+    } else if (m_message.empty()) {
+        m_message = "未找到: " + pattern;
+    }
+    return count > 0;
+}
+
+void Editor::getLineKeywords(int lineIndex, size_t column, size_t length,
+                             std::vector<KeywordSpan>& spans) const {
+    spans.clear();
+    if (m_keywords.empty()) {
+        return;
+    }
+    size_t margin = m_keywords.maxLength() - 1;
+    size_t begin = column - std::min(column, margin);
+    std::string text = getLineSegment(lineIndex, begin, length + (column - begin) + margin);
+    std::vector<AhoCorasick::Hit> hits;
+    m_keywords.findAll(text.data(), text.size(), begin, hits);
+    for (size_t i = 0; i < hits.size(); ++i) {
+        size_t size = m_keywords.pattern(hits[i].pattern).size();
+        size_t start = hits[i].end - size;
+        if (hits[i].end > column && start < column + length) {
+            KeywordSpan span = { start, size, hits[i].pattern };
+            spans.push_back(span);
+        }
+    }
+}
+
+void Editor::getLineSyntax(int lineIndex, std::vector<SyntaxSpan>& spans) {
+    if (lineIndex < 0 || lineIndex >= getLineCount()) {
+        spans.clear();
+        return;
+    }
+    m_syntax.highlight(static_cast<size_t>(lineIndex), syntaxSource(), spans);
+}
+
+const LineLayout& Editor::getLineLayout(int lineIndex) {
+    return m_layout.line(static_cast<size_t>(std::max(lineIndex, 0)),
+                         [this](size_t k) { return getLine(static_cast<int>(k)); });
+}
+
+int Editor::getCursorDisplayColumn() {
+    return static_cast<int>(getLineLayout(m_cursorLine).columnOf(static_cast<size_t>(m_cursorColumn)));
+}
+
+std::string Editor::getDisplaySegment(int lineIndex, size_t leftColumn, size_t columns) {
+    // 只取视口涉及的字节，长行也不必整行复制
+    const LineLayout& layout = getLineLayout(lineIndex);
+    size_t begin = layout.byteAt(leftColumn);
+    size_t end = layout.byteAt(leftColumn + columns);
+    end = end < layout.length() ? layout.nextCluster(end) : end;
+    std::string segment = getLineSegment(lineIndex, begin, end - begin);
+    std::string text;
+    layout.render(segment, begin, leftColumn, columns, text);
+    return text;
+}
+
+bool Editor::isWrapEnabled() const {
+    return m_wrap;
+}
+
+const std::vector<size_t>& Editor::getWrapRows(int lineIndex, size_t width) {
+    m_wrapLayout.setWidth(width);
+    return m_wrapLayout.rowStarts(static_cast<size_t>(std::max(lineIndex, 0)), getLineLayout(lineIndex));
+}
+
+int Editor::getCursorWrapRow(size_t width) {
+    m_wrapLayout.setWidth(width);
+    const LineLayout& layout = getLineLayout(m_cursorLine);
+    return static_cast<int>(m_wrapLayout.rowOf(static_cast<size_t>(m_cursorLine), layout,
+                                               layout.columnOf(static_cast<size_t>(m_cursorColumn))));
+}
+
+bool Editor::highlightCommand(const std::vector<std::string>& parts) {
+    if (parts.size() > 2 && parts[1] == "add") {
+        for (size_t i = 2; i < parts.size(); ++i) {
+            m_keywords.add(parts[i]);
+        }
+        m_keywords.build();
+    } else if (parts.size() == 2 && parts[1] == "clear") {
+        m_keywords.clear();
+    } else if (parts.size() == 2 && parts[1] == "count") {
+        // 一遍扫描整个缓冲区，统计每个关键字出现的次数
+        if (m_keywords.empty()) {
+            m_message = "没有高亮关键字";
+            return false;
+        }
+        commitEditLine();
+        std::vector<size_t> counts;
+        m_keywords.countAll(m_buffer, ThreadPool::shared(), counts);
+        m_message.clear();
+        for (size_t i = 0; i < counts.size(); ++i) {
+            m_message += (i > 0 ? " | " : "") + m_keywords.pattern(static_cast<int>(i)) + " " +
+                         formatCount(counts[i]);
+        }
+        return true;
+    } else {
+        return false;
+    }
+    markLinesChanged(0, EditorDamage::kToEnd);
+    return true;
 }
 
 bool Editor::executeCommand(const std::string& command) {
+    // :[范围]s/模式/替换文本/[g]，模式和替换文本中可以有空格，不按空白拆分
+    // 范围只对 s 命令有意义：先跳过，确定后面是 s 命令再解析（$ 和 % 要建立完整的行索引）
+    size_t pos = skipRange(command);
+    if (pos + 1 < command.size() && command[pos] == 's' &&
+        !std::isalnum(static_cast<unsigned char>(command[pos + 1])) &&
+        !std::isspace(static_cast<unsigned char>(command[pos + 1])) && command[pos + 1] != '\\') {
+        size_t rangePos = 0;
+        int firstLine = 0;
+        int lastLine = 0;
+        parseRange(command, rangePos, firstLine, lastLine);
+        return substituteCommand(command, pos, firstLine, lastLine);
+    }
+
     std::vector<std::string> parts = splitCommand(command);
     
     if (parts.empty()) return false;
 
-    if (parts[0] == "w" || parts[0] == "write") {
-        // 保存文件
-        if (parts.size() > 1) {
-            return saveFileAs(parts[1]);
-        } else {
-            return saveFile();
-        }
+    if (parts[0].find_first_not_of("0123456789") == std::string::npos) {
+        // :N 跳转到第 N 行
+        size_t digits = 0;
+        gotoLine(readAddressNumber(parts[0], digits));
+        return true;
+    } else if (parts[0] == "w" || parts[0] == "write") {
+        // 在后台保存文件
+        return saveFileInBackground(parts.size() > 1 ? parts[1] : m_currentFile);
     } else if (parts[0] == "q" || parts[0] == "quit") {
         // 退出编辑器的逻辑应该在 UI 层处理
         return true;
     } else if (parts[0] == "wq") {
-        // 保存并退出
-        if (parts.size() > 1) {
-            saveFileAs(parts[1]);
-        } else {
-            saveFile();
-        }
-        return true;
+        // 保存并退出：即将退出，直接同步保存
+        // 保存失败时不退出，错误信息留给界面显示
+        waitForSave();
+        std::string message;
+        pollSaveResult(message);
+        return parts.size() > 1 ? saveFileAs(parts[1]) : saveFile();
     } else if (parts[0] == "e" || parts[0] == "edit") {
         // 打开文件
         if (parts.size() > 1) {
@@ -534,7 +1838,60 @@ bool Editor::executeCommand(const std::string& command) {
         }
     } else if (parts[0] == "set") {
         // 设置编辑器选项
-        // 可以在这里添加一些配置选项
+        if (parts.size() > 1 && parts[1].compare(0, 7, "syntax=") == 0) {
+            // :set syntax=cpp|json|yaml|log，none 或 off 关闭
+            std::string name = parts[1].substr(7);
+            const SyntaxLanguage* language = SyntaxHighlighter::languageByName(name);
+            if (!language && name != "none" && name != "off") {
+                m_message = "未知语法: " + name;
+                return false;
+            }
+            m_syntax.setLanguage(language);
+            markLinesChanged(0, EditorDamage::kToEnd);
+            return true;
+        }
+        if (parts.size() > 1 && (parts[1] == "wrap" || parts[1] == "nowrap")) {
+            // 长行折成多个屏幕行显示，或者横向滚动
+            m_wrap = parts[1] == "wrap";
+            markLinesChanged(0, EditorDamage::kToEnd);
+            return true;
+        }
+        if (parts.size() > 1 && (parts[1] == "hlsearch" || parts[1] == "nohlsearch")) {
+            // 高亮上次查找的全部匹配
+            m_highlightSearch = parts[1] == "hlsearch";
+            if (m_highlightSearch && !m_lastSearch.empty() && compileSearch(m_lastSearch)) {
+                commitEditLine();
+                updateMatchIndex();
+            }
+            markLinesChanged(0, EditorDamage::kToEnd);
+            return true;
+        }
+    } else if (parts[0] == "r" || parts[0] == "replace") {
+        // :r 模式 [替换文本]，替换全部匹配，替换文本省略时删除匹配
+        if (parts.size() > 1) {
+            m_message.clear();
+            int count = replaceText(parts[1], parts.size() > 2 ? parts[2] : "", true);
+            if (count > 0) {
+                m_message = "已替换 " + formatCount(static_cast<size_t>(count)) + " 处";
+            } else if (m_message.empty()) {
+                m_message = "未找到: " + parts[1];
+            }
+            return count > 0;
+        }
+    } else if (parts[0] == "hl") {
+        return highlightCommand(parts);
+    } else if (parts[0] == "meminfo") {
+        m_message = getMemoryReport();
+        return true;
+    } else if (parts[0] == "recover") {
+        // 从交换文件恢复上次未保存的修改
+        return recoverJournal(m_message);
+    } else if (parts[0] == "discard") {
+        // 放弃交换文件中的修改
+        if (m_journalFound) {
+            discardJournal();
+            return true;
+        }
     }
 
     return false;
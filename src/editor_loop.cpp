@@ -0,0 +1,63 @@
+/**
+ * @file editor_loop.cpp
+ * @brief 编辑器事件循环设置实现
+ */
+#include "../include/editor_loop.h"
+
+EditorLoop::EditorLoop(EventLoop& loop, Editor& editor, std::string& statusMessage,
+                       const std::function<void()>& render) :
+    m_loop(loop),
+    m_editor(editor),
+    m_statusMessage(statusMessage),
+    m_render(render),
+    m_dirty(true),
+    m_progressTimer(0),
+    m_checkTimer(0) {
+    m_editor.setNotifier([&loop]() { loop.post([]() {}); });
+    m_loop.addIdleTask([this]() { return pollLoad(); });
+    m_loop.beforeWait([this]() { beforeWait(); });
+    // 没有输入时也定时醒来，检查映射的文件是否被其他程序修改
+    m_checkTimer = m_loop.addTimer(kCheckIntervalMs, []() {}, true);
+}
+
+EditorLoop::~EditorLoop() {
+    m_loop.cancelTimer(m_checkTimer);
+    m_editor.setNotifier(std::function<void()>());
+}
+
+void EditorLoop::markDirty() {
+    m_dirty = true;
+}
+
+// 载入的内容在空闲时接上，界面随进度定时器刷新，不必每批都重画
+bool EditorLoop::pollLoad() {
+    if (m_editor.pollLoad()) {
+        return true;
+    }
+    m_dirty = m_dirty || !m_editor.isLoading();
+    return false;
+}
+
+void EditorLoop::beforeWait() {
+    if (m_editor.checkMappedFile(m_statusMessage)) {
+        m_dirty = true;
+    }
+    std::string saveMessage;
+    if (m_editor.pollSaveResult(saveMessage)) {
+        m_statusMessage = saveMessage;
+        m_dirty = true;
+    }
+    // 后台保存或载入期间定时刷新状态栏中的进度
+    bool busy = m_editor.isSaving() || m_editor.isLoading();
+    if (busy && m_progressTimer == 0) {
+        m_progressTimer = m_loop.addTimer(100, [this]() { m_dirty = true; }, true);
+    } else if (!busy && m_progressTimer != 0) {
+        m_loop.cancelTimer(m_progressTimer);
+        m_progressTimer = 0;
+        m_dirty = true;
+    }
+    if (m_dirty) {
+        m_render();
+        m_dirty = false;
+    }
+}
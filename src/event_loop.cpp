@@ -0,0 +1,283 @@
+/**
+ * @file event_loop.cpp
+ * @brief 基于 poll() 的事件循环实现
+ */
+#include "../include/event_loop.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// SIGWINCH 只能由一个循环处理：处理函数写入这个管道
+static int s_resizePipe[2] = { -1, -1 };
+static struct sigaction s_previousResize;
+
+static void handleResize(int signal) {
+    int saved = errno;
+    char byte = 0;
+    ssize_t ignored = ::write(s_resizePipe[1], &byte, 1);
+    (void)ignored;
+    // 之前安装的处理函数（如 ncurses 用它调整窗口大小）照常执行
+    if (!(s_previousResize.sa_flags & SA_SIGINFO) && s_previousResize.sa_handler != SIG_DFL &&
+        s_previousResize.sa_handler != SIG_IGN) {
+        s_previousResize.sa_handler(signal);
+    }
+    errno = saved;
+}
+
+static void openPipe(int fds[2]) {
+    if (pipe(fds) != 0) {
+        fds[0] = fds[1] = -1;
+        return;
+    }
+    for (int i = 0; i < 2; ++i) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+}
+
+static void closePipe(int fds[2]) {
+    for (int i = 0; i < 2; ++i) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+}
+
+// 读空管道：多次唤醒合并为一次处理
+static void drain(int fd) {
+    char buffer[64];
+    while (::read(fd, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+EventLoop::EventLoop() :
+    m_nextTimer(1),
+    m_nextIdle(0),
+    m_quit(false) {
+    openPipe(m_wakePipe);
+}
+
+EventLoop::~EventLoop() {
+    if (m_onResize && s_resizePipe[0] >= 0) {
+        sigaction(SIGWINCH, &s_previousResize, NULL);
+        closePipe(s_resizePipe);
+    }
+    closePipe(m_wakePipe);
+}
+
+void EventLoop::watch(int fd, const Callback& onReadable) {
+    unwatch(fd);
+    Watch entry = { fd, onReadable };
+    m_watches.push_back(entry);
+}
+
+void EventLoop::unwatch(int fd) {
+    for (size_t i = 0; i < m_watches.size(); ++i) {
+        if (m_watches[i].fd == fd) {
+            m_watches.erase(m_watches.begin() + static_cast<std::ptrdiff_t>(i));
+            return;
+        }
+    }
+}
+
+int EventLoop::addTimer(int milliseconds, const Callback& callback, bool repeat) {
+    Timer timer;
+    timer.id = m_nextTimer++;
+    timer.interval = std::chrono::milliseconds(std::max(0, milliseconds));
+    timer.deadline = Clock::now() + timer.interval;
+    timer.callback = callback;
+    timer.repeat = repeat;
+    m_timers.push_back(timer);
+    return timer.id;
+}
+
+void EventLoop::cancelTimer(int id) {
+    for (size_t i = 0; i < m_timers.size(); ++i) {
+        if (m_timers[i].id == id) {
+            m_timers.erase(m_timers.begin() + static_cast<std::ptrdiff_t>(i));
+            return;
+        }
+    }
+}
+
+void EventLoop::addIdleTask(const IdleTask& task) {
+    Idle idle = { task, true };
+    m_idle.push_back(idle);
+}
+
+void EventLoop::onResize(const Callback& callback) {
+    if (!m_onResize && s_resizePipe[0] < 0) {
+        openPipe(s_resizePipe);
+        struct sigaction action;
+        action.sa_handler = handleResize;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGWINCH, &action, &s_previousResize);
+    }
+    m_onResize = callback;
+}
+
+void EventLoop::beforeWait(const Callback& callback) {
+    m_beforeWait = callback;
+}
+
+void EventLoop::post(const Callback& callback) {
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        m_posted.push_back(callback);
+    }
+    char byte = 0;
+    ssize_t ignored = ::write(m_wakePipe[1], &byte, 1);
+    (void)ignored;
+}
+
+void EventLoop::quit() {
+    m_quit = true;
+}
+
+void EventLoop::run() {
+    m_quit = false;
+    std::vector<struct pollfd> fds;
+    while (!m_quit) {
+        if (m_beforeWait) {
+            m_beforeWait();
+            if (m_quit) {
+                break;
+            }
+        }
+
+        // 还有空闲任务时只检查一下有没有事件，不等待
+        bool idle = false;
+        for (size_t i = 0; i < m_idle.size() && !idle; ++i) {
+            idle = m_idle[i].pending;
+        }
+        int timeout = idle ? 0 : timeUntilNextTimer();
+
+        fds.clear();
+        struct pollfd wake = { m_wakePipe[0], POLLIN, 0 };
+        fds.push_back(wake);
+        struct pollfd resize = { m_onResize ? s_resizePipe[0] : -1, POLLIN, 0 };
+        fds.push_back(resize);
+        for (size_t i = 0; i < m_watches.size(); ++i) {
+            struct pollfd entry = { m_watches[i].fd, POLLIN, 0 };
+            fds.push_back(entry);
+        }
+        int ready = poll(&fds[0], static_cast<nfds_t>(fds.size()), timeout);
+        if (ready < 0) {
+            if (errno != EINTR) {
+                break;
+            }
+            // 被信号打断：SIGWINCH 的字节已在管道中，下一轮处理
+            continue;
+        }
+
+        if (ready > 0) {
+            markIdlePending();
+            if (fds[0].revents) {
+                drain(m_wakePipe[0]);
+                runPosted();
+            }
+            if (fds[1].revents) {
+                drain(s_resizePipe[0]);
+                m_onResize();
+            }
+            // 回调可能增删监视的描述符，按描述符而不是下标找回调
+            for (size_t i = 2; i < fds.size() && !m_quit; ++i) {
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                    continue;
+                }
+                for (size_t w = 0; w < m_watches.size(); ++w) {
+                    if (m_watches[w].fd == fds[i].fd) {
+                        Callback callback = m_watches[w].callback;
+                        callback();
+                        break;
+                    }
+                }
+            }
+        }
+        runTimers();
+        if (ready == 0 && !m_quit) {
+            runIdleSlice();
+        }
+    }
+}
+
+int EventLoop::timeUntilNextTimer() const {
+    if (m_timers.empty()) {
+        return -1;
+    }
+    Clock::time_point next = m_timers[0].deadline;
+    for (size_t i = 1; i < m_timers.size(); ++i) {
+        next = std::min(next, m_timers[i].deadline);
+    }
+    Clock::time_point now = Clock::now();
+    if (next <= now) {
+        return 0;
+    }
+    // 向上取整，避免醒得过早而空转一轮
+    std::chrono::microseconds wait = std::chrono::duration_cast<std::chrono::microseconds>(next - now);
+    return static_cast<int>((wait.count() + 999) / 1000);
+}
+
+void EventLoop::runTimers() {
+    Clock::time_point now = Clock::now();
+    // 回调中可能增删定时器，先找出到期的编号
+    std::vector<int> expired;
+    for (size_t i = 0; i < m_timers.size(); ++i) {
+        if (m_timers[i].deadline <= now) {
+            expired.push_back(m_timers[i].id);
+        }
+    }
+    for (size_t e = 0; e < expired.size() && !m_quit; ++e) {
+        for (size_t i = 0; i < m_timers.size(); ++i) {
+            if (m_timers[i].id != expired[e]) {
+                continue;
+            }
+            Callback callback = m_timers[i].callback;
+            if (m_timers[i].repeat) {
+                m_timers[i].deadline = now + m_timers[i].interval;
+            } else {
+                m_timers.erase(m_timers.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+            markIdlePending();
+            callback();
+            break;
+        }
+    }
+}
+
+void EventLoop::runPosted() {
+    std::vector<Callback> posted;
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        posted.swap(m_posted);
+    }
+    for (size_t i = 0; i < posted.size(); ++i) {
+        posted[i]();
+    }
+}
+
+// 各任务轮流执行，一个任务有很多工作时也不会饿死其他任务
+bool EventLoop::runIdleSlice() {
+    for (size_t n = 0; n < m_idle.size(); ++n) {
+        size_t index = (m_nextIdle + n) % m_idle.size();
+        if (!m_idle[index].pending) {
+            continue;
+        }
+        m_nextIdle = index + 1;
+        m_idle[index].pending = m_idle[index].task();
+        return true;
+    }
+    return false;
+}
+
+// 事件可能带来新的后台工作，所有空闲任务都再检查一次
+void EventLoop::markIdlePending() {
+    for (size_t i = 0; i < m_idle.size(); ++i) {
+        m_idle[i].pending = true;
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * @file file_loader.cpp
+ * @brief 后台载入文件实现
+ */
+#include "../include/file_loader.h"
+#include <algorithm>
+
+const size_t FileLoader::kBatchBytes;
+
+FileLoader::FileLoader() :
+    m_data(NULL),
+    m_totalBytes(0),
+    m_running(false),
+    m_cancel(false),
+    m_bytesScanned(0) {}
+
+FileLoader::~FileLoader() {
+    cancel();
+}
+
+void FileLoader::start(const std::shared_ptr<TextBlock>& block, const char* data, size_t length) {
+    cancel();
+    // 持有文本块，扫描期间映射不会被解除
+    m_block = block;
+    m_data = data;
+    m_totalBytes = length;
+    m_bytesScanned.store(0);
+    m_cancel.store(false);
+    m_running.store(true);
+    m_worker = std::thread(&FileLoader::run, this);
+}
+
+void FileLoader::run() {
+    size_t done = 0;
+    while (done < m_totalBytes && !m_cancel.load(std::memory_order_relaxed)) {
+        size_t length = std::min(kBatchBytes, m_totalBytes - done);
+        std::vector<PieceTable::Piece> pieces;
+        std::vector<size_t> crlf;
+        PieceTable::scanOriginal(m_data + done, length, pieces, crlf);
+        done += length;
+        m_bytesScanned.store(done, std::memory_order_relaxed);
+
+        std::function<void()> notify;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // 界面还没取走上一批时不再唤醒，它下次会一并取走
+            if (m_pieces.empty()) {
+                notify = m_onProgress;
+            }
+            m_pieces.insert(m_pieces.end(), pieces.begin(), pieces.end());
+            m_crlf.insert(m_crlf.end(), crlf.begin(), crlf.end());
+        }
+        if (notify) {
+            notify();
+        }
+    }
+    m_running.store(false);
+}
+
+void FileLoader::cancel() {
+    m_cancel.store(true);
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    m_running.store(false);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pieces.clear();
+    m_crlf.clear();
+    m_block.reset();
+}
+
+bool FileLoader::isRunning() const {
+    return m_running.load();
+}
+
+size_t FileLoader::getBytesScanned() const {
+    return m_bytesScanned.load(std::memory_order_relaxed);
+}
+
+size_t FileLoader::getTotalBytes() const {
+    return m_totalBytes;
+}
+
+bool FileLoader::takePieces(std::vector<PieceTable::Piece>& pieces, std::vector<size_t>& crlf) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pieces.empty()) {
+        return false;
+    }
+    pieces.insert(pieces.end(), m_pieces.begin(), m_pieces.end());
+    crlf.insert(crlf.end(), m_crlf.begin(), m_crlf.end());
+    m_pieces.clear();
+    m_crlf.clear();
+    return true;
+}
+
+void FileLoader::setProgressCallback(const std::function<void()>& callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_onProgress = callback;
+}
@@ -0,0 +1,323 @@
+/**
+ * @file file_saver.cpp
+ * @brief 文件保存引擎实现
+ *
+ * 大纲：
+ * 1. 路径辅助函数
+ * 2. 批量写出缓冲区片段
+ * 3. 临时文件、fsync 与原子替换，保持原文件的属主、权限和扩展属性
+ * 4. 无法替换时就地写入
+ */
+#include "../include/file_saver.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/xattr.h>
+#endif
+#endif
+
+// 单次 writev 最多提交的片段数
+static const size_t kMaxBatch = 1024;
+
+static std::string directoryOf(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+}
+
+static std::string baseNameOf(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+FileSaver::FileSaver(const PieceTable& buffer) :
+    m_buffer(buffer),
+    m_bytesWritten(0),
+    m_progress(NULL) {}
+
+const std::string& FileSaver::getError() const {
+    return m_error;
+}
+
+size_t FileSaver::getBytesWritten() const {
+    return m_bytesWritten;
+}
+
+void FileSaver::setProgressCounter(std::atomic<size_t>* counter) {
+    m_progress = counter;
+}
+
+void FileSaver::setBeforeInPlace(const std::function<void(int)>& callback) {
+    m_beforeInPlace = callback;
+}
+
+void FileSaver::reportProgress() {
+    if (m_progress) {
+        m_progress->store(m_bytesWritten, std::memory_order_relaxed);
+    }
+}
+
+bool FileSaver::fail(const std::string& message) {
+    m_error = message + ": " + std::strerror(errno);
+    return false;
+}
+
+#ifdef _WIN32
+bool FileSaver::writeContent(int fd) {
+    PieceTable::SpanIterator it = m_buffer.spans(0, m_buffer.length());
+    const char* data;
+    size_t length;
+    bool more = it.next(data, length);
+    bool newline = m_buffer.length() > 0;
+    while (more || newline) {
+        if (!more) {
+            data = "\n";
+            length = 1;
+            newline = false;
+        }
+        while (length > 0) {
+            unsigned int chunk = static_cast<unsigned int>(std::min<size_t>(length, 1u << 30));
+            int written = _write(fd, data, chunk);
+            if (written < 0) {
+                return fail("写入失败");
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+            m_bytesWritten += static_cast<size_t>(written);
+        }
+        reportProgress();
+        if (more) {
+            more = it.next(data, length);
+        }
+    }
+    return true;
+}
+
+bool FileSaver::save(const std::string& filename) {
+    m_error.clear();
+    m_bytesWritten = 0;
+    std::string temp = directoryOf(filename) + "\\." + baseNameOf(filename) + ".vimints-tmp";
+    int fd = _open(temp.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+    if (fd < 0) {
+        return fail("无法创建临时文件 " + temp);
+    }
+    bool ok = writeContent(fd) && (_commit(fd) == 0 || fail("同步失败"));
+    if (_close(fd) != 0 && ok) {
+        ok = fail("关闭文件失败");
+    }
+    if (ok && !MoveFileExA(temp.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        ok = fail("无法替换 " + filename);
+    }
+    if (!ok) {
+        _unlink(temp.c_str());
+    }
+    return ok;
+}
+#else
+// 写出整批 iovec，处理部分写入
+static bool writeBatch(int fd, struct iovec* iov, int count, size_t& written) {
+    while (count > 0) {
+        ssize_t result = writev(fd, iov, count);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        size_t done = static_cast<size_t>(result);
+        written += done;
+        while (count > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+            iov->iov_len -= done;
+        }
+    }
+    return true;
+}
+
+// 片段直接作为 iovec 提交，内容不经过任何中间缓冲区
+bool FileSaver::writeContent(int fd) {
+    std::vector<struct iovec> batch;
+    batch.reserve(kMaxBatch);
+    PieceTable::SpanIterator it = m_buffer.spans(0, m_buffer.length());
+    const char* data;
+    size_t length;
+    while (it.next(data, length)) {
+        struct iovec entry;
+        entry.iov_base = const_cast<char*>(data);
+        entry.iov_len = length;
+        batch.push_back(entry);
+        if (batch.size() == kMaxBatch) {
+            if (!writeBatch(fd, &batch[0], static_cast<int>(batch.size()), m_bytesWritten)) {
+                return fail("写入失败");
+            }
+            batch.clear();
+            reportProgress();
+        }
+    }
+    if (m_buffer.length() > 0) {
+        static char newline = '\n';
+        struct iovec entry;
+        entry.iov_base = &newline;
+        entry.iov_len = 1;
+        batch.push_back(entry);
+    }
+    if (!batch.empty() && !writeBatch(fd, &batch[0], static_cast<int>(batch.size()), m_bytesWritten)) {
+        return fail("写入失败");
+    }
+    reportProgress();
+    return true;
+}
+
+// 新文件的默认权限：0666 去掉 umask。umask 只能先改后读，因此在静态初始化时
+// （只有主线程）读取一次，保存线程不再改动整个进程的 umask
+static mode_t readDefaultFileMode() {
+    mode_t mask = umask(0);
+    umask(mask);
+    return 0666 & ~mask;
+}
+
+static const mode_t s_defaultFileMode = readDefaultFileMode();
+
+// 把原文件的扩展属性（ACL、SELinux 标签等）复制到临时文件，任何一项失败都返回 false。
+// 其他系统上扩展属性的接口不同，不复制
+static bool copyExtendedAttributes(const std::string& source, int fd) {
+    #ifdef __linux__
+    ssize_t size = listxattr(source.c_str(), NULL, 0);
+    if (size <= 0) {
+        return size == 0 || errno == ENOTSUP;
+    }
+    std::vector<char> names(static_cast<size_t>(size));
+    size = listxattr(source.c_str(), &names[0], names.size());
+    if (size < 0) {
+        return false;
+    }
+    std::vector<char> value;
+    for (size_t pos = 0; pos < static_cast<size_t>(size); pos += std::strlen(&names[pos]) + 1) {
+        const char* name = &names[pos];
+        ssize_t length = getxattr(source.c_str(), name, NULL, 0);
+        if (length < 0) {
+            return false;
+        }
+        value.resize(static_cast<size_t>(length) + 1);
+        length = getxattr(source.c_str(), name, &value[0], value.size());
+        if (length < 0 || fsetxattr(fd, name, &value[0], static_cast<size_t>(length), 0) != 0) {
+            return false;
+        }
+    }
+    #else
+    (void)source;
+    (void)fd;
+    #endif
+    return true;
+}
+
+// 就地写入：文件的 inode、硬链接、属主和扩展属性都不变，但不是原子的。
+// 先预留空间，磁盘已满时在改动内容之前就失败
+bool FileSaver::saveInPlace(const std::string& target) {
+    int fd = open(target.c_str(), O_WRONLY);
+    if (fd < 0) {
+        return fail("无法写入 " + target);
+    }
+    if (m_beforeInPlace) {
+        m_beforeInPlace(fd);
+    }
+    off_t total = static_cast<off_t>(m_buffer.length() + (m_buffer.length() > 0 ? 1 : 0));
+    bool ok = true;
+    #ifdef __linux__
+    int reserved = total > 0 ? posix_fallocate(fd, 0, total) : 0;
+    if (reserved != 0 && reserved != EOPNOTSUPP && reserved != EINVAL) {
+        errno = reserved;
+        ok = fail("无法预留空间");
+    }
+    #endif
+    ok = ok && writeContent(fd);
+    ok = ok && (ftruncate(fd, total) == 0 || fail("无法截断文件"));
+    ok = ok && (fsync(fd) == 0 || fail("同步失败"));
+    if (close(fd) != 0 && ok) {
+        ok = fail("关闭文件失败");
+    }
+    return ok;
+}
+
+bool FileSaver::save(const std::string& filename) {
+    m_error.clear();
+    m_bytesWritten = 0;
+
+    // 目标是符号链接时替换它指向的文件，而不是链接本身
+    std::string target = filename;
+    char resolved[PATH_MAX];
+    struct stat info;
+    if (lstat(filename.c_str(), &info) == 0 && S_ISLNK(info.st_mode) &&
+        realpath(filename.c_str(), resolved) != NULL) {
+        target = resolved;
+    }
+
+    // 有多个硬链接时，替换会使其他链接仍指向旧的内容
+    bool exists = stat(target.c_str(), &info) == 0;
+    if (exists && info.st_nlink > 1) {
+        return saveInPlace(target);
+    }
+
+    // 临时文件与目标位于同一目录，保证 rename 不跨文件系统
+    std::string directory = directoryOf(target);
+    std::string pattern = directory + "/." + baseNameOf(target) + ".vimints-XXXXXX";
+    std::vector<char> temp(pattern.begin(), pattern.end());
+    temp.push_back('\0');
+    int fd = mkstemp(&temp[0]);
+    if (fd < 0) {
+        // 目录不可写，但文件本身可能可写
+        return exists ? saveInPlace(target) : fail("无法创建临时文件 " + pattern);
+    }
+
+    if (exists) {
+        // 先改属主再设权限（改属主会清除 setuid 位）；没有权限保持原属主，
+        // 或扩展属性无法复制时，改为就地写入
+        if (fchown(fd, info.st_uid, info.st_gid) != 0 || fchmod(fd, info.st_mode & 07777) != 0 ||
+            !copyExtendedAttributes(target, fd)) {
+            close(fd);
+            unlink(&temp[0]);
+            return saveInPlace(target);
+        }
+    }
+    bool ok = exists || fchmod(fd, s_defaultFileMode) == 0 || fail("无法设置权限");
+    ok = ok && writeContent(fd);
+    ok = ok && (fsync(fd) == 0 || fail("同步失败"));
+    if (close(fd) != 0 && ok) {
+        ok = fail("关闭文件失败");
+    }
+    if (ok && rename(&temp[0], target.c_str()) != 0) {
+        ok = fail("无法替换 " + target);
+    }
+    if (!ok) {
+        unlink(&temp[0]);
+        return false;
+    }
+
+    // 同步目录项，确保 rename 本身也已落盘
+    int dirFd = open(directory.c_str(), O_RDONLY);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        close(dirFd);
+    }
+    return true;
+}
+#endif
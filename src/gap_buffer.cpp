@@ -0,0 +1,98 @@
+/**
+ * @file gap_buffer.cpp
+ * @brief 间隙缓冲区实现
+ */
+#include "../include/gap_buffer.h"
+#include <algorithm>
+#include <cstring>
+
+const size_t GapBuffer::kMinGap;
+
+GapBuffer::GapBuffer() :
+    m_gapStart(0),
+    m_gapEnd(0) {}
+
+void GapBuffer::clear() {
+    m_gapStart = 0;
+    m_gapEnd = m_data.size();
+}
+
+void GapBuffer::append(const char* text, size_t length) {
+    insert(this->length(), text, length);
+}
+
+size_t GapBuffer::length() const {
+    return m_data.size() - (m_gapEnd - m_gapStart);
+}
+
+char GapBuffer::at(size_t position) const {
+    return position < m_gapStart ? m_data[position] : m_data[position + (m_gapEnd - m_gapStart)];
+}
+
+std::string GapBuffer::substr(size_t position, size_t length) const {
+    std::string result;
+    size_t end = std::min(position + length, this->length());
+    if (position >= end) {
+        return result;
+    }
+    result.reserve(end - position);
+    // 空隙前后两段分别复制
+    if (position < m_gapStart) {
+        size_t before = std::min(end, m_gapStart);
+        result.append(&m_data[position], before - position);
+        position = before;
+    }
+    if (position < end) {
+        size_t gap = m_gapEnd - m_gapStart;
+        result.append(&m_data[position + gap], end - position);
+    }
+    return result;
+}
+
+void GapBuffer::insert(size_t position, const char* text, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    reserveGap(length);
+    moveGap(position);
+    std::memcpy(&m_data[m_gapStart], text, length);
+    m_gapStart += length;
+}
+
+void GapBuffer::erase(size_t position, size_t length) {
+    moveGap(position);
+    m_gapEnd += std::min(length, m_data.size() - m_gapEnd);
+}
+
+// 把空隙移到 position 处，只搬动两者之间的字节
+void GapBuffer::moveGap(size_t position) {
+    if (position < m_gapStart) {
+        size_t count = m_gapStart - position;
+        std::memmove(&m_data[m_gapEnd - count], &m_data[position], count);
+        m_gapStart -= count;
+        m_gapEnd -= count;
+    } else if (position > m_gapStart) {
+        size_t count = position - m_gapStart;
+        std::memmove(&m_data[m_gapStart], &m_data[m_gapEnd], count);
+        m_gapStart += count;
+        m_gapEnd += count;
+    }
+}
+
+void GapBuffer::reserveGap(size_t length) {
+    if (m_gapEnd - m_gapStart >= length) {
+        return;
+    }
+    size_t used = this->length();
+    size_t capacity = std::max(used * 2, used + length + kMinGap);
+    std::vector<char> data(capacity);
+    size_t tail = m_data.size() - m_gapEnd;
+    if (m_gapStart > 0) {
+        std::memcpy(&data[0], &m_data[0], m_gapStart);
+    }
+    if (tail > 0) {
+        std::memcpy(&data[capacity - tail], &m_data[m_gapEnd], tail);
+    }
+    m_data.swap(data);
+    m_gapEnd = capacity - tail;
+}
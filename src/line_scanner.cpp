@@ -0,0 +1,391 @@
+/**
+ * @file line_scanner.cpp
+ * @brief 换行符扫描实现
+ *
+ * 大纲：
+ * 1. 位运算辅助函数
+ * 2. 标量实现
+ * 3. SSE2 / AVX2 实现：一次比较 16/32 字节，用掩码的位计数统计换行符；
+ *    查找子串时同时比较候选位置的首字节和尾字节，两者都相同才逐字节比较；
+ *    按有符号字节比较，小于 0x20 即为控制字符或 UTF-8 的多字节序列
+ * 4. 运行时选择实现
+ */
+#include "../include/line_scanner.h"
+#include <atomic>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VIMINTS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VIMINTS_TARGET(name) __attribute__((target(name)))
+#else
+#define VIMINTS_TARGET(name)
+#endif
+
+static inline unsigned popCount32(unsigned value) {
+    #if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_popcount(value));
+    #else
+    value = value - ((value >> 1) & 0x55555555u);
+    value = (value & 0x33333333u) + ((value >> 2) & 0x33333333u);
+    return (((value + (value >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+    #endif
+}
+
+static inline unsigned lowestBit32(unsigned value) {
+    #if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctz(value));
+    #elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<unsigned>(index);
+    #else
+    unsigned index = 0;
+    while (!(value & 1u)) {
+        value >>= 1;
+        ++index;
+    }
+    return index;
+    #endif
+}
+
+// 在掩码中找第 nth 个置位（nth 从 1 开始，调用方保证存在）
+static inline unsigned nthBit32(unsigned mask, size_t nth) {
+    while (--nth > 0) {
+        mask &= mask - 1;
+    }
+    return lowestBit32(mask);
+}
+
+// 标量实现
+static LineBreakCounts countScalar(const char* data, size_t length, bool previousCR) {
+    LineBreakCounts counts = { 0, 0 };
+    for (size_t i = 0; i < length; ++i) {
+        char c = data[i];
+        if (c == '\n') {
+            counts.lineFeeds++;
+            if (previousCR) {
+                counts.crlf++;
+            }
+        }
+        previousCR = (c == '\r');
+    }
+    return counts;
+}
+
+static LineBreakCounts countScalar(const char* data, size_t length) {
+    return countScalar(data, length, false);
+}
+
+static size_t findNthScalar(const char* data, size_t length, size_t nth) {
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] == '\n' && --nth == 0) {
+            return i;
+        }
+    }
+    return length;
+}
+
+// 候选位置的首尾字节已相同，比较中间部分
+static inline bool matchesAt(const char* candidate, const char* pattern, size_t patternLength) {
+    return patternLength <= 2 || std::memcmp(candidate + 1, pattern + 1, patternLength - 2) == 0;
+}
+
+// 标量实现：memchr 定位首字节
+static size_t findPatternScalar(const char* data, size_t length, const char* pattern, size_t patternLength) {
+    if (patternLength > length) {
+        return length;
+    }
+    const char* cursor = data;
+    const char* last = data + (length - patternLength);
+    while (cursor <= last) {
+        const void* hit = std::memchr(cursor, pattern[0], static_cast<size_t>(last - cursor) + 1);
+        if (!hit) {
+            break;
+        }
+        const char* candidate = static_cast<const char*>(hit);
+        if (candidate[patternLength - 1] == pattern[patternLength - 1] &&
+            matchesAt(candidate, pattern, patternLength)) {
+            return static_cast<size_t>(candidate - data);
+        }
+        cursor = candidate + 1;
+    }
+    return length;
+}
+
+static inline bool isPrintableAscii(char c) {
+    return c >= 0x20 && c < 0x7F;
+}
+
+static size_t skipPrintableScalar(const char* data, size_t length) {
+    size_t i = 0;
+    while (i < length && isPrintableAscii(data[i])) {
+        ++i;
+    }
+    return i;
+}
+
+#ifdef VIMINTS_X86
+// SSE2 实现
+VIMINTS_TARGET("sse2")
+static LineBreakCounts countSse2(const char* data, size_t length) {
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    LineBreakCounts counts = { 0, 0 };
+    unsigned carry = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned lfMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lineFeed)));
+        unsigned crMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, carriageReturn)));
+        counts.lineFeeds += popCount32(lfMask);
+        counts.crlf += popCount32(lfMask & ((crMask << 1) | carry));
+        carry = (crMask >> 15) & 1u;
+    }
+    LineBreakCounts tail = countScalar(data + i, length - i, carry != 0);
+    counts.lineFeeds += tail.lineFeeds;
+    counts.crlf += tail.crlf;
+    return counts;
+}
+
+VIMINTS_TARGET("sse2")
+static size_t findNthSse2(const char* data, size_t length, size_t nth) {
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lineFeed)));
+        size_t count = popCount32(mask);
+        if (nth <= count) {
+            return i + nthBit32(mask, nth);
+        }
+        nth -= count;
+    }
+    size_t found = findNthScalar(data + i, length - i, nth);
+    return i + found;
+}
+
+VIMINTS_TARGET("sse2")
+static size_t findPatternSse2(const char* data, size_t length, const char* pattern, size_t patternLength) {
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[patternLength - 1]);
+    size_t i = 0;
+    for (; i + patternLength - 1 + 16 <= length; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + patternLength - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+        while (mask) {
+            unsigned bit = lowestBit32(mask);
+            if (matchesAt(data + i + bit, pattern, patternLength)) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return i + findPatternScalar(data + i, length - i, pattern, patternLength);
+}
+
+VIMINTS_TARGET("sse2")
+static size_t skipPrintableSse2(const char* data, size_t length) {
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmplt_epi8(block, space), _mm_cmpeq_epi8(block, del))));
+        if (mask) {
+            return i + lowestBit32(mask);
+        }
+    }
+    return i + skipPrintableScalar(data + i, length - i);
+}
+
+// AVX2 实现
+VIMINTS_TARGET("avx2")
+static LineBreakCounts countAvx2(const char* data, size_t length) {
+    const __m256i lineFeed = _mm256_set1_epi8('\n');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+    LineBreakCounts counts = { 0, 0 };
+    unsigned carry = 0;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        unsigned lfMask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lineFeed)));
+        unsigned crMask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, carriageReturn)));
+        counts.lineFeeds += popCount32(lfMask);
+        if (crMask | carry) {
+            counts.crlf += popCount32(lfMask & ((crMask << 1) | carry));
+        }
+        carry = crMask >> 31;
+    }
+    LineBreakCounts tail = countScalar(data + i, length - i, carry != 0);
+    counts.lineFeeds += tail.lineFeeds;
+    counts.crlf += tail.crlf;
+    return counts;
+}
+
+VIMINTS_TARGET("avx2")
+static size_t findNthAvx2(const char* data, size_t length, size_t nth) {
+    const __m256i lineFeed = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lineFeed)));
+        size_t count = popCount32(mask);
+        if (nth <= count) {
+            return i + nthBit32(mask, nth);
+        }
+        nth -= count;
+    }
+    size_t found = findNthScalar(data + i, length - i, nth);
+    return i + found;
+}
+
+VIMINTS_TARGET("avx2")
+static size_t findPatternAvx2(const char* data, size_t length, const char* pattern, size_t patternLength) {
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[patternLength - 1]);
+    size_t i = 0;
+    for (; i + patternLength - 1 + 32 <= length; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + patternLength - 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last))));
+        while (mask) {
+            unsigned bit = lowestBit32(mask);
+            if (matchesAt(data + i + bit, pattern, patternLength)) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return i + findPatternScalar(data + i, length - i, pattern, patternLength);
+}
+
+VIMINTS_TARGET("avx2")
+static size_t skipPrintableAvx2(const char* data, size_t length) {
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpgt_epi8(space, block), _mm256_cmpeq_epi8(block, del))));
+        if (mask) {
+            return i + lowestBit32(mask);
+        }
+    }
+    return i + skipPrintableScalar(data + i, length - i);
+}
+#endif
+
+// 运行时选择
+ScanKernel bestScanKernel() {
+    #if defined(VIMINTS_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ScanKernel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return ScanKernel::SSE2;
+    }
+    #elif defined(VIMINTS_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info, 7, 0);
+        if (osSavesYmm && (info[1] & (1 << 5))) {
+            return ScanKernel::AVX2;
+        }
+    }
+    return ScanKernel::SSE2;
+    #endif
+    return ScanKernel::SCALAR;
+}
+
+static std::atomic<int>& kernelSlot() {
+    static std::atomic<int> kernel(static_cast<int>(bestScanKernel()));
+    return kernel;
+}
+
+ScanKernel activeScanKernel() {
+    return static_cast<ScanKernel>(kernelSlot().load(std::memory_order_relaxed));
+}
+
+void setScanKernel(ScanKernel kernel) {
+    // 不支持的实现退回到标量版本
+    #ifndef VIMINTS_X86
+    kernel = ScanKernel::SCALAR;
+    #endif
+    if (kernel == ScanKernel::AVX2 && bestScanKernel() != ScanKernel::AVX2) {
+        kernel = bestScanKernel();
+    }
+    kernelSlot().store(static_cast<int>(kernel), std::memory_order_relaxed);
+}
+
+const char* scanKernelName(ScanKernel kernel) {
+    switch (kernel) {
+        case ScanKernel::AVX2: return "avx2";
+        case ScanKernel::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+LineBreakCounts countLineBreaks(const char* data, size_t length) {
+    switch (activeScanKernel()) {
+        #ifdef VIMINTS_X86
+        case ScanKernel::AVX2: return countAvx2(data, length);
+        case ScanKernel::SSE2: return countSse2(data, length);
+        #endif
+        default: return countScalar(data, length);
+    }
+}
+
+size_t countLineFeeds(const char* data, size_t length) {
+    return countLineBreaks(data, length).lineFeeds;
+}
+
+size_t findNthLineFeed(const char* data, size_t length, size_t nth) {
+    if (nth == 0) {
+        return length;
+    }
+    switch (activeScanKernel()) {
+        #ifdef VIMINTS_X86
+        case ScanKernel::AVX2: return findNthAvx2(data, length, nth);
+        case ScanKernel::SSE2: return findNthSse2(data, length, nth);
+        #endif
+        default: return findNthScalar(data, length, nth);
+    }
+}
+
+size_t findPattern(const char* data, size_t length, const char* pattern, size_t patternLength) {
+    if (patternLength == 0 || patternLength > length) {
+        return patternLength == 0 ? 0 : length;
+    }
+    switch (activeScanKernel()) {
+        #ifdef VIMINTS_X86
+        case ScanKernel::AVX2: return findPatternAvx2(data, length, pattern, patternLength);
+        case ScanKernel::SSE2: return findPatternSse2(data, length, pattern, patternLength);
+        #endif
+        default: return findPatternScalar(data, length, pattern, patternLength);
+    }
+}
+
+size_t skipPrintableAscii(const char* data, size_t length) {
+    switch (activeScanKernel()) {
+        #ifdef VIMINTS_X86
+        case ScanKernel::AVX2: return skipPrintableAvx2(data, length);
+        case ScanKernel::SSE2: return skipPrintableSse2(data, length);
+        #endif
+        default: return skipPrintableScalar(data, length);
+    }
+}
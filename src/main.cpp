@@ -9,6 +9,7 @@
  * 4. 主程序循环
  * 5. 异常处理和资源清理
  */
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <locale>
@@ -19,7 +20,10 @@
 #include <fcntl.h>
 #endif
 #include "../include/editor.h"
+#include "../include/ui.h"
+#ifdef VIMINTS_NCURSES
 #include "../include/ui_ncurses.h"
+#endif
 #include "../include/command.h"
 #include "../include/utils.h"
 int main(int argc, char* argv[]) {
@@ -49,8 +53,42 @@ int main(int argc, char* argv[]) {
         if (argc > 1) {
             editor.openFile(argv[1]);
         }
+
+        // 另一个会话正在编辑这个文件：它的交换文件不能恢复也不能删除，只给出提示
+        std::string owner;
+        if (editor.isEditedElsewhere(owner)) {
+            printUTF8("注意：" + editor.getCurrentFile() + " 正在被另一个 vimints（" + owner +
+                      "）编辑，两边的修改互不可见，本次的修改记录在单独的交换文件中。\n");
+        }
+        // 上次编辑异常退出时遗留了交换文件，询问是否恢复
+        if (editor.hasRecoverableJournal()) {
+            printUTF8("发现 " + editor.getCurrentFile() + " 的交换文件，上次编辑可能异常退出。\n");
+            if (!editor.journalMatchesFile()) {
+                printUTF8("注意：文件在交换文件创建后已被修改，恢复结果可能不正确。\n");
+            }
+            printUTF8("恢复未保存的修改吗？[y]恢复 [n]放弃 [其他]暂不处理（稍后可用 :recover 或 :discard）: ");
+            std::string answer;
+            std::getline(std::cin, answer);
+            if (!answer.empty() && (answer[0] == 'y' || answer[0] == 'Y')) {
+                std::string message;
+                editor.recoverJournal(message);
+                printUTF8(message + "\n");
+            } else if (!answer.empty() && (answer[0] == 'n' || answer[0] == 'N')) {
+                editor.discardJournal();
+            }
+        }
         
-        NCursesUI ui(editor);
+#ifdef VIMINTS_NCURSES
+        // 环境变量 VIMINTS_UI=ansi 时不使用 ncurses
+        const char* backend = std::getenv("VIMINTS_UI");
+        if (backend == NULL || std::string(backend) != "ansi") {
+            NCursesUI ui(editor);
+            ui.run();
+            return 0;
+        }
+#endif
+        // 没有 ncurses 时直接输出 ANSI 控制序列
+        UI ui(editor);
         ui.run();
     }
     catch (const std::exception& e) {
@@ -0,0 +1,194 @@
+/**
+ * @file mapped_file.cpp
+ * @brief 只读内存映射文件实现
+ *
+ * 受防护的映射登记在一张固定大小的表中，SIGBUS 处理函数只读这张表（原子变量），
+ * 不分配内存也不加锁。
+ */
+#include "../include/mapped_file.h"
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const size_t MappedTextBlock::kMinMappedSize;
+
+#ifndef _WIN32
+static const size_t kMaxGuarded = 16;
+
+struct GuardedRange {
+    std::atomic<uintptr_t> begin;
+    std::atomic<uintptr_t> end;
+    std::atomic<bool> faulted;
+};
+
+static GuardedRange s_guarded[kMaxGuarded];
+static uintptr_t s_pageSize = 4096;
+static struct sigaction s_previousBus;
+static std::once_flag s_installOnce;
+
+static void handleBus(int signal, siginfo_t* info, void* context) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(info->si_addr);
+    for (size_t i = 0; i < kMaxGuarded; ++i) {
+        uintptr_t begin = s_guarded[i].begin.load();
+        if (begin == 0 || address < begin || address >= s_guarded[i].end.load()) {
+            continue;
+        }
+        // 文件被截断，这一页已没有对应的内容：换成全零的匿名页后重新执行出错的指令。
+        // 可写是为了 makePrivate() 逐页写入时同样能继续
+        void* page = reinterpret_cast<void*>(address & ~(s_pageSize - 1));
+        if (mmap(page, s_pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) !=
+            MAP_FAILED) {
+            s_guarded[i].faulted.store(true);
+            return;
+        }
+        break;
+    }
+    // 与映射的文件无关：交给之前的处理函数，没有时恢复默认处理，重新执行后进程终止
+    if (s_previousBus.sa_flags & SA_SIGINFO) {
+        s_previousBus.sa_sigaction(signal, info, context);
+    } else if (s_previousBus.sa_handler != SIG_DFL && s_previousBus.sa_handler != SIG_IGN) {
+        s_previousBus.sa_handler(signal);
+    } else {
+        struct sigaction action;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = 0;
+        action.sa_handler = SIG_DFL;
+        sigaction(SIGBUS, &action, NULL);
+    }
+}
+
+static void installBusHandler() {
+    s_pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    struct sigaction action;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    action.sa_sigaction = handleBus;
+    sigaction(SIGBUS, &action, &s_previousBus);
+}
+
+// 返回登记的位置；表已满时返回 kMaxGuarded
+static size_t guardRange(void* address, size_t length) {
+    std::call_once(s_installOnce, installBusHandler);
+    uintptr_t begin = reinterpret_cast<uintptr_t>(address);
+    for (size_t i = 0; i < kMaxGuarded; ++i) {
+        uintptr_t expected = 0;
+        if (s_guarded[i].begin.compare_exchange_strong(expected, begin)) {
+            s_guarded[i].faulted.store(false);
+            s_guarded[i].end.store(begin + length);
+            return i;
+        }
+    }
+    return kMaxGuarded;
+}
+
+static void unguardRange(size_t slot) {
+    s_guarded[slot].end.store(0);
+    s_guarded[slot].begin.store(0);
+}
+#endif
+
+MappedTextBlock::MappedTextBlock(void* address, size_t length, int fd, int64_t modifiedTime, size_t slot) :
+    m_address(address),
+    m_length(length),
+    m_fd(fd),
+    m_modifiedTime(modifiedTime),
+    m_slot(slot),
+    m_private(false) {
+    m_data = static_cast<const char*>(address);
+    m_size = length;
+    m_capacity = length;
+}
+
+MappedTextBlock::~MappedTextBlock() {
+    #ifndef _WIN32
+    unguardRange(m_slot);
+    munmap(m_address, m_length);
+    close(m_fd);
+    #endif
+}
+
+std::shared_ptr<MappedTextBlock> MappedTextBlock::open(const std::string& filename) {
+    #ifdef _WIN32
+    (void)filename;
+    return std::shared_ptr<MappedTextBlock>();
+    #else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return std::shared_ptr<MappedTextBlock>();
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+        static_cast<uint64_t>(info.st_size) < kMinMappedSize) {
+        close(fd);
+        return std::shared_ptr<MappedTextBlock>();
+    }
+    size_t length = static_cast<size_t>(info.st_size);
+    void* address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+        close(fd);
+        return std::shared_ptr<MappedTextBlock>();
+    }
+    size_t slot = guardRange(address, length);
+    if (slot == kMaxGuarded) {
+        munmap(address, length);
+        close(fd);
+        return std::shared_ptr<MappedTextBlock>();
+    }
+    // 文件描述符保留到映射解除，用来检查文件是否被修改
+    return std::shared_ptr<MappedTextBlock>(
+        new MappedTextBlock(address, length, fd, static_cast<int64_t>(info.st_mtime), slot));
+    #endif
+}
+
+bool MappedTextBlock::changedOnDisk() const {
+    #ifdef _WIN32
+    return false;
+    #else
+    if (m_private) {
+        return false;
+    }
+    if (s_guarded[m_slot].faulted.load()) {
+        return true;
+    }
+    struct stat info;
+    return fstat(m_fd, &info) != 0 || static_cast<size_t>(info.st_size) != m_length ||
+           static_cast<int64_t>(info.st_mtime) != m_modifiedTime;
+    #endif
+}
+
+// 私有映射的页面在第一次写入时复制：逐页写回原值，每一页就都成为进程私有的副本，
+// 地址不变，引用这些字节的片段不受影响
+void MappedTextBlock::makePrivate() {
+    std::lock_guard<std::mutex> lock(m_privateMutex);
+    #ifndef _WIN32
+    if (m_private || mprotect(m_address, m_length, PROT_READ | PROT_WRITE) != 0) {
+        return;
+    }
+    volatile char* bytes = static_cast<volatile char*>(m_address);
+    for (size_t offset = 0; offset < m_length; offset += s_pageSize) {
+        bytes[offset] = bytes[offset];
+    }
+    mprotect(m_address, m_length, PROT_READ);
+    #endif
+    m_private = true;
+}
+
+bool MappedTextBlock::isPrivate() const {
+    return m_private;
+}
+
+bool MappedTextBlock::refersTo(int fd) const {
+    #ifdef _WIN32
+    (void)fd;
+    return false;
+    #else
+    struct stat mapped;
+    struct stat other;
+    return fstat(m_fd, &mapped) == 0 && fstat(fd, &other) == 0 &&
+           mapped.st_dev == other.st_dev && mapped.st_ino == other.st_ino;
+    #endif
+}
@@ -0,0 +1,276 @@
+/**
+ * @file match_index.cpp
+ * @brief 全文匹配索引实现
+ */
+#include "../include/match_index.h"
+#include "../include/thread_pool.h"
+#include <algorithm>
+
+// 按（行, 列）比较
+static bool matchBefore(const MatchIndex::Match& match, const std::pair<size_t, size_t>& position) {
+    return match.line < position.first ||
+           (match.line == position.first && match.column < position.second);
+}
+
+static bool lineBefore(const MatchIndex::Match& match, size_t line) {
+    return match.line < line;
+}
+
+MatchIndex::MatchIndex() : m_active(false), m_rebuild(false), m_coveredLines(0) {}
+
+void MatchIndex::build(const PieceTable& buffer, const Regex& regex, ThreadPool& pool) {
+    m_regex = regex;
+    m_active = true;
+    m_rebuild = false;
+    m_staleLines.clear();
+    m_matches.clear();
+    m_coveredLines = completeLines(buffer);
+    scanRange(buffer, 0, m_coveredLines, pool);
+}
+
+size_t MatchIndex::completeLines(const PieceTable& buffer) {
+    return buffer.isFullyIndexed() ? buffer.lineCount() : buffer.lineCount() - 1;
+}
+
+void MatchIndex::scanRange(const PieceTable& buffer, size_t firstLine, size_t lastLine, ThreadPool& pool) {
+    if (firstLine >= lastLine) {
+        return;
+    }
+    // 按字节数均分，每个线程分到几段，匹配多的段不至于拖住整体
+    size_t begin = buffer.lineStart(firstLine);
+    size_t length = (lastLine < buffer.lineCount() ? buffer.lineStart(lastLine) : buffer.length()) - begin;
+    size_t parts = std::max<size_t>(1, std::min(lastLine - firstLine, (pool.size() + 1) * 4));
+    std::vector<std::pair<size_t, size_t> > ranges;
+    size_t first = firstLine;
+    for (size_t k = 1; k <= parts && first < lastLine; ++k) {
+        size_t last = k == parts ? lastLine
+                                 : std::min(lastLine, buffer.lineOfOffset(begin + length / parts * k) + 1);
+        if (last > first) {
+            ranges.push_back(std::make_pair(first, last));
+            first = last;
+        }
+    }
+    scanParallel(buffer, ranges, pool, m_matches);
+}
+
+void MatchIndex::clear() {
+    m_regex = Regex();
+    m_active = false;
+    m_rebuild = false;
+    m_matches.clear();
+    m_staleLines.clear();
+    m_coveredLines = 0;
+}
+
+bool MatchIndex::isActive() const {
+    return m_active;
+}
+
+const Regex& MatchIndex::regex() const {
+    return m_regex;
+}
+
+void MatchIndex::applyEdit(size_t line, size_t removedLines, size_t insertedLines) {
+    if (!m_active) {
+        return;
+    }
+    if (m_regex.matchesLineFeed()) {
+        m_rebuild = true;
+        return;
+    }
+    if (line + removedLines >= m_coveredLines) {
+        // 编辑涉及尚未查找的行：从 line 行起留给 extend 重新查找
+        m_coveredLines = std::min(m_coveredLines, line);
+        m_matches.erase(std::lower_bound(m_matches.begin(), m_matches.end(), m_coveredLines, lineBefore),
+                        m_matches.end());
+    } else if (removedLines != insertedLines) {
+        m_coveredLines = m_coveredLines + insertedLines - removedLines;
+    }
+    if (removedLines != insertedLines) {
+        // 被删除的行上的匹配去掉，其后各行的行号随之移动
+        std::vector<Match>::iterator begin =
+            std::lower_bound(m_matches.begin(), m_matches.end(), line + 1, lineBefore);
+        std::vector<Match>::iterator end =
+            std::lower_bound(begin, m_matches.end(), line + removedLines + 1, lineBefore);
+        begin = m_matches.erase(begin, end);
+        for (std::vector<Match>::iterator it = begin; it != m_matches.end(); ++it) {
+            it->line = it->line + insertedLines - removedLines;
+        }
+        for (size_t i = 0; i < m_staleLines.size(); ++i) {
+            if (m_staleLines[i] > line + removedLines) {
+                m_staleLines[i] = m_staleLines[i] + insertedLines - removedLines;
+            } else if (m_staleLines[i] > line) {
+                m_staleLines[i] = line;
+            }
+        }
+    }
+    for (size_t i = 0; i <= insertedLines; ++i) {
+        m_staleLines.push_back(line + i);
+    }
+}
+
+void MatchIndex::invalidateLine(size_t line) {
+    if (!m_active) {
+        return;
+    }
+    if (m_regex.matchesLineFeed()) {
+        m_rebuild = true;
+        return;
+    }
+    m_staleLines.push_back(line);
+}
+
+void MatchIndex::refresh(const PieceTable& buffer, ThreadPool& pool) {
+    if (!m_active) {
+        return;
+    }
+    if (m_rebuild) {
+        build(buffer, m_regex, pool);
+        return;
+    }
+    if (m_staleLines.empty()) {
+        return;
+    }
+    // 待更新的行合并成连续的区间；尚未查找过的行留给 extend
+    std::sort(m_staleLines.begin(), m_staleLines.end());
+    std::vector<std::pair<size_t, size_t> > ranges;
+    for (size_t i = 0; i < m_staleLines.size(); ++i) {
+        size_t line = m_staleLines[i];
+        if (line >= m_coveredLines) {
+            break;
+        }
+        if (!ranges.empty() && ranges.back().second >= line) {
+            ranges.back().second = line + 1;
+        } else {
+            ranges.push_back(std::make_pair(line, line + 1));
+        }
+    }
+    size_t staleCount = m_staleLines.size();
+    m_staleLines.clear();
+
+    std::vector<Match> found;
+    if (staleCount > kParallelThreshold) {
+        scanParallel(buffer, ranges, pool, found);
+    } else {
+        RegexMatcher matcher(m_regex);
+        for (size_t r = 0; r < ranges.size(); ++r) {
+            scanLines(buffer, matcher, ranges[r].first, ranges[r].second, found);
+        }
+    }
+
+    // 一次遍历合并：区间外的旧匹配保留，区间内的换成新找到的
+    std::vector<Match> merged;
+    merged.reserve(m_matches.size() + found.size());
+    std::vector<Match>::iterator old = m_matches.begin();
+    std::vector<Match>::const_iterator fresh = found.begin();
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        while (old != m_matches.end() && old->line < ranges[r].first) {
+            merged.push_back(*old++);
+        }
+        while (old != m_matches.end() && old->line < ranges[r].second) {
+            ++old;
+        }
+        while (fresh != found.end() && fresh->line < ranges[r].second) {
+            merged.push_back(*fresh++);
+        }
+    }
+    merged.insert(merged.end(), old, m_matches.end());
+    m_matches.swap(merged);
+}
+
+void MatchIndex::extend(const PieceTable& buffer, ThreadPool& pool, size_t maxBytes) {
+    size_t complete = completeLines(buffer);
+    if (!m_active || m_rebuild || m_coveredLines >= complete) {
+        return;
+    }
+    size_t last = std::min(complete, buffer.lineOfOffset(buffer.lineStart(m_coveredLines) + maxBytes) + 1);
+    scanRange(buffer, m_coveredLines, last, pool);
+    m_coveredLines = last;
+}
+
+size_t MatchIndex::coveredLines() const {
+    return m_coveredLines;
+}
+
+bool MatchIndex::isBehind(const PieceTable& buffer) const {
+    return m_active && !m_rebuild && m_coveredLines < completeLines(buffer);
+}
+
+size_t MatchIndex::count() const {
+    return m_matches.size();
+}
+
+size_t MatchIndex::ordinalAt(size_t line, size_t column) const {
+    std::pair<size_t, size_t> position(line, column + 1);
+    return static_cast<size_t>(std::lower_bound(m_matches.begin(), m_matches.end(), position, matchBefore) -
+                               m_matches.begin());
+}
+
+std::pair<size_t, size_t> MatchIndex::lineRange(size_t line) const {
+    std::vector<Match>::const_iterator first =
+        std::lower_bound(m_matches.begin(), m_matches.end(), line, lineBefore);
+    std::vector<Match>::const_iterator last =
+        std::lower_bound(first, m_matches.end(), line + 1, lineBefore);
+    return std::make_pair(static_cast<size_t>(first - m_matches.begin()),
+                          static_cast<size_t>(last - m_matches.begin()));
+}
+
+const MatchIndex::Match& MatchIndex::at(size_t index) const {
+    return m_matches[index];
+}
+
+void MatchIndex::scanLines(const PieceTable& buffer, RegexMatcher& matcher, size_t firstLine,
+                           size_t lastLine, std::vector<Match>& out) const {
+    size_t length = buffer.length();
+    size_t lineCount = buffer.lineCount();
+    size_t from = buffer.lineStart(firstLine);
+    // 只收集起点在这几行中的匹配；不跨行的模式也只需查到最后一行的行尾
+    size_t limit = lastLine < lineCount ? buffer.lineStart(lastLine) : length + 1;
+    size_t to = m_regex.matchesLineFeed() ? length : std::min(limit, length);
+
+    size_t line = firstLine;
+    size_t lineStart = from;
+    size_t nextLineStart = firstLine + 1 < lineCount ? buffer.lineStart(firstLine + 1) : length + 1;
+    PieceTableInput input(buffer);
+    RegexMatch match;
+    size_t pos = from;
+    while (pos <= to) {
+        if (m_regex.isLiteral()) {
+            size_t hit = buffer.find(m_regex.literal(), pos, to);
+            if (hit == PieceTable::npos) {
+                break;
+            }
+            match.start = hit;
+            match.end = hit + m_regex.literal().size();
+        } else if (!matcher.search(input, pos, to, match)) {
+            break;
+        }
+        if (match.start >= limit) {
+            break;
+        }
+        if (match.start >= nextLineStart) {
+            line = buffer.lineOfOffset(match.start);
+            lineStart = buffer.lineStart(line);
+            nextLineStart = line + 1 < lineCount ? buffer.lineStart(line + 1) : length + 1;
+        }
+        Match entry = { line, match.start - lineStart, match.length() };
+        out.push_back(entry);
+        pos = match.end > match.start ? match.end : match.end + 1;
+    }
+}
+
+void MatchIndex::scanParallel(const PieceTable& buffer,
+                              const std::vector<std::pair<size_t, size_t> >& ranges, ThreadPool& pool,
+                              std::vector<Match>& out) const {
+    // 每段的结果单独存放，最后按顺序拼接即为有序
+    std::vector<std::vector<Match> > results(ranges.size());
+    pool.parallelFor(ranges.size(), [&](size_t begin, size_t end) {
+        RegexMatcher matcher(m_regex);
+        for (size_t r = begin; r < end; ++r) {
+            scanLines(buffer, matcher, ranges[r].first, ranges[r].second, results[r]);
+        }
+    });
+    for (size_t r = 0; r < results.size(); ++r) {
+        out.insert(out.end(), results[r].begin(), results[r].end());
+    }
+}
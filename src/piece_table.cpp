@@ -0,0 +1,690 @@
+/**
+ * @file piece_table.cpp
+ * @brief 片段表文本缓冲区实现
+ *
+ * 大纲：
+ * 1. 文本块实现
+ * 2. treap 基本操作：合并、拆分、建树
+ * 3. 插入和删除
+ * 4. 行号与偏移的换算
+ * 5. 片段迭代和查找
+ */
+#include "../include/piece_table.h"
+#include "../include/line_scanner.h"
+#include "../include/thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+// 文本块
+TextBlock::TextBlock(size_t capacity) :
+    m_data(NULL),
+    m_size(0),
+    m_capacity(capacity),
+    m_bytes(new char[capacity]) {
+    m_data = m_bytes.get();
+}
+
+TextBlock::TextBlock(const char* text, size_t length) :
+    m_data(NULL),
+    m_size(length),
+    m_capacity(length),
+    m_bytes(new char[length > 0 ? length : 1]) {
+    if (length > 0) {
+        std::memcpy(m_bytes.get(), text, length);
+    }
+    m_data = m_bytes.get();
+}
+
+TextBlock::TextBlock() :
+    m_data(NULL),
+    m_size(0),
+    m_capacity(0) {}
+
+const char* TextBlock::append(const char* text, size_t length) {
+    char* target = m_bytes.get() + m_size;
+    std::memcpy(target, text, length);
+    m_size += length;
+    return target;
+}
+
+const size_t PieceTable::npos;
+const size_t PieceTable::kAddBlockSize;
+const size_t PieceTable::kMaxPieceLength;
+const size_t PieceTable::kParallelIndexBytes;
+const size_t PieceTable::kSearchWindow;
+
+PieceTable::PieceTable() :
+    m_originalBytes(0),
+    m_pending(NULL),
+    m_pendingLength(0),
+    m_pendingAfterCR(false),
+    m_seed(2463534242u) {
+    m_originalBreaks.lineFeeds = 0;
+    m_originalBreaks.crlf = 0;
+}
+
+// 生成节点优先级（xorshift）
+uint32_t PieceTable::nextPriority() {
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
+
+PieceTable::NodePtr PieceTable::makeNode(const Piece& piece, uint32_t priority,
+                                         const NodePtr& left, const NodePtr& right) {
+    std::shared_ptr<Node> node = std::make_shared<Node>();
+    node->piece = piece;
+    node->priority = priority;
+    node->left = left;
+    node->right = right;
+    node->length = lengthOf(left) + piece.length + lengthOf(right);
+    node->lineFeeds = lineFeedsOf(left) + piece.lineFeeds + lineFeedsOf(right);
+    node->pieces = piecesOf(left) + 1 + piecesOf(right);
+    return node;
+}
+
+size_t PieceTable::lengthOf(const NodePtr& node) {
+    return node ? node->length : 0;
+}
+
+size_t PieceTable::lineFeedsOf(const NodePtr& node) {
+    return node ? node->lineFeeds : 0;
+}
+
+size_t PieceTable::piecesOf(const NodePtr& node) {
+    return node ? node->pieces : 0;
+}
+
+PieceTable::NodePtr PieceTable::merge(const NodePtr& left, const NodePtr& right) {
+    if (!left) return right;
+    if (!right) return left;
+    if (left->priority > right->priority) {
+        return makeNode(left->piece, left->priority, left->left, merge(left->right, right));
+    }
+    return makeNode(right->piece, right->priority, merge(left, right->left), right->right);
+}
+
+// 按字节偏移拆分：left 包含 [0, offset)，right 包含其余部分
+void PieceTable::split(const NodePtr& node, size_t offset, NodePtr& left, NodePtr& right) {
+    if (!node) {
+        left.reset();
+        right.reset();
+        return;
+    }
+    size_t leftLength = lengthOf(node->left);
+    if (offset <= leftLength) {
+        NodePtr inner;
+        split(node->left, offset, left, inner);
+        right = makeNode(node->piece, node->priority, inner, node->right);
+    } else if (offset >= leftLength + node->piece.length) {
+        NodePtr inner;
+        split(node->right, offset - leftLength - node->piece.length, inner, right);
+        left = makeNode(node->piece, node->priority, node->left, inner);
+    } else {
+        // 拆分点落在片段内部，一分为二
+        size_t cut = offset - leftLength;
+        Piece head = makePiece(node->piece.data, cut);
+        Piece tail = { node->piece.data + cut, node->piece.length - cut,
+                       node->piece.lineFeeds - head.lineFeeds };
+        left = makeNode(head, node->priority, node->left, NodePtr());
+        right = makeNode(tail, node->priority, NodePtr(), node->right);
+    }
+}
+
+// 若最后一个片段恰好结束于 end，则原地延长它（连续输入时避免片段数量膨胀）
+bool PieceTable::extendLast(const NodePtr& node, const char* end, size_t length, NodePtr& result) {
+    if (!node) {
+        return false;
+    }
+    if (node->right) {
+        NodePtr right;
+        if (!extendLast(node->right, end, length, right)) {
+            return false;
+        }
+        result = makeNode(node->piece, node->priority, node->left, right);
+        return true;
+    }
+    if (node->piece.data + node->piece.length != end ||
+        node->piece.length + length > kMaxPieceLength) {
+        return false;
+    }
+    Piece piece = { node->piece.data, node->piece.length + length,
+                    node->piece.lineFeeds + ::countLineFeeds(end, length) };
+    result = makeNode(piece, node->priority, node->left, NodePtr());
+    return true;
+}
+
+// 由有序片段直接建立平衡树：按深度分层分配优先级，保证堆性质
+PieceTable::NodePtr PieceTable::buildTree(const std::vector<Piece>& pieces) {
+    struct Builder {
+        PieceTable& table;
+        const std::vector<Piece>& pieces;
+
+        NodePtr build(size_t begin, size_t end, uint32_t depth) {
+            if (begin >= end) {
+                return NodePtr();
+            }
+            size_t mid = begin + (end - begin) / 2;
+            const uint32_t band = 1u << 26;
+            uint32_t priority = 0xFFFFFFFFu - std::min<uint32_t>(depth, 63) * band -
+                                table.nextPriority() % band;
+            NodePtr left = build(begin, mid, depth + 1);
+            NodePtr right = build(mid + 1, end, depth + 1);
+            return makeNode(pieces[mid], priority, left, right);
+        }
+    };
+    Builder builder = { *this, pieces };
+    return builder.build(0, pieces.size(), 0);
+}
+
+PieceTable::Piece PieceTable::makePiece(const char* data, size_t length) {
+    Piece piece = { data, length, ::countLineFeeds(data, length) };
+    return piece;
+}
+
+void PieceTable::reset(const char* text, size_t length) {
+    if (length == 0) {
+        clear();
+        return;
+    }
+    adopt(std::make_shared<TextBlock>(text, length), length);
+    indexAll();
+}
+
+void PieceTable::adopt(const std::shared_ptr<TextBlock>& original, size_t length) {
+    clear();
+    if (length == 0) {
+        return;
+    }
+    m_blocks.push_back(original);
+    m_originalBytes = original->size();
+    m_pending = original->data();
+    m_pendingLength = length;
+}
+
+PieceTable::LineBreakSummary PieceTable::originalLineBreaks() const {
+    return m_originalBreaks;
+}
+
+void PieceTable::clear() {
+    m_blocks.clear();
+    m_originalBytes = 0;
+    m_addBlock.reset();
+    m_root.reset();
+    m_pending = NULL;
+    m_pendingLength = 0;
+    m_originalBreaks.lineFeeds = 0;
+    m_originalBreaks.crlf = 0;
+    m_pendingAfterCR = false;
+}
+
+// 为待处理区域的开头一段建立索引，并接到树的末尾
+size_t PieceTable::indexMore(size_t maxBytes) {
+    size_t length = std::min(maxBytes, m_pendingLength);
+    if (length == 0) {
+        return 0;
+    }
+    // 原始内容切成有上限的片段，使片段内的线性扫描保持有界。
+    // 各片段的换行符统计互不依赖，数据量大时分给线程池并行扫描
+    size_t count = (length + kMaxPieceLength - 1) / kMaxPieceLength;
+    std::vector<Piece> pieces(count);
+    std::vector<size_t> crlf(count);
+    const char* base = m_pending;
+    std::function<void(size_t, size_t)> scan = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t offset = i * kMaxPieceLength;
+            LineBreakCounts breaks = countLineBreaks(base + offset, std::min(kMaxPieceLength, length - offset));
+            Piece piece = { base + offset, std::min(kMaxPieceLength, length - offset), breaks.lineFeeds };
+            pieces[i] = piece;
+            crlf[i] = breaks.crlf;
+        }
+    };
+    if (length >= kParallelIndexBytes) {
+        ThreadPool::shared().parallelFor(count, scan);
+    } else {
+        scan(0, count);
+    }
+    appendPieces(pieces, crlf);
+    return length;
+}
+
+void PieceTable::scanOriginal(const char* data, size_t length, std::vector<Piece>& pieces,
+                              std::vector<size_t>& crlf) {
+    for (size_t offset = 0; offset < length; offset += kMaxPieceLength) {
+        size_t pieceLength = std::min(kMaxPieceLength, length - offset);
+        LineBreakCounts breaks = countLineBreaks(data + offset, pieceLength);
+        Piece piece = { data + offset, pieceLength, breaks.lineFeeds };
+        pieces.push_back(piece);
+        crlf.push_back(breaks.crlf);
+    }
+}
+
+size_t PieceTable::appendScanned(const std::vector<Piece>& pieces, const std::vector<size_t>& crlf) {
+    std::vector<Piece> accepted;
+    std::vector<size_t> acceptedCRLF;
+    const char* next = m_pending;
+    size_t remaining = m_pendingLength;
+    for (size_t i = 0; i < pieces.size() && remaining > 0; ++i) {
+        Piece piece = pieces[i];
+        size_t breaks = crlf[i];
+        // 待处理区域的开头落在片段中间：同步索引已经覆盖了片段前半，后半重新统计
+        if (piece.data < next && next < piece.data + piece.length) {
+            LineBreakCounts counts = countLineBreaks(next, static_cast<size_t>(piece.data + piece.length - next));
+            Piece tail = { next, static_cast<size_t>(piece.data + piece.length - next), counts.lineFeeds };
+            piece = tail;
+            breaks = counts.crlf;
+        }
+        if (piece.data != next) {
+            // 已被索引过的片段跳过
+            if (accepted.empty() && piece.data + piece.length <= m_pending) {
+                continue;
+            }
+            break;
+        }
+        if (piece.length > remaining) {
+            break;
+        }
+        accepted.push_back(piece);
+        acceptedCRLF.push_back(breaks);
+        next += piece.length;
+        remaining -= piece.length;
+    }
+    if (accepted.empty()) {
+        return 0;
+    }
+    size_t length = static_cast<size_t>(next - m_pending);
+    appendPieces(accepted, acceptedCRLF);
+    return length;
+}
+
+void PieceTable::appendPieces(const std::vector<Piece>& pieces, const std::vector<size_t>& crlf) {
+    // 拼接各片段的结果，补上跨片段边界的 \r\n
+    size_t length = 0;
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        bool afterCR = i > 0 ? pieces[i - 1].data[pieces[i - 1].length - 1] == '\r' : m_pendingAfterCR;
+        m_originalBreaks.lineFeeds += pieces[i].lineFeeds;
+        m_originalBreaks.crlf += crlf[i] + (afterCR && pieces[i].data[0] == '\n' ? 1 : 0);
+        length += pieces[i].length;
+    }
+    m_pendingAfterCR = m_pending[length - 1] == '\r';
+    m_root = merge(m_root, buildTree(pieces));
+    m_pending += length;
+    m_pendingLength -= length;
+}
+
+void PieceTable::indexAll() {
+    indexMore(m_pendingLength);
+}
+
+bool PieceTable::isFullyIndexed() const {
+    return m_pendingLength == 0;
+}
+
+size_t PieceTable::indexedLength() const {
+    return lengthOf(m_root);
+}
+
+const char* PieceTable::pendingData() const {
+    return m_pending;
+}
+
+size_t PieceTable::pendingLength() const {
+    return m_pendingLength;
+}
+
+// 编辑位置落在待处理区域时，先把索引推进到该位置
+void PieceTable::ensureIndexed(size_t offset) {
+    size_t indexed = indexedLength();
+    if (offset > indexed) {
+        indexMore(offset - indexed);
+    }
+}
+
+// 写入追加缓冲区；调用方保证 length 不超过 kAddBlockSize
+PieceTable::Piece PieceTable::appendToAddBuffer(const char* text, size_t length) {
+    if (!m_addBlock || m_addBlock->available() < length) {
+        m_addBlock = std::make_shared<TextBlock>(kAddBlockSize);
+        m_blocks.push_back(m_addBlock);
+    }
+    return makePiece(m_addBlock->append(text, length), length);
+}
+
+void PieceTable::insert(size_t offset, const char* text, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    offset = std::min(offset, this->length());
+    ensureIndexed(offset);
+
+    NodePtr left, right;
+    split(m_root, offset, left, right);
+    appendText(left, text, length);
+    m_root = merge(left, right);
+}
+
+// 把文本写入追加缓冲区并接到 left 末尾；与 left 最后一个片段相邻时直接延长它
+void PieceTable::appendText(NodePtr& left, const char* text, size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        size_t chunk = std::min(length - done, kMaxPieceLength);
+        const char* end = m_addBlock ? m_addBlock->data() + m_addBlock->size() : NULL;
+        bool fits = m_addBlock && m_addBlock->available() >= chunk;
+        Piece piece = appendToAddBuffer(text + done, chunk);
+
+        NodePtr extended;
+        if (fits && piece.data == end && extendLast(left, end, chunk, extended)) {
+            left = extended;
+        } else {
+            left = merge(left, makeNode(piece, nextPriority(), NodePtr(), NodePtr()));
+        }
+        done += chunk;
+    }
+}
+
+PieceTable::MemoryStats PieceTable::memoryStats() const {
+    MemoryStats stats;
+    stats.textBytes = length();
+    stats.originalBytes = m_originalBytes;
+    stats.addBytesUsed = 0;
+    stats.addBytesAllocated = 0;
+    for (size_t i = 0; i < m_blocks.size(); ++i) {
+        if (i == 0 && m_originalBytes > 0) {
+            continue;
+        }
+        stats.addBytesUsed += m_blocks[i]->size();
+        stats.addBytesAllocated += m_blocks[i]->size() + m_blocks[i]->available();
+    }
+    // 每个节点另有 shared_ptr 控制块和分配器开销，按 32 字节估算
+    stats.pieces = pieceCount();
+    stats.pieceBytes = stats.pieces * (sizeof(Node) + 32);
+    return stats;
+}
+
+void PieceTable::insert(size_t offset, const std::string& text) {
+    insert(offset, text.data(), text.size());
+}
+
+void PieceTable::erase(size_t offset, size_t length) {
+    size_t total = this->length();
+    if (offset >= total || length == 0) {
+        return;
+    }
+    length = std::min(length, total - offset);
+    ensureIndexed(offset + length);
+
+    NodePtr left, middle, right;
+    split(m_root, offset, left, middle);
+    NodePtr removed;
+    split(middle, length, removed, right);
+    m_root = merge(left, right);
+}
+
+size_t PieceTable::length() const {
+    return lengthOf(m_root) + m_pendingLength;
+}
+
+size_t PieceTable::lineCount() const {
+    return lineFeedsOf(m_root) + 1;
+}
+
+size_t PieceTable::pieceCount() const {
+    return piecesOf(m_root);
+}
+
+size_t PieceTable::lineStart(size_t line) const {
+    if (line == 0) {
+        return 0;
+    }
+    // 查找第 line 个换行符，行首紧随其后
+    size_t remaining = line;
+    size_t offset = 0;
+    const Node* node = m_root.get();
+    while (node) {
+        size_t leftFeeds = lineFeedsOf(node->left);
+        if (remaining <= leftFeeds) {
+            node = node->left.get();
+        } else if (remaining <= leftFeeds + node->piece.lineFeeds) {
+            size_t pos = findNthLineFeed(node->piece.data, node->piece.length, remaining - leftFeeds);
+            return offset + lengthOf(node->left) + pos + 1;
+        } else {
+            remaining -= leftFeeds + node->piece.lineFeeds;
+            offset += lengthOf(node->left) + node->piece.length;
+            node = node->right.get();
+        }
+    }
+    return indexedLength();
+}
+
+size_t PieceTable::lineLength(size_t line) const {
+    size_t start = lineStart(line);
+    if (line + 1 >= lineCount()) {
+        return indexedLength() - start;
+    }
+    return lineStart(line + 1) - 1 - start;
+}
+
+size_t PieceTable::lineOfOffset(size_t offset) const {
+    size_t line = 0;
+    const Node* node = m_root.get();
+    while (node) {
+        size_t leftLength = lengthOf(node->left);
+        if (offset < leftLength) {
+            node = node->left.get();
+        } else if (offset < leftLength + node->piece.length) {
+            return line + lineFeedsOf(node->left) +
+                   ::countLineFeeds(node->piece.data, offset - leftLength);
+        } else {
+            line += lineFeedsOf(node->left) + node->piece.lineFeeds;
+            offset -= leftLength + node->piece.length;
+            node = node->right.get();
+        }
+    }
+    return line;
+}
+
+PieceTable::Position PieceTable::positionOf(size_t offset) const {
+    offset = std::min(offset, indexedLength());
+    Position position;
+    position.line = lineOfOffset(offset);
+    position.column = offset - lineStart(position.line);
+    return position;
+}
+
+size_t PieceTable::offsetOf(size_t line, size_t column) const {
+    if (line >= lineCount()) {
+        return indexedLength();
+    }
+    return lineStart(line) + std::min(column, lineLength(line));
+}
+
+PieceTable::SpanIterator PieceTable::spans(size_t offset, size_t length) const {
+    size_t total = this->length();
+    offset = std::min(offset, total);
+    length = std::min(length, total - offset);
+    return SpanIterator(m_root.get(), offset, length, m_pending, m_pendingLength);
+}
+
+std::string PieceTable::substr(size_t offset, size_t length) const {
+    std::string result;
+    SpanIterator it = spans(offset, length);
+    const char* data;
+    size_t spanLength;
+    while (it.next(data, spanLength)) {
+        result.append(data, spanLength);
+    }
+    return result;
+}
+
+std::string PieceTable::getLine(size_t line) const {
+    return substr(lineStart(line), lineLength(line));
+}
+
+char PieceTable::at(size_t offset) const {
+    SpanIterator it = spans(offset, 1);
+    const char* data;
+    size_t spanLength;
+    if (it.next(data, spanLength)) {
+        return *data;
+    }
+    return '\0';
+}
+
+void PieceTable::chunkAt(size_t offset, const char*& data, size_t& length, size_t& start) const {
+    size_t treeLength = lengthOf(m_root);
+    if (offset >= treeLength) {
+        data = m_pending;
+        length = offset < treeLength + m_pendingLength ? m_pendingLength : 0;
+        start = treeLength;
+        return;
+    }
+    start = 0;
+    const Node* node = m_root.get();
+    while (node) {
+        size_t leftLength = lengthOf(node->left);
+        if (offset < leftLength) {
+            node = node->left.get();
+        } else if (offset < leftLength + node->piece.length) {
+            data = node->piece.data;
+            length = node->piece.length;
+            start += leftLength;
+            return;
+        } else {
+            offset -= leftLength + node->piece.length;
+            start += leftLength + node->piece.length;
+            node = node->right.get();
+        }
+    }
+}
+
+// 在连续内存中查找 pattern，返回指向匹配的指针或 NULL
+static const char* findInBlock(const char* data, size_t length, const std::string& pattern) {
+    size_t found = findPattern(data, length, pattern.data(), pattern.size());
+    return found < length ? data + found : NULL;
+}
+
+size_t PieceTable::find(const std::string& pattern, size_t from, size_t to) const {
+    to = std::min(to, length());
+    if (pattern.empty() || from >= to || to - from < pattern.size()) {
+        return npos;
+    }
+    // carry 保存前面片段的末尾字节，用于发现跨越片段边界的匹配
+    std::string carry;
+    size_t keep = pattern.size() - 1;
+    size_t offset = from;
+    SpanIterator it = spans(from, to - from);
+    const char* data;
+    size_t spanLength;
+    while (it.next(data, spanLength)) {
+        if (!carry.empty()) {
+            std::string joint = carry;
+            joint.append(data, std::min(keep, spanLength));
+            const char* hit = findInBlock(joint.data(), joint.size(), pattern);
+            if (hit && static_cast<size_t>(hit - joint.data()) < carry.size()) {
+                return offset - carry.size() + static_cast<size_t>(hit - joint.data());
+            }
+        }
+        const char* hit = findInBlock(data, spanLength, pattern);
+        if (hit) {
+            return offset + static_cast<size_t>(hit - data);
+        }
+        if (keep > 0) {
+            if (spanLength >= keep) {
+                carry.assign(data + spanLength - keep, keep);
+            } else {
+                carry.append(data, spanLength);
+                if (carry.size() > keep) {
+                    carry.erase(0, carry.size() - keep);
+                }
+            }
+        }
+        offset += spanLength;
+    }
+    return npos;
+}
+
+// 从末尾开始逐个窗口正向扫描，取窗口内最后一个匹配；
+// 相邻窗口重叠 pattern 长度减一个字节，跨越窗口边界的匹配不会遗漏
+size_t PieceTable::rfind(const std::string& pattern, size_t from, size_t to) const {
+    to = std::min(to, length());
+    if (pattern.empty() || from >= to || to - from < pattern.size()) {
+        return npos;
+    }
+    size_t window = std::max(kSearchWindow, pattern.size() * 2);
+    size_t end = to;
+    while (true) {
+        size_t begin = end - from > window ? end - window : from;
+        size_t last = npos;
+        for (size_t hit = find(pattern, begin, end); hit != npos; hit = find(pattern, hit + 1, end)) {
+            last = hit;
+        }
+        if (last != npos || begin == from) {
+            return last;
+        }
+        end = begin + pattern.size() - 1;
+    }
+}
+
+// 片段迭代器
+PieceTable::SpanIterator::SpanIterator(const Node* root, size_t offset, size_t length,
+                                       const char* tail, size_t tailLength) :
+    m_skip(0),
+    m_remaining(length),
+    m_tail(tail),
+    m_tailLength(tailLength) {
+    // 范围从待处理区域开始时，不必遍历树
+    size_t treeLength = root ? root->length : 0;
+    if (offset >= treeLength) {
+        m_tail += offset - treeLength;
+        m_tailLength -= offset - treeLength;
+        return;
+    }
+    const Node* node = root;
+    while (node && length > 0) {
+        size_t leftLength = lengthOf(node->left);
+        if (offset < leftLength) {
+            m_stack.push_back(node);
+            node = node->left.get();
+        } else if (offset < leftLength + node->piece.length) {
+            m_stack.push_back(node);
+            m_skip = offset - leftLength;
+            break;
+        } else {
+            offset -= leftLength + node->piece.length;
+            node = node->right.get();
+        }
+    }
+}
+
+void PieceTable::SpanIterator::pushLeftPath(const Node* node) {
+    while (node) {
+        m_stack.push_back(node);
+        node = node->left.get();
+    }
+}
+
+bool PieceTable::SpanIterator::next(const char*& data, size_t& length) {
+    if (m_remaining == 0) {
+        return false;
+    }
+    if (m_stack.empty()) {
+        // 树中的片段已遍历完，最后是待处理区域
+        if (m_tailLength == 0) {
+            return false;
+        }
+        data = m_tail;
+        length = std::min(m_tailLength, m_remaining);
+        m_tailLength = 0;
+        m_remaining -= length;
+        return true;
+    }
+    const Node* node = m_stack.back();
+    m_stack.pop_back();
+    data = node->piece.data + m_skip;
+    length = std::min(node->piece.length - m_skip, m_remaining);
+    m_skip = 0;
+    m_remaining -= length;
+    pushLeftPath(node->right.get());
+    return true;
+}
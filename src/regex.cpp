@@ -0,0 +1,1396 @@
+/**
+ * @file regex.cpp
+ * @brief 正则表达式的解析、编译和匹配
+ *
+ * 大纲：
+ * 1. 解析：模式串 -> 语法树
+ * 2. 编译：语法树 -> NFA 程序（正向程序，以及用于找回起点的反向程序）
+ * 3. 惰性 DFA：状态按需构造，状态转移缓存在表中
+ * 4. NFA 模拟（Pike VM）：提取分组；DFA 缓存失效过于频繁时代替 DFA
+ * 5. 匹配器：组合以上部分完成查找
+ */
+#include "../include/regex.h"
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <cstring>
+#include <unordered_map>
+
+const size_t RegexMatch::npos;
+const size_t RegexMatcher::kSearchWindow;
+
+typedef std::bitset<256> ByteSet;
+
+// ---------------------------------------------------------------- 语法树
+
+struct RegexNode {
+    enum Kind { EMPTY, BYTES, CONCAT, ALTERNATE, REPEAT, CAPTURE, LINE_BEGIN, LINE_END };
+
+    Kind kind;
+    ByteSet bytes;                                      // BYTES
+    std::vector<std::unique_ptr<RegexNode> > children;  // CONCAT、ALTERNATE；REPEAT、CAPTURE 只有一个
+    int min;                                            // REPEAT，max 为 -1 表示不限
+    int max;
+    bool greedy;
+    int group;                                          // CAPTURE
+
+    explicit RegexNode(Kind k) : kind(k), min(0), max(0), greedy(true), group(0) {}
+};
+
+typedef std::unique_ptr<RegexNode> RegexNodePtr;
+
+static RegexNodePtr makeNode(RegexNode::Kind kind) {
+    return RegexNodePtr(new RegexNode(kind));
+}
+
+static RegexNodePtr makeBytes(const ByteSet& bytes) {
+    RegexNodePtr node = makeNode(RegexNode::BYTES);
+    node->bytes = bytes;
+    return node;
+}
+
+static ByteSet byteRange(int lo, int hi) {
+    ByteSet bytes;
+    for (int b = lo; b <= hi; ++b) {
+        bytes.set(b);
+    }
+    return bytes;
+}
+
+// 依次匹配若干字节（多字节的 UTF-8 字符）
+static RegexNodePtr makeSequence(const std::string& text) {
+    RegexNodePtr node = makeNode(RegexNode::CONCAT);
+    for (size_t i = 0; i < text.size(); ++i) {
+        ByteSet bytes;
+        bytes.set(static_cast<unsigned char>(text[i]));
+        node->children.push_back(makeBytes(bytes));
+    }
+    return node;
+}
+
+// 任意一个多字节的 UTF-8 字符；不能组成字符的孤立字节也各算一个字符
+static RegexNodePtr makeMultibyte() {
+    const ByteSet tail = byteRange(0x80, 0xBF);
+    RegexNodePtr node = makeNode(RegexNode::ALTERNATE);
+    const int leads[3][2] = { { 0xC2, 0xDF }, { 0xE0, 0xEF }, { 0xF0, 0xF4 } };
+    for (int n = 0; n < 3; ++n) {
+        RegexNodePtr sequence = makeNode(RegexNode::CONCAT);
+        sequence->children.push_back(makeBytes(byteRange(leads[n][0], leads[n][1])));
+        for (int k = 0; k <= n; ++k) {
+            sequence->children.push_back(makeBytes(tail));
+        }
+        node->children.push_back(std::move(sequence));
+    }
+    node->children.push_back(makeBytes(byteRange(0x80, 0xC1) | byteRange(0xF5, 0xFF)));
+    return node;
+}
+
+// 字符类：单字节部分、是否包含全部多字节字符，以及单独列出的多字节字符
+struct RegexClass {
+    ByteSet bytes;
+    bool multibyte;
+    std::vector<std::string> sequences;
+
+    RegexClass() : multibyte(false) {}
+};
+
+static RegexNodePtr makeClass(const RegexClass& cls) {
+    RegexNodePtr node = makeNode(RegexNode::ALTERNATE);
+    if (cls.bytes.any() || (!cls.multibyte && cls.sequences.empty())) {
+        node->children.push_back(makeBytes(cls.bytes));
+    }
+    if (cls.multibyte) {
+        node->children.push_back(makeMultibyte());
+    }
+    for (size_t i = 0; i < cls.sequences.size(); ++i) {
+        node->children.push_back(makeSequence(cls.sequences[i]));
+    }
+    if (node->children.size() == 1) {
+        return std::move(node->children[0]);
+    }
+    return node;
+}
+
+// ---------------------------------------------------------------- 解析
+
+class RegexParser {
+public:
+    explicit RegexParser(const std::string& pattern) : m_pattern(pattern), m_pos(0), m_groups(0) {}
+
+    RegexNodePtr parse(std::string& error);
+    int groups() const { return m_groups; }
+
+private:
+    const std::string& m_pattern;
+    size_t m_pos;
+    int m_groups;
+    std::string m_error;
+
+    static const int kMaxDepth = 200;
+    static const int kMaxRepeat = 1000;
+
+    bool atEnd() const { return m_pos >= m_pattern.size(); }
+    unsigned char peek() const { return static_cast<unsigned char>(m_pattern[m_pos]); }
+    RegexNodePtr fail(const std::string& message);
+
+    RegexNodePtr parseAlternate(int depth);
+    RegexNodePtr parseConcat(int depth);
+    RegexNodePtr parseAtom(int depth);
+    int parseRepeat(RegexNodePtr& atom);
+    bool parseBraces(int& min, int& max);
+    bool atRepeat();
+    bool parseClass(RegexClass& cls);
+    int parseEscape(RegexClass& cls);
+    std::string readCharacter();
+};
+
+RegexNodePtr RegexParser::fail(const std::string& message) {
+    if (m_error.empty()) {
+        m_error = message;
+    }
+    return RegexNodePtr();
+}
+
+RegexNodePtr RegexParser::parse(std::string& error) {
+    RegexNodePtr root = parseAlternate(0);
+    if (root && !atEnd()) {
+        root = fail("多余的右括号");
+    }
+    if (!root) {
+        error = m_error;
+    }
+    return root;
+}
+
+RegexNodePtr RegexParser::parseAlternate(int depth) {
+    if (depth > kMaxDepth) {
+        return fail("括号嵌套过深");
+    }
+    RegexNodePtr first = parseConcat(depth);
+    if (!first || atEnd() || peek() != '|') {
+        return first;
+    }
+    RegexNodePtr node = makeNode(RegexNode::ALTERNATE);
+    node->children.push_back(std::move(first));
+    while (!atEnd() && peek() == '|') {
+        ++m_pos;
+        RegexNodePtr branch = parseConcat(depth);
+        if (!branch) {
+            return branch;
+        }
+        node->children.push_back(std::move(branch));
+    }
+    // a|b|c 这样每个分支都是单个字符时合并为一个字节集合，减少 NFA 的线程数
+    ByteSet merged;
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        if (node->children[i]->kind != RegexNode::BYTES) {
+            return node;
+        }
+        merged |= node->children[i]->bytes;
+    }
+    return makeBytes(merged);
+}
+
+RegexNodePtr RegexParser::parseConcat(int depth) {
+    RegexNodePtr node = makeNode(RegexNode::CONCAT);
+    while (!atEnd() && peek() != '|' && peek() != ')') {
+        RegexNodePtr atom = parseAtom(depth);
+        if (!atom) {
+            return atom;
+        }
+        int applied = parseRepeat(atom);
+        if (applied < 0) {
+            return RegexNodePtr();
+        }
+        if (applied > 0 && atRepeat()) {
+            return fail("量词不能连用");
+        }
+        node->children.push_back(std::move(atom));
+    }
+    if (node->children.empty()) {
+        return makeNode(RegexNode::EMPTY);
+    }
+    if (node->children.size() == 1) {
+        return std::move(node->children[0]);
+    }
+    return node;
+}
+
+RegexNodePtr RegexParser::parseAtom(int depth) {
+    unsigned char c = peek();
+    switch (c) {
+        case '(': {
+            ++m_pos;
+            bool capture = true;
+            if (!atEnd() && peek() == '?') {
+                if (m_pos + 1 < m_pattern.size() && m_pattern[m_pos + 1] == ':') {
+                    capture = false;
+                    m_pos += 2;
+                } else {
+                    return fail("不支持的分组语法");
+                }
+            }
+            int group = capture ? ++m_groups : 0;
+            RegexNodePtr body = parseAlternate(depth + 1);
+            if (!body) {
+                return body;
+            }
+            if (atEnd() || peek() != ')') {
+                return fail("缺少右括号");
+            }
+            ++m_pos;
+            if (!capture) {
+                return body;
+            }
+            RegexNodePtr node = makeNode(RegexNode::CAPTURE);
+            node->group = group;
+            node->children.push_back(std::move(body));
+            return node;
+        }
+        case '*':
+        case '+':
+        case '?':
+            return fail("量词前缺少内容");
+        case '{':
+            if (atRepeat()) {
+                return fail("量词前缺少内容");
+            }
+            ++m_pos;
+            return makeBytes(ByteSet().set('{'));
+        case '^':
+            ++m_pos;
+            return makeNode(RegexNode::LINE_BEGIN);
+        case '$':
+            ++m_pos;
+            return makeNode(RegexNode::LINE_END);
+        case '.': {
+            ++m_pos;
+            RegexClass cls;
+            cls.bytes = byteRange(0, 0x7F).reset('\n');
+            cls.multibyte = true;
+            return makeClass(cls);
+        }
+        case '[': {
+            ++m_pos;
+            RegexClass cls;
+            if (!parseClass(cls)) {
+                return RegexNodePtr();
+            }
+            return makeClass(cls);
+        }
+        case '\\': {
+            ++m_pos;
+            RegexClass cls;
+            int byte = parseEscape(cls);
+            if (byte == -2) {
+                return RegexNodePtr();
+            }
+            if (byte >= 0) {
+                cls.bytes.set(byte);
+            }
+            return makeClass(cls);
+        }
+        default: {
+            std::string character = readCharacter();
+            if (character.size() == 1) {
+                return makeBytes(ByteSet().set(c));
+            }
+            return makeSequence(character);
+        }
+    }
+}
+
+// 返回 1 表示读到了量词，0 表示没有量词，-1 表示出错
+int RegexParser::parseRepeat(RegexNodePtr& atom) {
+    if (atEnd()) {
+        return 0;
+    }
+    int min = 0;
+    int max = -1;
+    unsigned char c = peek();
+    if (c == '*' || c == '+' || c == '?') {
+        min = c == '+' ? 1 : 0;
+        max = c == '?' ? 1 : -1;
+        ++m_pos;
+    } else if (c != '{' || !parseBraces(min, max)) {
+        return 0;
+    }
+    if (min > kMaxRepeat || max > kMaxRepeat) {
+        fail("重复次数过大");
+        return -1;
+    }
+    if (max >= 0 && max < min) {
+        fail("重复次数的范围无效");
+        return -1;
+    }
+    RegexNodePtr node = makeNode(RegexNode::REPEAT);
+    node->min = min;
+    node->max = max;
+    if (!atEnd() && peek() == '?') {
+        node->greedy = false;
+        ++m_pos;
+    }
+    node->children.push_back(std::move(atom));
+    atom = std::move(node);
+    return 1;
+}
+
+// {n}、{n,}、{n,m}；不符合这些形式时不移动位置，'{' 按普通字符处理
+bool RegexParser::parseBraces(int& min, int& max) {
+    size_t pos = m_pos + 1;
+    size_t digits = pos;
+    long first = 0;
+    while (pos < m_pattern.size() && m_pattern[pos] >= '0' && m_pattern[pos] <= '9') {
+        first = std::min(first * 10 + (m_pattern[pos] - '0'), 100000L);
+        ++pos;
+    }
+    if (pos == digits || pos >= m_pattern.size()) {
+        return false;
+    }
+    long second = first;
+    if (m_pattern[pos] == ',') {
+        ++pos;
+        digits = pos;
+        second = 0;
+        while (pos < m_pattern.size() && m_pattern[pos] >= '0' && m_pattern[pos] <= '9') {
+            second = std::min(second * 10 + (m_pattern[pos] - '0'), 100000L);
+            ++pos;
+        }
+        if (pos == digits) {
+            second = -1;
+        }
+    }
+    if (pos >= m_pattern.size() || m_pattern[pos] != '}') {
+        return false;
+    }
+    min = static_cast<int>(first);
+    max = static_cast<int>(second);
+    m_pos = pos + 1;
+    return true;
+}
+
+bool RegexParser::atRepeat() {
+    if (atEnd()) {
+        return false;
+    }
+    unsigned char c = peek();
+    if (c == '*' || c == '+' || c == '?') {
+        return true;
+    }
+    size_t saved = m_pos;
+    int min = 0;
+    int max = 0;
+    bool braces = c == '{' && parseBraces(min, max);
+    m_pos = saved;
+    return braces;
+}
+
+// 位于 '[' 之后，读到 ']' 为止
+bool RegexParser::parseClass(RegexClass& cls) {
+    bool negate = false;
+    if (!atEnd() && peek() == '^') {
+        negate = true;
+        ++m_pos;
+    }
+    bool first = true;
+    while (true) {
+        if (atEnd()) {
+            fail("缺少 ]");
+            return false;
+        }
+        unsigned char c = peek();
+        if (c == ']' && !first) {
+            ++m_pos;
+            break;
+        }
+        first = false;
+        int lo = c;
+        if (c == '\\') {
+            ++m_pos;
+            lo = parseEscape(cls);
+            if (lo == -2) {
+                return false;
+            }
+            if (lo < 0) {
+                continue;
+            }
+        } else if (c >= 0x80) {
+            std::string character = readCharacter();
+            if (character.size() > 1) {
+                cls.sequences.push_back(character);
+                continue;
+            }
+        } else {
+            ++m_pos;
+        }
+        int hi = lo;
+        if (m_pos + 1 < m_pattern.size() && m_pattern[m_pos] == '-' && m_pattern[m_pos + 1] != ']') {
+            ++m_pos;
+            RegexClass unused;
+            hi = peek();
+            if (hi == '\\') {
+                ++m_pos;
+                hi = parseEscape(unused);
+            } else if (hi >= 0x80) {
+                hi = -1;
+            } else {
+                ++m_pos;
+            }
+            if (hi < lo) {
+                fail("字符类的范围无效");
+                return false;
+            }
+        }
+        cls.bytes |= byteRange(lo, hi);
+    }
+    if (negate) {
+        if (!cls.sequences.empty()) {
+            fail("取反的字符类中不能出现非 ASCII 字符");
+            return false;
+        }
+        // 取反的字符类不匹配换行，与 . 一致
+        cls.bytes = ~cls.bytes & byteRange(0, 0x7F);
+        cls.bytes.reset('\n');
+        cls.multibyte = !cls.multibyte;
+    }
+    return true;
+}
+
+// 位于 '\' 之后。返回转义得到的字节；\d \w \s 等直接并入 cls 时返回 -1；出错返回 -2
+int RegexParser::parseEscape(RegexClass& cls) {
+    if (atEnd()) {
+        fail("模式串以反斜杠结尾");
+        return -2;
+    }
+    unsigned char c = peek();
+    ++m_pos;
+    ByteSet set;
+    switch (c) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case '0': return '\0';
+        case 'x': {
+            int value = 0;
+            for (int i = 0; i < 2; ++i) {
+                char h = atEnd() ? '\0' : static_cast<char>(std::tolower(peek()));
+                if (h >= '0' && h <= '9') {
+                    value = value * 16 + (h - '0');
+                } else if (h >= 'a' && h <= 'f') {
+                    value = value * 16 + (h - 'a' + 10);
+                } else {
+                    fail("\\x 后应为两位十六进制数");
+                    return -2;
+                }
+                ++m_pos;
+            }
+            return value;
+        }
+        case 'd':
+        case 'D':
+            set = byteRange('0', '9');
+            break;
+        case 'w':
+        case 'W':
+            set = byteRange('0', '9') | byteRange('A', 'Z') | byteRange('a', 'z');
+            set.set('_');
+            break;
+        case 's':
+        case 'S':
+            // 空白不含换行，匹配不会因此跨行
+            set.set(' ').set('\t').set('\r').set('\f').set('\v');
+            break;
+        default:
+            if (c >= 0x80) {
+                --m_pos;
+                std::string character = readCharacter();
+                if (character.size() > 1) {
+                    cls.sequences.push_back(character);
+                    return -1;
+                }
+                return c;
+            }
+            if (std::isalnum(c)) {
+                fail(std::string("未知的转义 \\") + static_cast<char>(c));
+                return -2;
+            }
+            return c;
+    }
+    if (std::isupper(c)) {
+        set = ~set & byteRange(0, 0x7F);
+        set.reset('\n');
+        cls.multibyte = true;
+    }
+    cls.bytes |= set;
+    return -1;
+}
+
+// 读取一个 UTF-8 字符；不完整的序列只读一个字节
+std::string RegexParser::readCharacter() {
+    unsigned char c = peek();
+    size_t length = 1;
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+    }
+    if (m_pos + length > m_pattern.size()) {
+        length = 1;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if ((static_cast<unsigned char>(m_pattern[m_pos + i]) & 0xC0) != 0x80) {
+            length = 1;
+            break;
+        }
+    }
+    std::string character = m_pattern.substr(m_pos, length);
+    m_pos += length;
+    return character;
+}
+
+// ---------------------------------------------------------------- 编译
+
+struct RegexInst {
+    // EDGE_BEFORE / EDGE_AFTER：扫描方向上前一个 / 后一个字节是换行或输入边界。
+    // 正向程序中 ^ 是 EDGE_BEFORE、$ 是 EDGE_AFTER，反向程序中相反
+    enum Op { BYTES, SPLIT, SAVE, EDGE_BEFORE, EDGE_AFTER, MATCH };
+
+    Op op;
+    int out;
+    int out1;   // SPLIT 的第二个分支，优先级低于 out
+    int arg;    // BYTES：字节集合下标；SAVE：分组槽位
+};
+
+struct RegexProgram {
+    std::vector<RegexInst> insts;
+    std::vector<ByteSet> sets;
+    int start;                      // 从当前位置开始匹配的入口
+    int searchStart;                // 前面加上非贪婪的任意字节循环，可从之后任意位置开始匹配
+    int slots;                      // 分组槽位数，分组 0 也占两个
+    int firstByte;                  // 所有匹配都以同一个字节开头时为该字节，否则为 -1
+    bool lineFeed;                  // 有能匹配换行的字节集合
+    unsigned char byteClass[256];   // 字节 -> 等价类，同一类的字节在所有集合中的归属相同
+    int classCount;
+    int lineFeedClass;
+};
+
+class RegexCompiler {
+public:
+    RegexCompiler(RegexProgram& program, bool reverse) :
+        m_program(program), m_reverse(reverse), m_tooLarge(false) {}
+
+    // 续延式编译：node 匹配之后接着执行 next，返回 node 的入口
+    int compile(const RegexNode& node, int next);
+    int emit(RegexInst::Op op, int out, int out1, int arg);
+    int addSet(const ByteSet& set);
+    bool tooLarge() const { return m_tooLarge; }
+
+private:
+    RegexProgram& m_program;
+    bool m_reverse;
+    bool m_tooLarge;
+    // 重复展开时同一个节点编译多次，共用字节集合
+    std::unordered_map<const RegexNode*, int> m_setOf;
+
+    static const size_t kMaxInsts = 50000;
+};
+
+int RegexCompiler::emit(RegexInst::Op op, int out, int out1, int arg) {
+    RegexInst inst = { op, out, out1, arg };
+    m_program.insts.push_back(inst);
+    return static_cast<int>(m_program.insts.size() - 1);
+}
+
+int RegexCompiler::addSet(const ByteSet& set) {
+    m_program.sets.push_back(set);
+    return static_cast<int>(m_program.sets.size() - 1);
+}
+
+int RegexCompiler::compile(const RegexNode& node, int next) {
+    if (m_program.insts.size() > kMaxInsts) {
+        m_tooLarge = true;
+        return next;
+    }
+    const size_t count = node.children.size();
+    switch (node.kind) {
+        case RegexNode::EMPTY:
+            return next;
+        case RegexNode::BYTES: {
+            std::unordered_map<const RegexNode*, int>::iterator it = m_setOf.find(&node);
+            int set = it != m_setOf.end() ? it->second : (m_setOf[&node] = addSet(node.bytes));
+            return emit(RegexInst::BYTES, next, -1, set);
+        }
+        case RegexNode::CONCAT:
+            // 反向程序按相反的顺序连接
+            for (size_t i = 0; i < count; ++i) {
+                next = compile(*node.children[m_reverse ? i : count - 1 - i], next);
+            }
+            return next;
+        case RegexNode::ALTERNATE: {
+            std::vector<int> entries;
+            for (size_t i = 0; i < count; ++i) {
+                entries.push_back(compile(*node.children[i], next));
+            }
+            int entry = entries.back();
+            for (size_t i = count - 1; i > 0; --i) {
+                entry = emit(RegexInst::SPLIT, entries[i - 1], entry, 0);
+            }
+            return entry;
+        }
+        case RegexNode::CAPTURE: {
+            if (m_reverse) {
+                return compile(*node.children[0], next);
+            }
+            int close = emit(RegexInst::SAVE, next, -1, 2 * node.group + 1);
+            int body = compile(*node.children[0], close);
+            return emit(RegexInst::SAVE, body, -1, 2 * node.group);
+        }
+        case RegexNode::LINE_BEGIN:
+            return emit(m_reverse ? RegexInst::EDGE_AFTER : RegexInst::EDGE_BEFORE, next, -1, 0);
+        case RegexNode::LINE_END:
+            return emit(m_reverse ? RegexInst::EDGE_BEFORE : RegexInst::EDGE_AFTER, next, -1, 0);
+        case RegexNode::REPEAT: {
+            const RegexNode& child = *node.children[0];
+            int entry = next;
+            if (node.max < 0) {
+                int loop = emit(RegexInst::SPLIT, -1, -1, 0);
+                int body = compile(child, loop);
+                m_program.insts[loop].out = node.greedy ? body : next;
+                m_program.insts[loop].out1 = node.greedy ? next : body;
+                entry = loop;
+            } else {
+                // x{0,2} 展开为 (x(x)?)?
+                for (int i = node.min; i < node.max && !m_tooLarge; ++i) {
+                    int body = compile(child, entry);
+                    entry = node.greedy ? emit(RegexInst::SPLIT, body, next, 0)
+                                        : emit(RegexInst::SPLIT, next, body, 0);
+                }
+            }
+            for (int i = 0; i < node.min && !m_tooLarge; ++i) {
+                entry = compile(child, entry);
+            }
+            return entry;
+        }
+    }
+    return next;
+}
+
+// 把 0-255 按在所有字节集合中的归属划分为等价类，换行单独成类（行首行尾判断要用）
+static void computeByteClasses(RegexProgram& program) {
+    bool boundary[257] = { false };
+    boundary[0] = true;
+    boundary['\n'] = true;
+    boundary['\n' + 1] = true;
+    for (size_t s = 0; s < program.sets.size(); ++s) {
+        const ByteSet& set = program.sets[s];
+        for (int b = 1; b < 256; ++b) {
+            if (set[b] != set[b - 1]) {
+                boundary[b] = true;
+            }
+        }
+    }
+    int cls = -1;
+    for (int b = 0; b < 256; ++b) {
+        if (boundary[b]) {
+            ++cls;
+        }
+        program.byteClass[b] = static_cast<unsigned char>(cls);
+    }
+    program.classCount = cls + 1;
+    program.lineFeedClass = program.byteClass['\n'];
+}
+
+// 从入口出发不消耗字节能到达的所有指令都是 BYTES 且只接受同一个字节时，返回该字节
+static int computeFirstByte(const RegexProgram& program) {
+    std::vector<bool> seen(program.insts.size(), false);
+    std::vector<int> stack(1, program.start);
+    ByteSet first;
+    while (!stack.empty()) {
+        int pc = stack.back();
+        stack.pop_back();
+        if (seen[pc]) {
+            continue;
+        }
+        seen[pc] = true;
+        const RegexInst& inst = program.insts[pc];
+        switch (inst.op) {
+            case RegexInst::BYTES:
+                first |= program.sets[inst.arg];
+                break;
+            case RegexInst::SPLIT:
+                stack.push_back(inst.out1);
+                stack.push_back(inst.out);
+                break;
+            case RegexInst::SAVE:
+                stack.push_back(inst.out);
+                break;
+            default:
+                return -1;
+        }
+    }
+    if (first.count() != 1) {
+        return -1;
+    }
+    for (int b = 0; b < 256; ++b) {
+        if (first[b]) {
+            return b;
+        }
+    }
+    return -1;
+}
+
+static std::shared_ptr<const RegexProgram> buildProgram(const RegexNode& root, int groups,
+                                                        bool reverse, std::string& error) {
+    std::shared_ptr<RegexProgram> program = std::make_shared<RegexProgram>();
+    RegexCompiler compiler(*program, reverse);
+    int match = compiler.emit(RegexInst::MATCH, -1, -1, 0);
+    if (reverse) {
+        program->start = compiler.compile(root, match);
+    } else {
+        int close = compiler.emit(RegexInst::SAVE, match, -1, 1);
+        int body = compiler.compile(root, close);
+        program->start = compiler.emit(RegexInst::SAVE, body, -1, 0);
+    }
+    if (compiler.tooLarge()) {
+        error = "正则表达式过于复杂";
+        return std::shared_ptr<const RegexProgram>();
+    }
+    program->lineFeed = false;
+    for (size_t s = 0; s < program->sets.size(); ++s) {
+        program->lineFeed = program->lineFeed || program->sets[s]['\n'];
+    }
+    int loop = compiler.emit(RegexInst::SPLIT, program->start, -1, 0);
+    int any = compiler.emit(RegexInst::BYTES, loop, -1, compiler.addSet(ByteSet().set()));
+    program->insts[loop].out1 = any;
+    program->searchStart = loop;
+    program->slots = 2 * (groups + 1);
+    computeByteClasses(*program);
+    program->firstByte = computeFirstByte(*program);
+    return program;
+}
+
+// 语法树只由单个字节依次连接而成时，取出这串字节
+static bool literalOf(const RegexNode& node, std::string& literal) {
+    if (node.kind == RegexNode::BYTES) {
+        if (node.bytes.count() != 1) {
+            return false;
+        }
+        for (int b = 0; b < 256; ++b) {
+            if (node.bytes[b]) {
+                literal += static_cast<char>(b);
+            }
+        }
+        return true;
+    }
+    if (node.kind != RegexNode::CONCAT) {
+        return false;
+    }
+    for (size_t i = 0; i < node.children.size(); ++i) {
+        if (!literalOf(*node.children[i], literal)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int byteAt(const RegexInput& input, size_t offset) {
+    const char* data;
+    size_t length;
+    size_t start;
+    input.chunkAt(offset, data, length, start);
+    return static_cast<unsigned char>(data[offset - start]);
+}
+
+// ---------------------------------------------------------------- 惰性 DFA
+
+// DFA 状态是按优先级排列的 NFA 指令列表（已沿空转移展开），加上两个标志：
+// 前一个字节是否为换行（行首判断），以及在前一个字节之前是否已有匹配结束。
+// 行尾要看后一个字节，因此等待行尾判断的指令留在列表中，读入下一个字节时再展开，
+// 匹配也就在读入匹配终点之后的那个字节时才能确认
+class RegexDfa {
+public:
+    RegexDfa(const RegexProgram& program, int entry, bool longest, int skipByte);
+
+    // 正向扫描 [from, to)，found 为是否有匹配，end 为最左匹配的终点。
+    // 状态缓存清空过于频繁时返回 false，由调用方改用 NFA 模拟
+    bool scanForward(const RegexInput& input, size_t from, size_t to, bool& found, size_t& end);
+    // 从 end 反向扫描到 from，start 为最靠前的起点
+    bool scanBackward(const RegexInput& input, size_t from, size_t end, bool& found, size_t& start);
+
+private:
+    enum { kDead = 0, kUnknown = -1 };
+    enum { kEdgeBefore = 1, kMatched = 2 };
+
+    const RegexProgram& m_program;
+    int m_entry;
+    bool m_longest;     // 最长匹配（反向找起点），否则在优先的匹配处截断
+    int m_skipByte;     // 处于初始状态时可以用 memchr 跳到这个字节
+    int m_stride;       // 每个状态的转移数：各字节等价类，加上输入结束
+    size_t m_maxStates;
+
+    std::vector<int> m_next;
+    std::vector<std::vector<int> > m_lists;
+    std::vector<unsigned char> m_flags;
+    std::unordered_map<std::string, int> m_states;
+    int m_start[2];
+    bool m_reset;
+
+    // 构造状态用的工作区
+    std::vector<int> m_stack;
+    std::vector<unsigned> m_mark;
+    unsigned m_stamp;
+    std::vector<int> m_work;
+    std::vector<int> m_list;
+    std::vector<int> m_classByte;
+
+    static const size_t kCacheBytes = 4 * 1024 * 1024;
+    // 每次清空缓存后至少应处理的字节数（按每个状态计），否则认为 DFA 不划算
+    static const size_t kMinBytesPerState = 10;
+
+    void clearCache();
+    void newStamp();
+    void addClosure(std::vector<int>& list, int pc, bool edgeBefore, int edgeAfter);
+    int lookup(const std::vector<int>& list, unsigned char flags);
+    int startState(bool edgeBefore);
+    int step(int state, int symbol);
+    int transition(int state, int symbol);
+};
+
+const size_t RegexDfa::kCacheBytes;
+const size_t RegexDfa::kMinBytesPerState;
+
+RegexDfa::RegexDfa(const RegexProgram& program, int entry, bool longest, int skipByte) :
+    m_program(program),
+    m_entry(entry),
+    m_longest(longest),
+    m_skipByte(skipByte),
+    m_stride(program.classCount + 1),
+    m_reset(false),
+    m_mark(program.insts.size(), 0),
+    m_stamp(0),
+    m_classByte(program.classCount, 0) {
+    m_maxStates = std::max<size_t>(64, kCacheBytes / (m_stride * sizeof(int) + 64));
+    for (int b = 255; b >= 0; --b) {
+        m_classByte[program.byteClass[b]] = b;
+    }
+    clearCache();
+}
+
+void RegexDfa::clearCache() {
+    m_states.clear();
+    m_lists.assign(1, std::vector<int>());
+    m_flags.assign(1, 0);
+    m_next.assign(m_stride, kDead);
+    m_start[0] = m_start[1] = kUnknown;
+    m_reset = true;
+}
+
+void RegexDfa::newStamp() {
+    if (++m_stamp == 0) {
+        std::fill(m_mark.begin(), m_mark.end(), 0);
+        m_stamp = 1;
+    }
+}
+
+// 按优先级深度优先展开空转移。edgeAfter：-1 为尚不知道后一个字节，0/1 为不满足/满足行尾
+void RegexDfa::addClosure(std::vector<int>& list, int pc, bool edgeBefore, int edgeAfter) {
+    m_stack.push_back(pc);
+    while (!m_stack.empty()) {
+        int p = m_stack.back();
+        m_stack.pop_back();
+        if (m_mark[p] == m_stamp) {
+            continue;
+        }
+        m_mark[p] = m_stamp;
+        const RegexInst& inst = m_program.insts[p];
+        switch (inst.op) {
+            case RegexInst::BYTES:
+            case RegexInst::MATCH:
+                list.push_back(p);
+                break;
+            case RegexInst::SPLIT:
+                m_stack.push_back(inst.out1);
+                m_stack.push_back(inst.out);
+                break;
+            case RegexInst::SAVE:
+                m_stack.push_back(inst.out);
+                break;
+            case RegexInst::EDGE_BEFORE:
+                if (edgeBefore) {
+                    m_stack.push_back(inst.out);
+                }
+                break;
+            case RegexInst::EDGE_AFTER:
+                if (edgeAfter < 0) {
+                    list.push_back(p);
+                } else if (edgeAfter > 0) {
+                    m_stack.push_back(inst.out);
+                }
+                break;
+        }
+    }
+}
+
+int RegexDfa::lookup(const std::vector<int>& list, unsigned char flags) {
+    if (list.empty() && !(flags & kMatched)) {
+        return kDead;
+    }
+    std::string key(1 + list.size() * sizeof(int), '\0');
+    key[0] = static_cast<char>(flags);
+    if (!list.empty()) {
+        std::memcpy(&key[1], list.data(), list.size() * sizeof(int));
+    }
+    std::unordered_map<std::string, int>::iterator it = m_states.find(key);
+    if (it != m_states.end()) {
+        return it->second;
+    }
+    if (m_lists.size() >= m_maxStates) {
+        clearCache();
+    }
+    int state = static_cast<int>(m_lists.size());
+    m_lists.push_back(list);
+    m_flags.push_back(flags);
+    m_next.resize(m_next.size() + m_stride, kUnknown);
+    m_states[key] = state;
+    return state;
+}
+
+int RegexDfa::startState(bool edgeBefore) {
+    if (m_start[edgeBefore] != kUnknown) {
+        return m_start[edgeBefore];
+    }
+    newStamp();
+    m_list.clear();
+    addClosure(m_list, m_entry, edgeBefore, -1);
+    int state = lookup(m_list, edgeBefore ? kEdgeBefore : 0);
+    m_start[edgeBefore] = state;
+    return state;
+}
+
+// 计算 state 读入 symbol（字节等价类，或 classCount 表示输入结束）后的状态
+int RegexDfa::step(int state, int symbol) {
+    m_work = m_lists[state];
+    bool edgeBefore = (m_flags[state] & kEdgeBefore) != 0;
+    bool edgeAfter = symbol == m_program.classCount || symbol == m_program.lineFeedClass;
+
+    // 现在知道了后一个字节，展开等待行尾判断的指令
+    newStamp();
+    m_list.clear();
+    for (size_t i = 0; i < m_work.size(); ++i) {
+        addClosure(m_list, m_work[i], edgeBefore, edgeAfter ? 1 : 0);
+    }
+    m_work.swap(m_list);
+
+    newStamp();
+    m_list.clear();
+    bool matched = false;
+    int byte = symbol < m_program.classCount ? m_classByte[symbol] : -1;
+    for (size_t i = 0; i < m_work.size(); ++i) {
+        const RegexInst& inst = m_program.insts[m_work[i]];
+        if (inst.op == RegexInst::MATCH) {
+            matched = true;
+            if (!m_longest) {
+                // 优先级更低的线程不再需要
+                break;
+            }
+        } else if (byte >= 0 && m_program.sets[inst.arg][byte]) {
+            addClosure(m_list, inst.out, symbol == m_program.lineFeedClass, -1);
+        }
+    }
+    unsigned char flags = (symbol == m_program.lineFeedClass ? kEdgeBefore : 0) | (matched ? kMatched : 0);
+    m_reset = false;
+    int next = lookup(m_list, flags);
+    if (!m_reset) {
+        m_next[state * m_stride + symbol] = next;
+    }
+    return next;
+}
+
+int RegexDfa::transition(int state, int symbol) {
+    int next = m_next[state * m_stride + symbol];
+    return next != kUnknown ? next : step(state, symbol);
+}
+
+bool RegexDfa::scanForward(const RegexInput& input, size_t from, size_t to, bool& found, size_t& end) {
+    found = false;
+    const size_t minBytes = m_maxStates * kMinBytesPerState;
+    size_t lastReset = from;
+    int state = startState(from == 0 || byteAt(input, from - 1) == '\n');
+    size_t pos = from;
+    while (pos < to && state != kDead) {
+        const char* data;
+        size_t length;
+        size_t start;
+        input.chunkAt(pos, data, length, start);
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data) + (pos - start);
+        size_t n = std::min(start + length, to) - pos;
+        size_t i = 0;
+        while (i < n) {
+            if (m_skipByte >= 0 && (state == m_start[0] || state == m_start[1])) {
+                // 初始状态下匹配只能从 m_skipByte 开始，中间的字节直接跳过
+                const void* hit = std::memchr(p + i, m_skipByte, n - i);
+                size_t j = hit ? static_cast<size_t>(static_cast<const unsigned char*>(hit) - p) : n;
+                if (j > i) {
+                    state = startState(p[j - 1] == '\n');
+                    i = j;
+                    if (i == n) {
+                        break;
+                    }
+                }
+            }
+            int symbol = m_program.byteClass[p[i]];
+            int next = m_next[state * m_stride + symbol];
+            if (next == kUnknown) {
+                next = step(state, symbol);
+                if (m_reset) {
+                    if (pos + i - lastReset < minBytes) {
+                        return false;
+                    }
+                    lastReset = pos + i;
+                }
+            }
+            state = next;
+            if (m_flags[state] & kMatched) {
+                found = true;
+                end = pos + i;
+            }
+            if (state == kDead) {
+                return true;
+            }
+            ++i;
+        }
+        pos += n;
+    }
+    if (state == kDead) {
+        return true;
+    }
+    // 读入 to 处的字节（或输入结束）以确认在 to 处结束的匹配
+    int symbol = to < input.length() ? m_program.byteClass[byteAt(input, to)] : m_program.classCount;
+    state = transition(state, symbol);
+    if (m_flags[state] & kMatched) {
+        found = true;
+        end = to;
+    }
+    return true;
+}
+
+bool RegexDfa::scanBackward(const RegexInput& input, size_t from, size_t end, bool& found, size_t& start) {
+    found = false;
+    const size_t minBytes = m_maxStates * kMinBytesPerState;
+    size_t lastReset = end;
+    int state = startState(end >= input.length() || byteAt(input, end) == '\n');
+    size_t pos = end;
+    while (pos > from && state != kDead) {
+        const char* data;
+        size_t length;
+        size_t chunkStart;
+        input.chunkAt(pos - 1, data, length, chunkStart);
+        size_t lo = std::max(chunkStart, from);
+        while (pos > lo) {
+            int symbol = m_program.byteClass[static_cast<unsigned char>(data[pos - 1 - chunkStart])];
+            int next = m_next[state * m_stride + symbol];
+            if (next == kUnknown) {
+                next = step(state, symbol);
+                if (m_reset) {
+                    if (lastReset - pos < minBytes) {
+                        return false;
+                    }
+                    lastReset = pos;
+                }
+            }
+            state = next;
+            if (m_flags[state] & kMatched) {
+                found = true;
+                start = pos;
+            }
+            if (state == kDead) {
+                return true;
+            }
+            --pos;
+        }
+    }
+    if (state == kDead) {
+        return true;
+    }
+    int symbol = from > 0 ? m_program.byteClass[byteAt(input, from - 1)] : m_program.classCount;
+    state = transition(state, symbol);
+    if (m_flags[state] & kMatched) {
+        found = true;
+        start = from;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------- 正则表达式
+
+Regex::Regex() : m_isLiteral(false), m_groups(0) {}
+
+bool Regex::compile(const std::string& pattern, std::string& error) {
+    RegexParser parser(pattern);
+    RegexNodePtr root = parser.parse(error);
+    if (!root) {
+        return false;
+    }
+    std::shared_ptr<const RegexProgram> forward = buildProgram(*root, parser.groups(), false, error);
+    std::shared_ptr<const RegexProgram> reverse = forward ? buildProgram(*root, 0, true, error)
+                                                          : std::shared_ptr<const RegexProgram>();
+    if (!reverse) {
+        return false;
+    }
+    m_pattern = pattern;
+    m_groups = static_cast<size_t>(parser.groups());
+    m_forward = forward;
+    m_reverse = reverse;
+    m_literal.clear();
+    m_isLiteral = literalOf(*root, m_literal) && !m_literal.empty();
+    return true;
+}
+
+bool Regex::isCompiled() const {
+    return m_forward != NULL;
+}
+
+const std::string& Regex::pattern() const {
+    return m_pattern;
+}
+
+size_t Regex::groupCount() const {
+    return m_groups;
+}
+
+bool Regex::isLiteral() const {
+    return m_isLiteral;
+}
+
+const std::string& Regex::literal() const {
+    return m_literal;
+}
+
+bool Regex::matchesLineFeed() const {
+    return m_forward && m_forward->lineFeed;
+}
+
+// ---------------------------------------------------------------- 匹配器
+
+RegexMatcher::RegexMatcher(const Regex& regex) : m_regex(regex) {
+    if (regex.isCompiled()) {
+        const RegexProgram& forward = *regex.m_forward;
+        const RegexProgram& reverse = *regex.m_reverse;
+        m_forward.reset(new RegexDfa(forward, forward.searchStart, false, forward.firstByte));
+        m_reverse.reset(new RegexDfa(reverse, reverse.start, true, -1));
+    }
+}
+
+RegexMatcher::~RegexMatcher() {}
+
+bool RegexMatcher::search(const RegexInput& input, size_t from, size_t to, RegexMatch& match,
+                          bool wantGroups) {
+    to = std::min(to, input.length());
+    if (!m_forward || from > to) {
+        return false;
+    }
+    bool found = false;
+    size_t end = 0;
+    size_t start = 0;
+    if (!m_forward->scanForward(input, from, to, found, end) ||
+        (found && (!m_reverse->scanBackward(input, from, end, found, start) || !found))) {
+        return simulate(input, from, to, false, wantGroups, match);
+    }
+    if (!found) {
+        return false;
+    }
+    if (wantGroups && m_regex.groupCount() > 0) {
+        // 起点和终点已知，只在匹配范围内做一次 NFA 模拟
+        return simulate(input, start, end, true, true, match);
+    }
+    match.start = start;
+    match.end = end;
+    match.groups.assign(2, start);
+    match.groups[1] = end;
+    return true;
+}
+
+// 找到 offset 及之后的第一个换行，没有时返回输入长度
+static size_t lineEndFrom(const RegexInput& input, size_t offset) {
+    size_t total = input.length();
+    while (offset < total) {
+        const char* data;
+        size_t length;
+        size_t start;
+        input.chunkAt(offset, data, length, start);
+        const char* begin = data + (offset - start);
+        const void* hit = std::memchr(begin, '\n', start + length - offset);
+        if (hit) {
+            return offset + static_cast<size_t>(static_cast<const char*>(hit) - begin);
+        }
+        offset = start + length;
+    }
+    return total;
+}
+
+// 从末尾开始逐个窗口正向查找，取窗口内起点最靠后的匹配。
+// 模式不能匹配换行时，起点在窗口内的匹配不会越过窗口末尾所在的行
+bool RegexMatcher::searchLast(const RegexInput& input, size_t from, size_t to, RegexMatch& match,
+                              bool wantGroups) {
+    to = std::min(to, input.length());
+    if (!m_forward) {
+        return false;
+    }
+    size_t hi = to;
+    while (hi > from) {
+        size_t lo = hi - from > kSearchWindow ? hi - kSearchWindow : from;
+        size_t limit = m_regex.matchesLineFeed() ? input.length() : lineEndFrom(input, hi);
+        bool found = false;
+        RegexMatch candidate;
+        for (size_t pos = lo; pos < hi && search(input, pos, limit, candidate) && candidate.start < hi;
+             pos = candidate.start + 1) {
+            match = candidate;
+            found = true;
+        }
+        if (found) {
+            if (wantGroups && m_regex.groupCount() > 0) {
+                return simulate(input, match.start, match.end, true, true, match);
+            }
+            return true;
+        }
+        hi = lo;
+    }
+    return false;
+}
+
+// NFA 模拟（Pike VM）：线程按优先级排列，每个线程带着自己的分组位置，
+// 每个位置上同一条指令只保留优先级最高的线程，耗时为 O(输入长度 × 程序长度)
+bool RegexMatcher::simulate(const RegexInput& input, size_t from, size_t to, bool anchored,
+                            bool wantGroups, RegexMatch& match) const {
+    const RegexProgram& program = *m_regex.m_forward;
+    // 不需要分组时只记录整个匹配的起止
+    const size_t slotCount = wantGroups ? static_cast<size_t>(program.slots) : 2;
+    // 线程列表：指令和分组位置分别连续存放，避免逐个线程分配内存
+    struct Threads {
+        std::vector<int> pcs;
+        std::vector<size_t> slots;
+        void clear() { pcs.clear(); slots.clear(); }
+    };
+    // 展开空转移用的栈；pc 为 -1 时表示回溯到此处，把槽位恢复为 value
+    struct Frame {
+        int pc;
+        size_t slot;
+        size_t value;
+    };
+    Threads pending;
+    Threads current;
+    std::vector<Frame> stack;
+    std::vector<unsigned> mark(program.insts.size(), 0);
+    unsigned stamp = 0;
+    std::vector<size_t> slots(slotCount);
+    std::vector<size_t> best;
+    bool matched = false;
+
+    const size_t total = input.length();
+    const char* data = NULL;
+    size_t chunkStart = 0;
+    size_t chunkLength = 0;
+    int previous = from > 0 ? byteAt(input, from - 1) : -1;
+    for (size_t pos = from; ; ++pos) {
+        int byte = -1;
+        if (pos < total) {
+            if (pos < chunkStart || pos >= chunkStart + chunkLength) {
+                input.chunkAt(pos, data, chunkLength, chunkStart);
+            }
+            byte = static_cast<unsigned char>(data[pos - chunkStart]);
+        }
+        bool edgeBefore = previous < 0 || previous == '\n';
+        bool edgeAfter = byte < 0 || byte == '\n';
+
+        ++stamp;
+        current.clear();
+        bool seed = !matched && (!anchored || pos == from);
+        size_t count = pending.pcs.size() + (seed ? 1 : 0);
+        for (size_t t = 0; t < count; ++t) {
+            Frame root = { program.start, 0, 0 };
+            if (t < pending.pcs.size()) {
+                root.pc = pending.pcs[t];
+                std::copy(pending.slots.begin() + t * slotCount,
+                          pending.slots.begin() + (t + 1) * slotCount, slots.begin());
+            } else {
+                std::fill(slots.begin(), slots.end(), RegexMatch::npos);
+            }
+            stack.push_back(root);
+            while (!stack.empty()) {
+                Frame frame = stack.back();
+                stack.pop_back();
+                if (frame.pc < 0) {
+                    slots[frame.slot] = frame.value;
+                    continue;
+                }
+                if (mark[frame.pc] == stamp) {
+                    continue;
+                }
+                mark[frame.pc] = stamp;
+                const RegexInst& inst = program.insts[frame.pc];
+                Frame next = { inst.out, 0, 0 };
+                switch (inst.op) {
+                    case RegexInst::BYTES:
+                    case RegexInst::MATCH:
+                        current.pcs.push_back(frame.pc);
+                        current.slots.insert(current.slots.end(), slots.begin(), slots.end());
+                        break;
+                    case RegexInst::SPLIT: {
+                        Frame second = { inst.out1, 0, 0 };
+                        stack.push_back(second);
+                        stack.push_back(next);
+                        break;
+                    }
+                    case RegexInst::SAVE:
+                        if (static_cast<size_t>(inst.arg) < slotCount) {
+                            Frame restore = { -1, static_cast<size_t>(inst.arg), slots[inst.arg] };
+                            stack.push_back(restore);
+                            slots[inst.arg] = pos;
+                        }
+                        stack.push_back(next);
+                        break;
+                    case RegexInst::EDGE_BEFORE:
+                        if (edgeBefore) {
+                            stack.push_back(next);
+                        }
+                        break;
+                    case RegexInst::EDGE_AFTER:
+                        if (edgeAfter) {
+                            stack.push_back(next);
+                        }
+                        break;
+                }
+            }
+        }
+        pending.clear();
+        for (size_t t = 0; t < current.pcs.size(); ++t) {
+            const RegexInst& inst = program.insts[current.pcs[t]];
+            std::vector<size_t>::const_iterator threadSlots = current.slots.begin() + t * slotCount;
+            if (inst.op == RegexInst::MATCH) {
+                // 优先级更低的线程不再需要
+                matched = true;
+                best.assign(threadSlots, threadSlots + slotCount);
+                break;
+            }
+            if (pos < to && byte >= 0 && program.sets[inst.arg][byte]) {
+                pending.pcs.push_back(inst.out);
+                pending.slots.insert(pending.slots.end(), threadSlots, threadSlots + slotCount);
+            }
+        }
+        if (pos >= to || (pending.pcs.empty() && (matched || anchored))) {
+            break;
+        }
+        previous = byte;
+    }
+    if (!matched) {
+        return false;
+    }
+    match.start = best[0];
+    match.end = best[1];
+    match.groups.swap(best);
+    return true;
+}
@@ -0,0 +1,261 @@
+/**
+ * @file renderer.cpp
+ * @brief 把编辑器的状态绘制到 Screen 的实现
+ */
+#include "../include/renderer.h"
+#include "../include/utils.h"
+#include <algorithm>
+
+Renderer::Renderer(Editor& editor, Screen& screen) :
+    m_editor(editor),
+    m_screen(screen),
+    m_fullRedraw(true),
+    m_drawnTopLine(0),
+    m_drawnLeftColumn(0),
+    m_drawnCursorLine(0),
+    m_drawnWrap(false),
+    m_drawnStatusColor(0) {}
+
+void Renderer::invalidate() {
+    m_fullRedraw = true;
+    m_drawnStatus.clear();
+}
+
+Viewport& Renderer::viewport() {
+    return m_viewport;
+}
+
+// 一帧：只重绘变化的行和状态栏，最后一次输出
+void Renderer::renderFrame(const std::string& statusMessage) {
+    renderContent(m_editor.takeDamage());
+    renderStatusBar(statusMessage);
+    placeCursor();
+    m_screen.present();
+}
+
+// 终端光标放在光标所在字素簇的第一列
+void Renderer::placeCursor() {
+    std::pair<int, int> cursor = m_editor.getCursorPosition();
+    int column = m_editor.getCursorDisplayColumn();
+    if (m_editor.isWrapEnabled()) {
+        size_t width = static_cast<size_t>(m_viewport.columns());
+        int cursorRow = m_editor.getCursorWrapRow(width);
+        std::vector<std::pair<int, int> >::const_iterator row =
+            std::find(m_drawnRows.begin(), m_drawnRows.end(), std::make_pair(cursor.first, cursorRow));
+        if (row != m_drawnRows.end()) {
+            column -= static_cast<int>(m_editor.getWrapRows(cursor.first, width)[cursorRow]);
+            m_screen.setCursor(static_cast<int>(row - m_drawnRows.begin()),
+                               std::min(column, m_viewport.columns() - 1));
+        }
+    } else {
+        m_screen.setCursor(cursor.first - m_viewport.topLine(), column - m_viewport.leftColumn());
+    }
+}
+
+void Renderer::renderContent(const EditorDamage& damage) {
+    // 视口跟随光标，只绘制可见的行，每帧的开销与文件大小无关
+    m_viewport.resize(m_screen.rows(), m_screen.columns());
+    std::pair<int, int> cursor = m_editor.getCursorPosition();
+    if (m_editor.isWrapEnabled()) {
+        renderWrapped(damage, cursor.first);
+    } else {
+        m_viewport.follow(cursor.first, m_editor.getCursorDisplayColumn());
+        m_editor.ensureLineIndexed(m_viewport.bottomLine() - 1);
+    }
+
+    // 视口滚动后所有行都移动了位置，整屏重绘
+    bool full = m_fullRedraw || m_drawnWrap || m_viewport.topLine() != m_drawnTopLine ||
+                m_viewport.leftColumn() != m_drawnLeftColumn;
+    if (m_editor.isWrapEnabled()) {
+        // 已按屏幕行绘制
+    } else if (full) {
+        m_screen.clear();
+        for (int line = m_viewport.topLine(); line < m_viewport.bottomLine(); ++line) {
+            renderLine(line, line == cursor.first);
+        }
+    } else {
+        if (damage.firstLine >= 0) {
+            int first = std::max(damage.firstLine, m_viewport.topLine());
+            int last = std::min(damage.lastLine, m_viewport.bottomLine() - 1);
+            for (int line = first; line <= last; ++line) {
+                renderLine(line, line == cursor.first);
+            }
+        }
+        // 光标换行时，旧行去掉高亮，新行加上高亮
+        if (m_drawnCursorLine != cursor.first) {
+            if (m_viewport.isLineVisible(m_drawnCursorLine)) {
+                renderLine(m_drawnCursorLine, false);
+            }
+            renderLine(cursor.first, true);
+        }
+    }
+    m_fullRedraw = false;
+    m_drawnWrap = m_editor.isWrapEnabled();
+    m_drawnTopLine = m_viewport.topLine();
+    m_drawnLeftColumn = m_viewport.leftColumn();
+    m_drawnCursorLine = cursor.first;
+}
+
+// 软换行：从顶部的（行, 行内屏幕行）开始排出各屏幕行，与上一帧比较，
+// 只重画内容变了、位置移动了或光标行高亮变化的屏幕行
+void Renderer::renderWrapped(const EditorDamage& damage, int cursorLine) {
+    size_t width = static_cast<size_t>(m_viewport.columns());
+    Viewport::RowCounter rowCount = rowCounter();
+    m_viewport.followWrapped(cursorLine, m_editor.getCursorWrapRow(width), rowCount);
+    m_editor.ensureLineIndexed(m_viewport.topLine() + m_viewport.rows());
+
+    size_t rows = static_cast<size_t>(m_viewport.rows());
+    int lineCount = m_editor.getLineCount();
+    int line = m_viewport.topLine();
+    int segment = m_viewport.topRow();
+    m_screenRows.clear();
+    while (m_screenRows.size() < rows) {
+        if (line >= lineCount) {
+            m_screenRows.push_back(std::make_pair(-1, 0));
+            continue;
+        }
+        m_screenRows.push_back(std::make_pair(line, segment));
+        if (++segment >= rowCount(line)) {
+            ++line;
+            segment = 0;
+        }
+    }
+
+    bool full = m_fullRedraw || !m_drawnWrap || m_drawnRows.size() != rows;
+    bool cursorMoved = cursorLine != m_drawnCursorLine;
+    for (size_t row = 0; row < rows; ++row) {
+        int rowLine = m_screenRows[row].first;
+        bool damaged = damage.firstLine >= 0 && rowLine >= damage.firstLine && rowLine <= damage.lastLine;
+        bool highlight = cursorMoved && (rowLine == cursorLine || rowLine == m_drawnCursorLine);
+        if (!full && !damaged && !highlight && m_screenRows[row] == m_drawnRows[row]) {
+            continue;
+        }
+        if (rowLine < 0) {
+            m_screen.drawRow(static_cast<int>(row), std::string());
+            continue;
+        }
+        const std::vector<size_t>& starts = m_editor.getWrapRows(rowLine, width);
+        size_t begin = starts[static_cast<size_t>(m_screenRows[row].second)];
+        size_t end = starts[static_cast<size_t>(m_screenRows[row].second) + 1];
+        renderRow(static_cast<int>(row), rowLine, begin, end - begin, rowLine == cursorLine);
+    }
+    m_drawnRows.swap(m_screenRows);
+}
+
+Viewport::RowCounter Renderer::rowCounter() {
+    size_t width = static_cast<size_t>(m_viewport.columns());
+    return [this, width](int line) {
+        return static_cast<int>(m_editor.getWrapRows(line, width).size() - 1);
+    };
+}
+
+// 重绘一行：先清除该行，再按视口裁剪后写入
+void Renderer::renderLine(int line, bool current) {
+    renderRow(line - m_viewport.topLine(), line, static_cast<size_t>(m_viewport.leftColumn()),
+              static_cast<size_t>(m_viewport.columns()), current);
+}
+
+void Renderer::renderRow(int row, int line, size_t left, size_t columns, bool current) {
+    // 视口按显示列计算，宽字符占两列，制表符已展开
+    m_screen.drawRow(row, m_editor.getDisplaySegment(line, left, columns));
+
+    // 高亮当前行
+    if (current) {
+        m_screen.setStyle(row, 0, -1, true, 0);
+    }
+
+    // 先画语法高亮，再画关键字，查找匹配画在最上层；各高亮的位置都是字节偏移
+    const LineLayout& layout = m_editor.getLineLayout(line);
+    m_editor.getLineSyntax(line, m_lineSyntax);
+    for (size_t i = 0; i < m_lineSyntax.size(); ++i) {
+        paintSpan(row, layout, left, left + columns, m_lineSyntax[i].column, m_lineSyntax[i].length, current,
+                  static_cast<short>(Screen::kSyntaxPair + static_cast<int>(m_lineSyntax[i].kind)));
+    }
+
+    // 关键字按编号轮流使用几种颜色
+    size_t byteBegin = layout.byteAt(left);
+    size_t byteEnd = layout.nextCluster(layout.byteAt(left + columns));
+    m_editor.getLineKeywords(line, byteBegin, byteEnd - byteBegin, m_lineKeywords);
+    for (size_t i = 0; i < m_lineKeywords.size(); ++i) {
+        paintSpan(row, layout, left, left + columns, m_lineKeywords[i].column, m_lineKeywords[i].length, current,
+                  static_cast<short>(Screen::kKeywordPair + m_lineKeywords[i].keyword % Screen::kKeywordColors));
+    }
+
+    // 高亮该行的查找匹配
+    m_editor.getLineMatches(line, m_lineMatches);
+    for (size_t i = 0; i < m_lineMatches.size(); ++i) {
+        paintSpan(row, layout, left, left + columns, m_lineMatches[i].first, m_lineMatches[i].second, current,
+                  Screen::kMatchPair);
+    }
+}
+
+// 把字节区间 [column, column + length) 换算成显示列，裁剪到 [left, right) 后改颜色
+void Renderer::paintSpan(int row, const LineLayout& layout, size_t left, size_t right, size_t column,
+                         size_t length, bool reverse, short pair) {
+    size_t begin = std::max(layout.columnOf(column), left);
+    size_t end = std::min(layout.columnOf(column + length), right);
+    if (begin < end) {
+        m_screen.setStyle(row, static_cast<int>(begin - left), static_cast<int>(end - begin), reverse, pair);
+    }
+}
+
+void Renderer::renderStatusBar(const std::string& statusMessage) {
+    std::string modeStr = getModeString();
+    std::pair<int, int> cursor = m_editor.getCursorPosition();
+    std::string statusLine = "Mode: " + modeStr + " | File: " +
+        (m_editor.getCurrentFile().empty() ? "Untitled" : m_editor.getCurrentFile()) +
+        (m_editor.hasDosLineEndings() ? " [dos]" : "") +
+        " | Ln " + std::to_string(cursor.first + 1) + "/" + std::to_string(m_editor.getLineCount()) +
+        (m_editor.isFullyIndexed() ? "" : "+") +
+        ", Col " + std::to_string(cursor.second + 1);
+    // 与 vim 相同：字节列和显示列不同时都显示
+    int displayColumn = m_editor.getCursorDisplayColumn();
+    if (displayColumn != cursor.second) {
+        statusLine += "-" + std::to_string(displayColumn + 1);
+    }
+    size_t currentMatch = 0;
+    size_t totalMatches = 0;
+    if (m_editor.getMatchCount(currentMatch, totalMatches)) {
+        statusLine += " | match " + formatCount(currentMatch) + " of " + formatCount(totalMatches) +
+                      (m_editor.isMatchCountPartial() ? "+" : "");
+    }
+    statusLine += " | " + statusMessage;
+    if (m_editor.isSaving()) {
+        statusLine += " | 保存中 " + std::to_string(m_editor.getSaveProgress()) + "%";
+    }
+    if (m_editor.isLoading()) {
+        statusLine += " | 载入中 " + std::to_string(m_editor.getLoadProgress()) + "%";
+    }
+
+    // 根据模式设置颜色
+    int colorPair = Screen::kNormalPair;
+    switch(m_editor.getMode()) {
+        case EditorMode::INSERT: colorPair = Screen::kInsertPair; break;
+        case EditorMode::COMMAND: colorPair = Screen::kCommandPair; break;
+        case EditorMode::VISUAL_CHAR:
+        case EditorMode::VISUAL_LINE:
+        case EditorMode::VISUAL_BLOCK:
+            colorPair = Screen::kVisualPair; break;
+        default: break;
+    }
+
+    // 内容和颜色都没变时不重绘
+    if (statusLine == m_drawnStatus && colorPair == m_drawnStatusColor) {
+        return;
+    }
+    m_drawnStatus = statusLine;
+    m_drawnStatusColor = colorPair;
+    m_screen.drawStatus(statusLine, static_cast<short>(colorPair));
+}
+
+std::string Renderer::getModeString() {
+    switch(m_editor.getMode()) {
+        case EditorMode::NORMAL: return "NORMAL";
+        case EditorMode::INSERT: return "INSERT";
+        case EditorMode::COMMAND: return "COMMAND";
+        case EditorMode::VISUAL_CHAR: return "VISUAL CHAR";
+        case EditorMode::VISUAL_LINE: return "VISUAL LINE";
+        case EditorMode::VISUAL_BLOCK: return "VISUAL BLOCK";
+        default: return "UNKNOWN";
+    }
+}
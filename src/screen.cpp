@@ -0,0 +1,49 @@
+/**
+ * @file screen.cpp
+ * @brief 绘制目标共用的颜色对定义
+ */
+#include "../include/screen.h"
+#include <cstddef>
+
+struct PairColors {
+    short foreground;
+    short background;
+};
+
+// 从颜色对 1 开始依次排列
+static const PairColors kPairColors[] = {
+    { Screen::kWhite, Screen::kBlack },     // 普通模式
+    { Screen::kGreen, Screen::kBlack },     // 插入模式
+    { Screen::kRed, Screen::kBlack },       // 命令模式
+    { Screen::kYellow, Screen::kBlack },    // 可视模式
+    { Screen::kBlack, Screen::kYellow },    // 查找匹配高亮
+    // 高亮关键字依次使用的颜色
+    { Screen::kBlack, Screen::kRed },
+    { Screen::kBlack, Screen::kGreen },
+    { Screen::kBlack, Screen::kBlue },
+    { Screen::kBlack, Screen::kMagenta },
+    { Screen::kBlack, Screen::kCyan },
+    { Screen::kBlack, Screen::kWhite },
+    // 语法高亮只改前景色，按 SyntaxKind 的顺序排列
+    { Screen::kWhite, Screen::kBlack },     // NORMAL
+    { Screen::kYellow, Screen::kBlack },    // KEYWORD
+    { Screen::kGreen, Screen::kBlack },     // TYPE
+    { Screen::kRed, Screen::kBlack },       // STRING
+    { Screen::kMagenta, Screen::kBlack },   // NUMBER
+    { Screen::kBlue, Screen::kBlack },      // COMMENT
+    { Screen::kMagenta, Screen::kBlack },   // PREPROCESSOR
+    { Screen::kCyan, Screen::kBlack },      // KEY
+    { Screen::kRed, Screen::kBlack },       // ERROR
+    { Screen::kYellow, Screen::kBlack },    // WARNING
+    { Screen::kGreen, Screen::kBlack },     // INFO
+};
+
+bool Screen::pairColors(short pair, short& foreground, short& background) {
+    size_t index = static_cast<size_t>(pair) - 1;
+    if (pair <= 0 || index >= sizeof(kPairColors) / sizeof(kPairColors[0])) {
+        return false;
+    }
+    foreground = kPairColors[index].foreground;
+    background = kPairColors[index].background;
+    return true;
+}
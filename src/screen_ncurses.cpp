@@ -0,0 +1,101 @@
+/**
+ * @file screen_ncurses.cpp
+ * @brief 基于 ncurses 的终端绘制目标实现
+ */
+#include "../include/screen_ncurses.h"
+#include <cstdio>
+
+NCursesScreen::NCursesScreen() : m_open(true) {
+    // 初始化 ncurses
+    initscr();
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+    // 先刷新一次 stdscr：否则第一次 getch() 刷新空白的 stdscr 时会清掉已绘制的窗口
+    refresh();
+
+    // 开启括号粘贴：终端把粘贴的内容包在 ESC[200~ 和 ESC[201~ 之间
+    define_key("\033[200~", kKeyPasteBegin);
+    define_key("\033[201~", kKeyPasteEnd);
+    std::fputs("\033[?2004h", stdout);
+    std::fflush(stdout);
+
+    // 启用颜色
+    start_color();
+    short foreground = 0;
+    short background = 0;
+    for (short pair = 1; pairColors(pair, foreground, background); ++pair) {
+        init_pair(pair, foreground, background);
+    }
+
+    // 创建窗口
+    int height = LINES - 1;
+    int width = COLS;
+    m_mainWin = newwin(height, width, 0, 0);
+    m_statusWin = newwin(1, width, height, 0);
+}
+
+NCursesScreen::~NCursesScreen() {
+    close();
+}
+
+void NCursesScreen::close() {
+    if (!m_open) {
+        return;
+    }
+    m_open = false;
+    std::fputs("\033[?2004l", stdout);
+    std::fflush(stdout);
+    endwin();
+}
+
+void NCursesScreen::resize() {
+    int height = LINES - 1;
+    int width = COLS;
+    wresize(m_mainWin, height, width);
+    wresize(m_statusWin, 1, width);
+    mvwin(m_statusWin, height, 0);
+    werase(m_mainWin);
+    werase(m_statusWin);
+    wnoutrefresh(m_statusWin);
+}
+
+int NCursesScreen::rows() const {
+    return getmaxy(m_mainWin);
+}
+
+int NCursesScreen::columns() const {
+    return getmaxx(m_mainWin);
+}
+
+void NCursesScreen::clear() {
+    werase(m_mainWin);
+}
+
+void NCursesScreen::drawRow(int row, const std::string& text) {
+    wmove(m_mainWin, row, 0);
+    wclrtoeol(m_mainWin);
+    waddnstr(m_mainWin, text.data(), static_cast<int>(text.size()));
+}
+
+void NCursesScreen::setStyle(int row, int column, int count, bool reverse, short pair) {
+    mvwchgat(m_mainWin, row, column, count, reverse ? A_REVERSE : A_NORMAL, pair, NULL);
+}
+
+void NCursesScreen::drawStatus(const std::string& text, short pair) {
+    werase(m_statusWin);
+    wattron(m_statusWin, COLOR_PAIR(pair));
+    mvwprintw(m_statusWin, 0, 0, "%s", text.c_str());
+    wattroff(m_statusWin, COLOR_PAIR(pair));
+    wnoutrefresh(m_statusWin);
+}
+
+void NCursesScreen::setCursor(int row, int column) {
+    wmove(m_mainWin, row, column);
+}
+
+// 所有窗口先 wnoutrefresh，最后一次 doupdate 输出
+void NCursesScreen::present() {
+    wnoutrefresh(m_mainWin);
+    doupdate();
+}
@@ -0,0 +1,370 @@
+/**
+ * @file syntax.cpp
+ * @brief 语法高亮实现
+ */
+#include "../include/syntax.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+static const SyntaxWord kCppWords[] = {
+    { "alignas", SyntaxKind::KEYWORD }, { "alignof", SyntaxKind::KEYWORD },
+    { "break", SyntaxKind::KEYWORD }, { "case", SyntaxKind::KEYWORD },
+    { "catch", SyntaxKind::KEYWORD }, { "class", SyntaxKind::KEYWORD },
+    { "const", SyntaxKind::KEYWORD }, { "constexpr", SyntaxKind::KEYWORD },
+    { "const_cast", SyntaxKind::KEYWORD }, { "continue", SyntaxKind::KEYWORD },
+    { "decltype", SyntaxKind::KEYWORD }, { "default", SyntaxKind::KEYWORD },
+    { "delete", SyntaxKind::KEYWORD }, { "do", SyntaxKind::KEYWORD },
+    { "dynamic_cast", SyntaxKind::KEYWORD }, { "else", SyntaxKind::KEYWORD },
+    { "enum", SyntaxKind::KEYWORD }, { "explicit", SyntaxKind::KEYWORD },
+    { "extern", SyntaxKind::KEYWORD }, { "false", SyntaxKind::KEYWORD },
+    { "for", SyntaxKind::KEYWORD }, { "friend", SyntaxKind::KEYWORD },
+    { "goto", SyntaxKind::KEYWORD }, { "if", SyntaxKind::KEYWORD },
+    { "inline", SyntaxKind::KEYWORD }, { "mutable", SyntaxKind::KEYWORD },
+    { "namespace", SyntaxKind::KEYWORD }, { "new", SyntaxKind::KEYWORD },
+    { "noexcept", SyntaxKind::KEYWORD }, { "nullptr", SyntaxKind::KEYWORD },
+    { "operator", SyntaxKind::KEYWORD }, { "override", SyntaxKind::KEYWORD },
+    { "private", SyntaxKind::KEYWORD }, { "protected", SyntaxKind::KEYWORD },
+    { "public", SyntaxKind::KEYWORD }, { "reinterpret_cast", SyntaxKind::KEYWORD },
+    { "return", SyntaxKind::KEYWORD }, { "sizeof", SyntaxKind::KEYWORD },
+    { "static", SyntaxKind::KEYWORD }, { "static_assert", SyntaxKind::KEYWORD },
+    { "static_cast", SyntaxKind::KEYWORD }, { "struct", SyntaxKind::KEYWORD },
+    { "switch", SyntaxKind::KEYWORD }, { "template", SyntaxKind::KEYWORD },
+    { "this", SyntaxKind::KEYWORD }, { "throw", SyntaxKind::KEYWORD },
+    { "true", SyntaxKind::KEYWORD }, { "try", SyntaxKind::KEYWORD },
+    { "typedef", SyntaxKind::KEYWORD }, { "typename", SyntaxKind::KEYWORD },
+    { "union", SyntaxKind::KEYWORD }, { "using", SyntaxKind::KEYWORD },
+    { "virtual", SyntaxKind::KEYWORD }, { "volatile", SyntaxKind::KEYWORD },
+    { "while", SyntaxKind::KEYWORD }, { "NULL", SyntaxKind::KEYWORD },
+    { "auto", SyntaxKind::TYPE }, { "bool", SyntaxKind::TYPE }, { "char", SyntaxKind::TYPE },
+    { "double", SyntaxKind::TYPE }, { "float", SyntaxKind::TYPE }, { "int", SyntaxKind::TYPE },
+    { "long", SyntaxKind::TYPE }, { "short", SyntaxKind::TYPE }, { "signed", SyntaxKind::TYPE },
+    { "unsigned", SyntaxKind::TYPE }, { "void", SyntaxKind::TYPE }, { "wchar_t", SyntaxKind::TYPE },
+    { "size_t", SyntaxKind::TYPE }, { "int8_t", SyntaxKind::TYPE }, { "int16_t", SyntaxKind::TYPE },
+    { "int32_t", SyntaxKind::TYPE }, { "int64_t", SyntaxKind::TYPE }, { "uint8_t", SyntaxKind::TYPE },
+    { "uint16_t", SyntaxKind::TYPE }, { "uint32_t", SyntaxKind::TYPE }, { "uint64_t", SyntaxKind::TYPE },
+    { NULL, SyntaxKind::NORMAL }
+};
+
+static const SyntaxWord kJsonWords[] = {
+    { "true", SyntaxKind::KEYWORD }, { "false", SyntaxKind::KEYWORD }, { "null", SyntaxKind::KEYWORD },
+    { NULL, SyntaxKind::NORMAL }
+};
+
+static const SyntaxWord kYamlWords[] = {
+    { "true", SyntaxKind::KEYWORD }, { "false", SyntaxKind::KEYWORD }, { "null", SyntaxKind::KEYWORD },
+    { "yes", SyntaxKind::KEYWORD }, { "no", SyntaxKind::KEYWORD },
+    { "on", SyntaxKind::KEYWORD }, { "off", SyntaxKind::KEYWORD },
+    { NULL, SyntaxKind::NORMAL }
+};
+
+static const SyntaxWord kLogWords[] = {
+    { "FATAL", SyntaxKind::ERROR }, { "ERROR", SyntaxKind::ERROR }, { "CRITICAL", SyntaxKind::ERROR },
+    { "error", SyntaxKind::ERROR }, { "fatal", SyntaxKind::ERROR },
+    { "WARN", SyntaxKind::WARNING }, { "WARNING", SyntaxKind::WARNING }, { "warning", SyntaxKind::WARNING },
+    { "INFO", SyntaxKind::INFO }, { "DEBUG", SyntaxKind::INFO }, { "TRACE", SyntaxKind::INFO },
+    { NULL, SyntaxKind::NORMAL }
+};
+
+static const SyntaxLanguage kLanguages[] = {
+    { "cpp", ".c .h .cc .cpp .cxx .hh .hpp .hxx .inl", kCppWords, "//", "/*", "*/", "\"'", ".'",
+      true, SyntaxKeys::NONE },
+    { "json", ".json", kJsonWords, NULL, NULL, NULL, "\"", ".",
+      false, SyntaxKeys::QUOTED },
+    { "yaml", ".yaml .yml", kYamlWords, "#", NULL, NULL, "\"'", ".",
+      false, SyntaxKeys::PLAIN },
+    { "log", ".log", kLogWords, NULL, NULL, NULL, "\"", "-:.,",
+      false, SyntaxKeys::NONE },
+};
+
+static bool startsWith(const std::string& text, size_t pos, const char* prefix) {
+    size_t length = std::strlen(prefix);
+    return text.compare(pos, length, prefix) == 0;
+}
+
+static void addSpan(std::vector<SyntaxSpan>* spans, size_t begin, size_t end, SyntaxKind kind) {
+    if (spans && end > begin) {
+        SyntaxSpan span = { begin, end - begin, kind };
+        spans->push_back(span);
+    }
+}
+
+const size_t SyntaxHighlighter::kMaxColumns;
+
+SyntaxHighlighter::SyntaxHighlighter() :
+    m_language(NULL),
+    m_known(0),
+    m_firstStale(0),
+    m_lastEdit(0),
+    m_spansLine(0),
+    m_spansValid(false) {
+    std::memset(m_classOf, CHAR_OTHER, sizeof(m_classOf));
+}
+
+const SyntaxLanguage* SyntaxHighlighter::languageForFile(const std::string& filename) {
+    size_t dot = filename.rfind('.');
+    size_t slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return NULL;
+    }
+    std::string extension = filename.substr(dot);
+    for (size_t i = 0; i < extension.size(); ++i) {
+        extension[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(extension[i])));
+    }
+    for (size_t l = 0; l < sizeof(kLanguages) / sizeof(kLanguages[0]); ++l) {
+        // 扩展名表以空格分隔，逐个比较
+        const char* list = kLanguages[l].extensions;
+        while (*list) {
+            size_t length = std::strcspn(list, " ");
+            if (extension.compare(0, std::string::npos, list, length) == 0) {
+                return &kLanguages[l];
+            }
+            list += length;
+            list += std::strspn(list, " ");
+        }
+    }
+    return NULL;
+}
+
+const SyntaxLanguage* SyntaxHighlighter::languageByName(const std::string& name) {
+    for (size_t l = 0; l < sizeof(kLanguages) / sizeof(kLanguages[0]); ++l) {
+        if (name == kLanguages[l].name) {
+            return &kLanguages[l];
+        }
+    }
+    return NULL;
+}
+
+void SyntaxHighlighter::setLanguage(const SyntaxLanguage* language) {
+    m_language = language;
+    m_words.clear();
+    std::memset(m_classOf, CHAR_OTHER, sizeof(m_classOf));
+    if (language) {
+        for (int c = 0; c < 256; ++c) {
+            if (std::isalpha(c) || c == '_') {
+                m_classOf[c] = CHAR_IDENT;
+            } else if (std::isdigit(c)) {
+                m_classOf[c] = CHAR_DIGIT;
+            }
+        }
+        for (const char* quote = language->quotes; quote && *quote; ++quote) {
+            m_classOf[static_cast<unsigned char>(*quote)] = CHAR_QUOTE;
+        }
+        for (const SyntaxWord* word = language->words; word && word->word; ++word) {
+            m_words[word->word] = word->kind;
+        }
+    }
+    reset();
+}
+
+const SyntaxLanguage* SyntaxHighlighter::language() const {
+    return m_language;
+}
+
+void SyntaxHighlighter::reset() {
+    m_states.clear();
+    m_known = 0;
+    m_firstStale = 0;
+    m_lastEdit = 0;
+    m_spansValid = false;
+}
+
+void SyntaxHighlighter::applyEdit(size_t line, size_t removedLines, size_t insertedLines) {
+    m_spansValid = false;
+    if (!m_language || line >= m_known) {
+        return;
+    }
+    bool pending = m_firstStale < m_known;
+    if (line + removedLines >= m_known) {
+        // 编辑延伸到还没算过的部分，之后的缓存不再可用
+        m_known = line;
+        m_states.resize(line);
+    } else {
+        // 原来第 line + removedLines 行的结尾现在是第 line + insertedLines 行的结尾，
+        // 保留它的旧状态，重新分析到这里时与之比较
+        m_states.erase(m_states.begin() + line, m_states.begin() + line + removedLines);
+        m_states.insert(m_states.begin() + line, insertedLines, STATE_NORMAL);
+        m_known = m_known + insertedLines - removedLines;
+    }
+    // 之前还有没补算完的行时，要一直算过原来的失效区间，才能断定其后的缓存有效
+    size_t lastEdit = line + insertedLines;
+    size_t pendingEnd = std::max(m_lastEdit, m_firstStale);
+    if (pending && pendingEnd > line + removedLines) {
+        lastEdit = std::max(lastEdit, pendingEnd + insertedLines - removedLines);
+    }
+    m_lastEdit = lastEdit;
+    m_firstStale = std::min(m_firstStale, line);
+}
+
+void SyntaxHighlighter::invalidateLine(size_t line) {
+    applyEdit(line, 0, 0);
+}
+
+bool SyntaxHighlighter::endStateChanged(size_t line, const LineSource& source) {
+    // 还没算到的行不在视口之上，绘制时自然会算
+    if (!m_language || line >= m_known) {
+        return false;
+    }
+    // 顺便留下词法单元，随后绘制这一行时直接使用
+    unsigned char state = startState(line, source);
+    m_lineSpans.clear();
+    unsigned char end = lex(source(line, kMaxColumns), state, &m_lineSpans);
+    m_spansLine = line;
+    m_spansValid = true;
+    return end != m_states[line];
+}
+
+void SyntaxHighlighter::highlight(size_t line, const LineSource& source, std::vector<SyntaxSpan>& spans) {
+    spans.clear();
+    if (!m_language) {
+        return;
+    }
+    if (!m_spansValid || m_spansLine != line) {
+        unsigned char state = startState(line, source);
+        m_lineSpans.clear();
+        lex(source(line, kMaxColumns), state, &m_lineSpans);
+        m_spansLine = line;
+        m_spansValid = true;
+    }
+    spans = m_lineSpans;
+}
+
+unsigned char SyntaxHighlighter::startState(size_t line, const LineSource& source) {
+    if (line == 0) {
+        return STATE_NORMAL;
+    }
+    // 从第一个可能失效的行开始补算到 line 的上一行
+    while (m_firstStale < line) {
+        size_t k = m_firstStale;
+        unsigned char state = lex(source(k, kMaxColumns), k > 0 ? m_states[k - 1] : static_cast<unsigned char>(STATE_NORMAL), NULL);
+        if (k < m_known) {
+            bool same = m_states[k] == state;
+            m_states[k] = state;
+            if (same && k >= m_lastEdit) {
+                // 编辑过的行都已重新分析，且状态与缓存一致：其后的缓存仍然有效
+                m_firstStale = m_known;
+                continue;
+            }
+        } else {
+            m_states.push_back(state);
+            m_known = k + 1;
+        }
+        m_firstStale = k + 1;
+    }
+    return m_states[line - 1];
+}
+
+// YAML 行首的 key:（可在 - 之后），返回键之后的位置；不是键时返回 0
+size_t SyntaxHighlighter::lexPlainKey(const std::string& text, std::vector<SyntaxSpan>* spans) const {
+    size_t begin = text.find_first_not_of(' ');
+    if (begin == std::string::npos) {
+        return 0;
+    }
+    if (text[begin] == '-' && (begin + 1 == text.size() || text[begin + 1] == ' ')) {
+        begin = text.find_first_not_of(' ', begin + 1);
+        if (begin == std::string::npos) {
+            return 0;
+        }
+    }
+    if (m_classOf[static_cast<unsigned char>(text[begin])] == CHAR_QUOTE || text[begin] == '#') {
+        return 0;
+    }
+    for (size_t end = begin; end < text.size(); ++end) {
+        if (text[end] == '#') {
+            return 0;
+        }
+        if (text[end] == ':' && (end + 1 == text.size() || text[end + 1] == ' ')) {
+            addSpan(spans, begin, end, SyntaxKind::KEY);
+            return end;
+        }
+    }
+    return 0;
+}
+
+unsigned char SyntaxHighlighter::lex(const std::string& text, unsigned char state,
+                                     std::vector<SyntaxSpan>* spans) const {
+    const SyntaxLanguage& language = *m_language;
+    const size_t length = text.size();
+    size_t i = 0;
+    if (state == STATE_BLOCK_COMMENT) {
+        size_t close = text.find(language.blockClose);
+        if (close == std::string::npos) {
+            addSpan(spans, 0, length, SyntaxKind::COMMENT);
+            return STATE_BLOCK_COMMENT;
+        }
+        i = close + std::strlen(language.blockClose);
+        addSpan(spans, 0, i, SyntaxKind::COMMENT);
+    } else if (language.preprocessor) {
+        size_t first = text.find_first_not_of(" \t");
+        if (first != std::string::npos && text[first] == '#') {
+            addSpan(spans, first, length, SyntaxKind::PREPROCESSOR);
+            return STATE_NORMAL;
+        }
+    }
+    if (language.keys == SyntaxKeys::PLAIN && i == 0) {
+        i = lexPlainKey(text, spans);
+    }
+
+    while (i < length) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (language.lineComment && startsWith(text, i, language.lineComment) &&
+            (language.lineComment[0] != '#' || i == 0 || std::isspace(static_cast<unsigned char>(text[i - 1])))) {
+            // # 注释须在行首或空白之后，如 YAML 的 a#b 不是注释
+            addSpan(spans, i, length, SyntaxKind::COMMENT);
+            break;
+        }
+        if (language.blockOpen && startsWith(text, i, language.blockOpen)) {
+            size_t close = text.find(language.blockClose, i + std::strlen(language.blockOpen));
+            if (close == std::string::npos) {
+                addSpan(spans, i, length, SyntaxKind::COMMENT);
+                return STATE_BLOCK_COMMENT;
+            }
+            size_t end = close + std::strlen(language.blockClose);
+            addSpan(spans, i, end, SyntaxKind::COMMENT);
+            i = end;
+            continue;
+        }
+        size_t j = i + 1;
+        switch (m_classOf[c]) {
+            case CHAR_QUOTE: {
+                // 字符串到配对的引号为止，反斜杠转义下一个字符；没有配对时到行尾
+                while (j < length && text[j] != text[i]) {
+                    j += text[j] == '\\' ? 2 : 1;
+                }
+                j = std::min(j + 1, length);
+                SyntaxKind kind = SyntaxKind::STRING;
+                if (language.keys == SyntaxKeys::QUOTED) {
+                    size_t next = text.find_first_not_of(" \t", j);
+                    if (next != std::string::npos && text[next] == ':') {
+                        kind = SyntaxKind::KEY;
+                    }
+                }
+                addSpan(spans, i, j, kind);
+                break;
+            }
+            case CHAR_DIGIT:
+                while (j < length && (std::isalnum(static_cast<unsigned char>(text[j])) ||
+                                      std::strchr(language.numberChars, text[j]) != NULL)) {
+                    ++j;
+                }
+                addSpan(spans, i, j, SyntaxKind::NUMBER);
+                break;
+            case CHAR_IDENT: {
+                while (j < length && m_classOf[static_cast<unsigned char>(text[j])] >= CHAR_IDENT &&
+                       m_classOf[static_cast<unsigned char>(text[j])] <= CHAR_DIGIT) {
+                    ++j;
+                }
+                std::unordered_map<std::string, SyntaxKind>::const_iterator word =
+                    m_words.find(text.substr(i, j - i));
+                if (word != m_words.end()) {
+                    addSpan(spans, i, j, word->second);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        i = j;
+    }
+    return STATE_NORMAL;
+}
@@ -0,0 +1,458 @@
+/**
+ * @file text_layout.cpp
+ * @brief 文本排版实现
+ */
+#include "../include/text_layout.h"
+#include "../include/line_scanner.h"
+#include <algorithm>
+#include <utility>
+
+struct CodePointRange {
+    unsigned long first;
+    unsigned long last;
+};
+
+// 不占列的码点：组合符号、零宽字符、变体选择符、肤色修饰符等
+static const CodePointRange kZeroWidth[] = {
+    { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x05BF, 0x05BF },
+    { 0x05C1, 0x05C2 }, { 0x05C4, 0x05C5 }, { 0x05C7, 0x05C7 }, { 0x0610, 0x061A },
+    { 0x064B, 0x065F }, { 0x0670, 0x0670 }, { 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 },
+    { 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED }, { 0x0711, 0x0711 }, { 0x0730, 0x074A },
+    { 0x07A6, 0x07B0 }, { 0x0900, 0x0902 }, { 0x093A, 0x093A }, { 0x093C, 0x093C },
+    { 0x0941, 0x0948 }, { 0x094D, 0x094D }, { 0x0951, 0x0957 }, { 0x0962, 0x0963 },
+    { 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E }, { 0x1160, 0x11FF },
+    { 0x1AB0, 0x1AFF }, { 0x1DC0, 0x1DFF }, { 0x200B, 0x200F }, { 0x202A, 0x202E },
+    { 0x2060, 0x2064 }, { 0x20D0, 0x20FF }, { 0x302A, 0x302D }, { 0x3099, 0x309A },
+    { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF }, { 0x1F3FB, 0x1F3FF },
+    { 0xE0001, 0xE0001 }, { 0xE0020, 0xE007F }, { 0xE0100, 0xE01EF }
+};
+
+// 占两列的码点：东亚宽字符、全角字符和大部分 emoji
+static const CodePointRange kWide[] = {
+    { 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC },
+    { 0x23F0, 0x23F0 }, { 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 },
+    { 0x2648, 0x2653 }, { 0x267F, 0x267F }, { 0x2693, 0x2693 }, { 0x26A1, 0x26A1 },
+    { 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 }, { 0x26CE, 0x26CE },
+    { 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 },
+    { 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B },
+    { 0x2728, 0x2728 }, { 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 },
+    { 0x2757, 0x2757 }, { 0x2795, 0x2797 }, { 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF },
+    { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 }, { 0x2E80, 0x303E },
+    { 0x3041, 0x33FF }, { 0x3400, 0x4DBF }, { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF },
+    { 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF }, { 0xFE10, 0xFE19 },
+    { 0xFE30, 0xFE6F }, { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 }, { 0x16FE0, 0x16FE4 },
+    { 0x17000, 0x18AFF }, { 0x1B000, 0x1B16F }, { 0x1F004, 0x1F004 }, { 0x1F0CF, 0x1F0CF },
+    { 0x1F18E, 0x1F18E }, { 0x1F191, 0x1F19A }, { 0x1F1E6, 0x1F1FF }, { 0x1F200, 0x1F202 },
+    { 0x1F210, 0x1F23B }, { 0x1F240, 0x1F248 }, { 0x1F250, 0x1F251 }, { 0x1F300, 0x1F64F },
+    { 0x1F680, 0x1F6FF }, { 0x1F7E0, 0x1F7EB }, { 0x1F90C, 0x1F9FF }, { 0x1FA70, 0x1FAFF },
+    { 0x20000, 0x2FFFD }, { 0x30000, 0x3FFFD }
+};
+
+static const unsigned long kZeroWidthJoiner = 0x200D;
+static const unsigned long kRegionalFirst = 0x1F1E6;
+static const unsigned long kRegionalLast = 0x1F1FF;
+
+template <size_t N>
+static bool inRanges(const CodePointRange (&ranges)[N], unsigned long codePoint) {
+    size_t low = 0;
+    size_t high = N;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (ranges[middle].last < codePoint) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < N && ranges[low].first <= codePoint;
+}
+
+int codePointWidth(unsigned long codePoint) {
+    if (codePoint < 0x0300) {
+        return 1;
+    }
+    if (codePoint == kZeroWidthJoiner || inRanges(kZeroWidth, codePoint)) {
+        return 0;
+    }
+    return inRanges(kWide, codePoint) ? 2 : 1;
+}
+
+// 解码一个 UTF-8 字符，返回其字节数；不是合法的 UTF-8（含超长编码和代理区）时返回 0
+static size_t decodeUtf8(const char* data, size_t length, unsigned long& codePoint) {
+    unsigned char lead = static_cast<unsigned char>(data[0]);
+    size_t size;
+    unsigned long minimum;
+    if (lead < 0x80) {
+        codePoint = lead;
+        return 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        size = 2;
+        minimum = 0x80;
+        codePoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        size = 3;
+        minimum = 0x800;
+        codePoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        size = 4;
+        minimum = 0x10000;
+        codePoint = lead & 0x07;
+    } else {
+        return 0;
+    }
+    if (size > length) {
+        return 0;
+    }
+    for (size_t i = 1; i < size; ++i) {
+        unsigned char byte = static_cast<unsigned char>(data[i]);
+        if ((byte & 0xC0) != 0x80) {
+            return 0;
+        }
+        codePoint = (codePoint << 6) | (byte & 0x3F);
+    }
+    if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+        return 0;
+    }
+    return size;
+}
+
+const size_t LineLayout::kResyncBytes;
+
+// 排版到某个码点之前的状态
+struct LineLayout::State {
+    size_t column;      // 下一个字素簇的起始列
+    bool joinNext;      // 上一个码点是零宽连接符
+    bool regionalOpen;  // 上一个码点是还没配对的区域指示符
+    bool started;       // 之前已经有字素簇
+    bool open;          // current 还可能附着后面的码点
+    bool simple;        // current 只是一个可打印 ASCII 字符
+    Cluster current;
+};
+
+LineLayout::LineLayout() : m_length(0), m_width(0) {}
+
+void LineLayout::closeCluster(State& state, std::vector<Cluster>& clusters) {
+    if (state.open && !state.simple) {
+        clusters.push_back(state.current);
+    }
+    state.open = false;
+}
+
+// 排版 data 开头的一个码点，它结束了前一个不规则的字素簇时把那个字素簇追加到 clusters；
+// position 为它在行内的偏移。返回码点的字节数
+size_t LineLayout::layoutCodePoint(const char* data, size_t available, size_t position, size_t lineLength,
+                                   State& state, std::vector<Cluster>& clusters) {
+    unsigned long codePoint = 0;
+    size_t size = decodeUtf8(data, available, codePoint);
+    bool valid = size > 0;
+    int width = 1;
+    bool attach = false;
+    bool regional = false;
+    if (!valid) {
+        size = 1;
+    } else if (codePoint == '\t') {
+        width = static_cast<int>(kTabStop - state.column % kTabStop);
+    } else if (codePoint == '\r' && position + 1 == lineLength) {
+        width = 0;  // CRLF 文件的行尾，不显示
+    } else if (codePoint < 0x20 || codePoint == 0x7F) {
+        width = 2;  // ^X
+    } else if (codePoint >= 0x80) {
+        width = codePointWidth(codePoint);
+        attach = width == 0 || state.joinNext;
+        if (codePoint >= kRegionalFirst && codePoint <= kRegionalLast) {
+            // 两个区域指示符组成一面旗帜
+            attach = attach || state.regionalOpen;
+            regional = !attach;
+        }
+    } else {
+        attach = state.joinNext;
+    }
+    state.joinNext = size > 1 && codePoint == kZeroWidthJoiner;
+    state.regionalOpen = regional;
+    if (attach && state.started) {
+        state.current.end = position + size;
+        state.simple = false;
+        return size;
+    }
+    closeCluster(state, clusters);
+    state.current.start = position;
+    state.current.column = state.column;
+    // 行首单独的组合符号占一列
+    state.column += static_cast<size_t>(width == 0 && codePoint != '\r' ? 1 : width);
+    state.current.end = position + size;
+    state.current.endColumn = state.column;
+    state.current.tab = valid && codePoint == '\t';
+    state.simple = valid && codePoint >= 0x20 && codePoint < 0x7F;
+    state.open = true;
+    state.started = true;
+    return size;
+}
+
+void LineLayout::build(const char* data, size_t length) {
+    m_length = length;
+    m_clusters.clear();
+    State state = { 0, false, false, false, false, false, Cluster() };
+    size_t i = 0;
+    while (i < length) {
+        // 连续的可打印 ASCII 字符各自成簇，用 SIMD 扫描跳过；
+        // 最后一个后面可能跟着组合符号，照常处理
+        size_t run = state.joinNext ? 0 : skipPrintableAscii(data + i, length - i);
+        if (run > 1) {
+            closeCluster(state, m_clusters);
+            state.column += run - 1;
+            state.regionalOpen = false;
+            state.started = true;
+            i += run - 1;
+        }
+        i += layoutCodePoint(data + i, length - i, i, length, state, m_clusters);
+    }
+    closeCluster(state, m_clusters);
+    m_width = state.column;
+}
+
+bool LineLayout::applyEdit(size_t column, size_t removed, size_t inserted, const SegmentSource& source) {
+    if (column + removed > m_length) {
+        return false;
+    }
+    size_t newLength = m_length - removed + inserted;
+    // 从编辑处之前的字素簇开始重新排版：插入的组合符号附着在前一个字素簇上，
+    // 之前至多 3 个字节处不完整的 UTF-8 字符也可能与插入的字节连成一个附着在更前面的字符，
+    // 所以再退一个字素簇。直到编辑之后的某处又是原来的字素簇起点且状态相同，
+    // 其后的字素簇不变，整体平移即可（只有第一个制表符的宽度可能变化）
+    size_t restart = clusterStart(column > 3 ? column - 3 : 0);
+    restart = restart > 0 ? clusterStart(restart - 1) : 0;
+    size_t editEnd = column + inserted;
+    // 连同之前的一个码点一起取出：制表符等不论前面是什么都开始新的字素簇，
+    // 重新排版的起点之前是否刚有零宽连接符或没配对的区域指示符要从这里判断
+    size_t from = restart >= 4 ? restart - 4 : 0;
+    std::string text = source(from, editEnd - from + kResyncBytes);
+    size_t i = restart - from;
+    if (i > text.size()) {
+        return false;
+    }
+    bool complete = from + text.size() == newLength;
+    // 不到行尾时，末尾可能截断了一个多字节字符，留出余量
+    size_t limit = complete ? text.size() : text.size() - std::min<size_t>(text.size(), 4);
+
+    State state = { columnOf(restart), false, false, restart > 0, false, false, Cluster() };
+    unsigned long previous = 0;
+    if (i >= 3 && decodeUtf8(text.data() + i - 3, 3, previous) == 3) {
+        state.joinNext = previous == kZeroWidthJoiner;
+    } else if (i >= 4 && decodeUtf8(text.data() + i - 4, 4, previous) == 4 &&
+               previous >= kRegionalFirst && previous <= kRegionalLast) {
+        // 自成字素簇的区域指示符还在等待配对
+        state.regionalOpen = clusterStart(restart - 4) == restart - 4;
+    }
+    std::vector<Cluster> clusters;
+    size_t oldPosition = 0;
+    while (true) {
+        size_t position = from + i;
+        if (position >= editEnd && (position > restart || position == newLength)) {
+            oldPosition = position - inserted + removed;
+            // 原来的行首按没有前一个字素簇排版过，不能在那里对齐
+            bool boundary = oldPosition > 0 && clusterStart(oldPosition) == oldPosition && !state.joinNext &&
+                            !state.regionalOpen;
+            if (position == newLength || boundary) {
+                break;
+            }
+        }
+        if (i >= limit) {
+            return false;
+        }
+        i += layoutCodePoint(text.data() + i, text.size() - i, position, newLength, state, clusters);
+    }
+    closeCluster(state, clusters);
+
+    // 换下起点在 [restart, oldPosition) 中的字素簇，其后的平移
+    size_t first = static_cast<size_t>(std::lower_bound(m_clusters.begin(), m_clusters.end(), restart, startsBefore) -
+                                m_clusters.begin());
+    size_t last = static_cast<size_t>(std::lower_bound(m_clusters.begin(), m_clusters.end(), oldPosition,
+                                                       startsBefore) - m_clusters.begin());
+    size_t oldColumn = columnOf(oldPosition);
+    size_t newPosition = from + i;
+    // 列的平移量不是制表位的整数倍时，其后第一个制表符的宽度随之变化，
+    // 它结束于制表位，再往后的平移量就是制表位的整数倍了
+    size_t columnShift = state.column - oldColumn;
+    for (size_t k = last; k < m_clusters.size(); ++k) {
+        Cluster& cluster = m_clusters[k];
+        cluster.start = cluster.start - oldPosition + newPosition;
+        cluster.end = cluster.end - oldPosition + newPosition;
+        cluster.column += columnShift;
+        if (cluster.tab && columnShift % kTabStop != 0) {
+            size_t endColumn = cluster.column + kTabStop - cluster.column % kTabStop;
+            columnShift = endColumn - cluster.endColumn;
+            cluster.endColumn = endColumn;
+        } else {
+            cluster.endColumn += columnShift;
+        }
+    }
+    m_clusters.erase(m_clusters.begin() + first, m_clusters.begin() + last);
+    m_clusters.insert(m_clusters.begin() + first, clusters.begin(), clusters.end());
+    m_width += columnShift;
+    m_length = newLength;
+    return true;
+}
+
+bool LineLayout::startsBefore(const Cluster& cluster, size_t byte) {
+    return cluster.start < byte;
+}
+
+size_t LineLayout::length() const {
+    return m_length;
+}
+
+size_t LineLayout::width() const {
+    return m_width;
+}
+
+size_t LineLayout::clusterIndex(size_t byte) const {
+    return static_cast<size_t>(std::upper_bound(m_clusters.begin(), m_clusters.end(), byte,
+                                                [](size_t value, const Cluster& cluster) {
+                                                    return value < cluster.start;
+                                                }) - m_clusters.begin());
+}
+
+size_t LineLayout::clusterStart(size_t byte) const {
+    if (byte >= m_length) {
+        return m_length;
+    }
+    size_t k = clusterIndex(byte);
+    return k > 0 && byte < m_clusters[k - 1].end ? m_clusters[k - 1].start : byte;
+}
+
+size_t LineLayout::nextCluster(size_t byte) const {
+    if (byte >= m_length) {
+        return m_length;
+    }
+    size_t k = clusterIndex(byte);
+    return k > 0 && byte < m_clusters[k - 1].end ? m_clusters[k - 1].end : byte + 1;
+}
+
+size_t LineLayout::previousCluster(size_t byte) const {
+    size_t start = clusterStart(byte);
+    return start == 0 ? 0 : clusterStart(start - 1);
+}
+
+size_t LineLayout::columnOf(size_t byte) const {
+    if (byte >= m_length) {
+        return m_width;
+    }
+    size_t k = clusterIndex(byte);
+    if (k == 0) {
+        return byte;
+    }
+    const Cluster& cluster = m_clusters[k - 1];
+    return byte < cluster.end ? cluster.column : cluster.endColumn + (byte - cluster.end);
+}
+
+size_t LineLayout::byteAt(size_t column) const {
+    if (column >= m_width) {
+        return m_length;
+    }
+    size_t k = static_cast<size_t>(std::upper_bound(m_clusters.begin(), m_clusters.end(), column,
+                                                    [](size_t value, const Cluster& cluster) {
+                                                        return value < cluster.column;
+                                                    }) - m_clusters.begin());
+    if (k == 0) {
+        return column;
+    }
+    const Cluster& cluster = m_clusters[k - 1];
+    return column < cluster.endColumn ? cluster.start : cluster.end + (column - cluster.endColumn);
+}
+
+void LineLayout::render(const std::string& segment, size_t segmentStart, size_t leftColumn, size_t columns,
+                        std::string& out) const {
+    out.clear();
+    size_t right = leftColumn + columns;
+    size_t byte = byteAt(leftColumn);
+    size_t column = columnOf(byte);
+    // 下一个不规则字素簇
+    size_t next = static_cast<size_t>(std::lower_bound(m_clusters.begin(), m_clusters.end(), byte, startsBefore) -
+                                      m_clusters.begin());
+    while (byte < m_length && column < right) {
+        size_t runEnd = next < m_clusters.size() ? m_clusters[next].start : m_length;
+        if (byte < runEnd) {
+            // 不规则字素簇之间的可打印 ASCII 整段复制
+            size_t end = std::min(runEnd, byte + (right - column));
+            out.append(segment, byte - segmentStart, end - byte);
+            column += end - byte;
+            byte = end;
+            continue;
+        }
+        const Cluster& cluster = m_clusters[next++];
+        const char* data = segment.data() + (byte - segmentStart);
+        size_t size = cluster.end - byte;
+        unsigned long codePoint = 0;
+        size_t decoded = decodeUtf8(data, size, codePoint);
+        if (cluster.endColumn == column) {
+            // 行尾的 \r 不显示
+        } else if (column < leftColumn || cluster.endColumn > right || codePoint == '\t') {
+            // 被视口边缘截断的宽字符和制表符都画成空格
+            out.append(std::min(cluster.endColumn, right) - std::max(column, leftColumn), ' ');
+        } else if (decoded == 0 || (codePoint >= 0x80 && codePoint < 0xA0)) {
+            out += '?';
+        } else if (codePoint < 0x20 || codePoint == 0x7F) {
+            out += '^';
+            out += static_cast<char>(codePoint ^ 0x40);
+        } else {
+            if (codePointWidth(codePoint) == 0) {
+                // 行首单独的组合符号附着在空格上
+                out += ' ';
+            }
+            out.append(data, size);
+        }
+        byte = cluster.end;
+        column = cluster.endColumn;
+    }
+}
+
+TextLayout::TextLayout() {}
+
+const LineLayout& TextLayout::line(size_t line, const LineSource& source) {
+    std::unordered_map<size_t, LineLayout>::iterator it = m_lines.find(line);
+    if (it != m_lines.end()) {
+        return it->second;
+    }
+    if (m_lines.size() >= kCacheLines) {
+        m_lines.clear();
+    }
+    std::string text = source(line);
+    LineLayout& layout = m_lines[line];
+    layout.build(text.data(), text.size());
+    return layout;
+}
+
+void TextLayout::clear() {
+    m_lines.clear();
+}
+
+void TextLayout::applyEdit(size_t line, size_t removedLines, size_t insertedLines) {
+    if (removedLines == insertedLines) {
+        for (size_t i = line; i <= line + removedLines; ++i) {
+            m_lines.erase(i);
+        }
+        return;
+    }
+    // 行数变化时其后各行的行号随之移动
+    std::unordered_map<size_t, LineLayout> moved;
+    for (std::unordered_map<size_t, LineLayout>::iterator it = m_lines.begin(); it != m_lines.end(); ++it) {
+        if (it->first < line) {
+            moved[it->first] = std::move(it->second);
+        } else if (it->first > line + removedLines) {
+            moved[it->first + insertedLines - removedLines] = std::move(it->second);
+        }
+    }
+    m_lines.swap(moved);
+}
+
+void TextLayout::invalidateLine(size_t line) {
+    m_lines.erase(line);
+}
+
+void TextLayout::editLine(size_t line, size_t column, size_t removed, size_t inserted,
+                          const LineLayout::SegmentSource& source) {
+    std::unordered_map<size_t, LineLayout>::iterator it = m_lines.find(line);
+    if (it != m_lines.end() && !it->second.applyEdit(column, removed, inserted, source)) {
+        m_lines.erase(it);
+    }
+}
@@ -0,0 +1,81 @@
+/**
+ * @file thread_pool.cpp
+ * @brief 固定大小的线程池实现
+ */
+#include "../include/thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads) : m_stopping(false) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_all();
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        m_workers[i].join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return m_workers.size();
+}
+
+void ThreadPool::enqueue(const std::function<void()>& job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(job);
+    }
+    m_wakeup.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping && m_jobs.empty()) {
+                return;
+            }
+            job = m_jobs.front();
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    size_t parts = std::min(count, size() + 1);
+    if (parts <= 1) {
+        body(0, count);
+        return;
+    }
+    // 第一段留给调用线程，其余提交给工作线程
+    size_t step = (count + parts - 1) / parts;
+    std::vector<std::future<void> > pending;
+    for (size_t begin = step; begin < count; begin += step) {
+        size_t end = std::min(count, begin + step);
+        pending.push_back(submit([&body, begin, end]() { body(begin, end); }));
+    }
+    body(0, std::min(count, step));
+    for (size_t i = 0; i < pending.size(); ++i) {
+        pending[i].get();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
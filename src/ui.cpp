@@ -3,12 +3,15 @@
  * @brief 用户界面处理实现
  * 
  * 大纲：
- * 1. 渲染编辑器界面
- * 2. 处理用户输入
+ * 1. 渲染编辑器界面：每帧与上一帧比较，一次写出变化的部分
+ * 2. 处理用户输入：启动时切换到原始模式，事件循环等待输入、SIGWINCH 和后台保存
  * 3. 状态栏和消息显示
  */
 #include "../include/ui.h"
 #include "../include/utils.h"
+#ifndef _WIN32
+#include "../include/editor_loop.h"
+#endif
 #include <iostream>
 #include <string>
 #include <vector>
@@ -17,44 +20,148 @@
 #include <windows.h>
 #include <conio.h>
 #else
+#include <sys/ioctl.h>
 #include <termios.h>
 #include <unistd.h>
 #endif
-// 跨平台的非阻塞输入实现
+#ifdef _WIN32
+static const int kTerminalOutput = 1;
+#else
+static const int kTerminalOutput = STDOUT_FILENO;
+#endif
+// 读取一个按键；终端已处于原始模式，不再每次切换
 int getChar() {
     #ifdef _WIN32
     return _getch();
     #else
-    struct termios oldt, newt;
-    int ch;
-    tcgetattr(STDIN_FILENO, &oldt);
-    newt = oldt;
-    newt.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-    ch = getchar();
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-    return ch;
+    unsigned char ch;
+    return ::read(STDIN_FILENO, &ch, 1) == 1 ? ch : EOF;
     #endif
 }
-UI::UI(Editor& editor) : m_editor(editor), m_statusMessage("") {}
-void UI::render() {
-    // 使用更高效的渲染方式，避免全屏清除导致闪烁
-    printUTF8("\x1b[2J");    // 清除整个屏幕
-    printUTF8("\x1b[H");     // 将光标移动到左上角
+// 终端的行数和列数，取不到时按 24x80
+static void terminalSize(int& rows, int& columns) {
+    rows = 24;
+    columns = 80;
+    #ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+        rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+        columns = info.srWindow.Right - info.srWindow.Left + 1;
+    }
+    #else
+    struct winsize size;
+    if (ioctl(kTerminalOutput, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+        rows = size.ws_row;
+        columns = size.ws_col;
+    }
+    #endif
+}
+static int terminalRows() {
+    int rows, columns;
+    terminalSize(rows, columns);
+    return rows;
+}
+static int terminalColumns() {
+    int rows, columns;
+    terminalSize(rows, columns);
+    return columns;
+}
+// 最后一行是状态栏
+UI::UI(Editor& editor) :
+    m_editor(editor),
+    m_statusMessage(""),
+    m_screen(kTerminalOutput, terminalRows() - 1, terminalColumns()),
+    m_renderer(editor, m_screen),
+    m_quit(false) {
+    #ifndef _WIN32
+    m_rawMode = false;
+    #endif
+    enableRawMode();
+}
+UI::~UI() {
+    restoreTerminal();
+}
+// 关闭行缓冲、回显和软件流控，回车不再转换为换行；保留 Ctrl-C 等信号键
+void UI::enableRawMode() {
+    #ifndef _WIN32
+    if (tcgetattr(STDIN_FILENO, &m_savedMode) != 0) {
+        return;
+    }
+    struct termios raw = m_savedMode;
+    raw.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+    raw.c_iflag &= ~(IXON | ICRNL);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    m_rawMode = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    #endif
+}
+void UI::restoreTerminal() {
+    m_screen.close();
+    #ifndef _WIN32
+    if (m_rawMode) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &m_savedMode);
+        m_rawMode = false;
+    }
+    #endif
+}
+#ifndef _WIN32
+// 事件循环：输入、终端尺寸变化、后台保存结束和载入进展都会唤醒它，每轮等待之前最多绘制一帧
+void UI::run() {
+    EventLoop loop;
+    EditorLoop session(loop, m_editor, m_statusMessage, [this]() { render(); });
 
-    // 渲染文件内容
-    const auto& lines = m_editor.getLines();
-    for (size_t i = 0; i < lines.size(); ++i) {
-        printUTF8(std::to_string(i + 1) + " | " + lines[i] + "\n");
+    loop.watch(STDIN_FILENO, [this, &loop, &session]() {
+        unsigned char buffer[256];
+        ssize_t length = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (length <= 0) {
+            // 终端已关闭：保留交换文件，未保存的修改可以恢复
+            m_editor.shutdown(false);
+            loop.quit();
+            return;
+        }
+        for (ssize_t i = 0; i < length && !m_quit; ++i) {
+            handleKey(buffer[i]);
+        }
+        session.markDirty();
+        if (m_quit) {
+            loop.quit();
+        }
+    });
+    loop.onResize([&session]() { session.markDirty(); });
+    loop.run();
+    restoreTerminal();
+}
+#else
+void UI::run() {
+    while (!m_quit) {
+        std::string saveMessage;
+        if (m_editor.pollSaveResult(saveMessage)) {
+            m_statusMessage = saveMessage;
+        }
+        m_editor.pollLoad();
+        render();
+        handleInput();
+    }
+    restoreTerminal();
+}
+#endif
+void UI::updateSize() {
+    int rows, columns;
+    terminalSize(rows, columns);
+    if (rows - 1 != m_screen.rows() || columns != m_screen.columns()) {
+        m_screen.resize(rows - 1, columns);
+        m_renderer.invalidate();
     }
-    
-    displayStatusBar();
-    
-    // 显示光标
-    printUTF8("\x1b[?25h");
+}
+void UI::render() {
+    // 只输出与上一帧不同的单元格，不再清屏重绘，避免闪烁
+    updateSize();
+    m_renderer.renderFrame(m_statusMessage);
 }
 void UI::handleInput() {
-    int ch = getChar();
+    handleKey(getChar());
+}
+void UI::handleKey(int ch) {
     switch (m_editor.getMode()) {
         case EditorMode::NORMAL:
         case EditorMode::VISUAL_CHAR:
@@ -125,8 +232,9 @@ void UI::handleInput() {
                     m_editor.setMode(EditorMode::NORMAL);
                     m_statusMessage = "";
                     break;
+                case 10:
                 case 13: // 回车键
-                    m_editor.insertText("");  // 插入空行
+                    m_editor.insertText("\n");
                     break;
                 case 127: // 退格键
                     if (m_editor.getCursorColumn() > 0) {
@@ -150,16 +258,20 @@ void UI::handleInput() {
                     m_editor.setMode(EditorMode::NORMAL);
                     m_statusMessage = "";
                     break;
+                case 10:
                 case 13: // 回车键
                     if (m_statusMessage.length() > 1 && m_statusMessage[0] == ':') {
                         std::string command = m_statusMessage.substr(1);
                         if (m_editor.executeCommand(command)) {
-                            if (command == "q" || command.find("wq") != std::string::npos) {
-                                exit(0);  // 退出程序
+                            if (command == "q" || command.compare(0, 2, "wq") == 0) {
+                                m_editor.shutdown();
+                                m_quit = true;  // 退出程序
                             }
                             m_statusMessage = "命令执行成功";
+                            m_editor.takeMessage(m_statusMessage);
                         } else {
                             m_statusMessage = "无效命令";
+                            m_editor.takeMessage(m_statusMessage);
                         }
                     }
                     break;
@@ -178,24 +290,6 @@ void UI::handleInput() {
             break;
     }
 }
-void UI::displayStatusBar() {
-    // 显示当前模式和状态信息
-    std::string modeStr;
-    switch (m_editor.getMode()) {
-        case EditorMode::NORMAL: modeStr = "普通模式"; break;
-        case EditorMode::INSERT: modeStr = "插入模式"; break;
-        case EditorMode::COMMAND: modeStr = "命令模式"; break;
-        case EditorMode::VISUAL_CHAR: modeStr = "可视字符模式"; break;
-        case EditorMode::VISUAL_LINE: modeStr = "可视行模式"; break;
-        case EditorMode::VISUAL_BLOCK: modeStr = "可视块模式"; break;
-    }
-    
-    std::string statusLine = "模式: " + modeStr + " | 文件: " + 
-        (m_editor.getCurrentFile().empty() ? "未命名" : m_editor.getCurrentFile()) + 
-        " | " + m_statusMessage;
-    
-    printUTF8(statusLine + "\n");
-}
 void UI::displayMessage(const std::string& message) {
     m_statusMessage = message;
 }
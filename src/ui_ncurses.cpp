@@ -1,99 +1,169 @@
 #include <ncurses.h>
 #include "../include/editor.h"
+#include "../include/editor_loop.h"
 #include "../include/ui_ncurses.h"
+#include "../include/utils.h"
 #include <string>
 #include <vector>
+#ifndef _WIN32
+#include <poll.h>
+#include <unistd.h>
+#endif
 
-NCursesUI::NCursesUI(Editor& editor) : m_editor(editor), m_statusMessage("") {
-    initScreen();
-}
-
-void NCursesUI::initScreen() {
-    // 初始化 ncurses
-    initscr();            
-    cbreak();             
-    noecho();             
-    keypad(stdscr, TRUE); 
-    
-    // 启用颜色
-    start_color();
-    init_pair(1, COLOR_WHITE, COLOR_BLACK);   // 普通模式
-    init_pair(2, COLOR_GREEN, COLOR_BLACK);   // 插入模式
-    init_pair(3, COLOR_RED, COLOR_BLACK);     // 命令模式
-    init_pair(4, COLOR_YELLOW, COLOR_BLACK);  // 可视模式
-
-    // 创建窗口
-    int height = LINES - 1;
-    int width = COLS;
-    m_mainWin = newwin(height, width, 0, 0);
-    m_statusWin = newwin(1, width, height, 0);
-}
-
-void NCursesUI::renderContent() {
-    wclear(m_mainWin);
-    
-    // 渲染文件内容
-    const auto& lines = m_editor.getLines();
-    for (size_t i = 0; i < lines.size(); ++i) {
-        mvwprintw(m_mainWin, i, 0, "%s", lines[i].c_str());
-    }
-    
-    // 高亮当前行
-    int currentLine = m_editor.getCursorLine();
-    mvwchgat(m_mainWin, currentLine, 0, -1, A_REVERSE, 0, NULL);
-    
-    wrefresh(m_mainWin);
-}
-
-void NCursesUI::renderStatusBar() {
-    wclear(m_statusWin);
-    
-    std::string modeStr = getModeString();
-    std::string statusLine = "Mode: " + modeStr + " | File: " + 
-        (m_editor.getCurrentFile().empty() ? "Untitled" : m_editor.getCurrentFile()) +
-        " | " + m_statusMessage;
-    
-    // 根据模式设置颜色
-    int colorPair = 1;
-    switch(m_editor.getMode()) {
-        case EditorMode::INSERT: colorPair = 2; break;
-        case EditorMode::COMMAND: colorPair = 3; break;
-        case EditorMode::VISUAL_CHAR:
-        case EditorMode::VISUAL_LINE:
-        case EditorMode::VISUAL_BLOCK:
-            colorPair = 4; break;
-    }
-    
-    wattron(m_statusWin, COLOR_PAIR(colorPair));
-    mvwprintw(m_statusWin, 0, 0, "%s", statusLine.c_str());
-    wattroff(m_statusWin, COLOR_PAIR(colorPair));
-    
-    wrefresh(m_statusWin);
+static const int kKeyPasteBegin = NCursesScreen::kKeyPasteBegin;
+static const int kKeyPasteEnd = NCursesScreen::kKeyPasteEnd;
+
+#ifndef _WIN32
+// 终端断开或输入结束后 stdin 一直可读，getch() 却只返回 ERR
+static bool inputHungUp() {
+    struct pollfd descriptor;
+    descriptor.fd = STDIN_FILENO;
+    descriptor.events = POLLIN;
+    descriptor.revents = 0;
+    return poll(&descriptor, 1, 0) > 0 && (descriptor.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
 }
+#endif
 
-std::string NCursesUI::getModeString() {
-    switch(m_editor.getMode()) {
-        case EditorMode::NORMAL: return "NORMAL";
-        case EditorMode::INSERT: return "INSERT";
-        case EditorMode::COMMAND: return "COMMAND";
-        case EditorMode::VISUAL_CHAR: return "VISUAL CHAR";
-        case EditorMode::VISUAL_LINE: return "VISUAL LINE";
-        case EditorMode::VISUAL_BLOCK: return "VISUAL BLOCK";
-        default: return "UNKNOWN";
-    }
+NCursesUI::NCursesUI(Editor& editor) :
+    m_editor(editor),
+    m_terminal(new NCursesScreen()),
+    m_renderer(editor, *m_terminal),
+    m_statusMessage(""),
+    m_pasting(false),
+    m_searchPending(false) {}
+
+NCursesUI::NCursesUI(Editor& editor, Screen& screen) :
+    m_editor(editor),
+    m_renderer(editor, screen),
+    m_statusMessage(""),
+    m_pasting(false),
+    m_searchPending(false) {}
+
+void NCursesUI::renderFrame() {
+    m_renderer.renderFrame(m_statusMessage);
 }
 
+#ifndef _WIN32
+// 事件循环：输入、终端尺寸变化和后台保存结束都会唤醒它，每轮等待之前最多绘制一帧。
+// 增量查找和建立行索引作为空闲任务，在没有输入时分段执行
+void NCursesUI::run() {
+    EventLoop loop;
+    EditorLoop session(loop, m_editor, m_statusMessage, [this]() { renderFrame(); });
+
+    // 把已经到达的输入全部处理完再渲染一帧，连续输入的字符合并为一次插入
+    EventLoop::Callback readInput = [this, &loop, &session]() {
+        timeout(0);
+        std::vector<int> keys;
+        int ch;
+        while ((ch = getch()) != ERR) {
+            keys.push_back(ch);
+        }
+        if (keys.empty() && inputHungUp()) {
+            // 终端已关闭：保留交换文件，未保存的修改可以恢复
+            m_editor.shutdown(false);
+            loop.quit();
+            return;
+        }
+        dispatchKeys(keys);
+        session.markDirty();
+    };
+    loop.watch(STDIN_FILENO, readInput);
+    // ncurses 自己的 SIGWINCH 处理函数更新尺寸后，getch() 返回 KEY_RESIZE
+    loop.onResize(readInput);
+
+    loop.addIdleTask([this, &session]() {
+        if (m_searchPending) {
+            updateSearch();
+            session.markDirty();
+        }
+        return false;
+    });
+    loop.run();
+}
+#else
 void NCursesUI::run() {
     while (true) {
-        renderContent();
-        renderStatusBar();
+        std::string saveMessage;
+        if (m_editor.pollSaveResult(saveMessage)) {
+            m_statusMessage = saveMessage;
+        }
+        m_editor.pollLoad();
+        renderFrame();
         
+        // 后台保存或载入期间定时醒来刷新进度
+        timeout(m_editor.isSaving() || m_editor.isLoading() ? 100 : -1);
         int ch = getch();
-        processKeyInput(ch);
+        if (ch == ERR) {
+            continue;
+        }
+
+        // 把已经到达的输入全部处理完再渲染一帧，
+        // 连续输入的字符合并为一次插入
+        timeout(0);
+        std::vector<int> keys;
+        do {
+            keys.push_back(ch);
+        } while ((ch = getch()) != ERR);
+        processKeys(keys);
+    }
+}
+#endif
+
+void NCursesUI::dispatchKeys(const std::vector<int>& keys) {
+    for (size_t i = 0; i < keys.size(); ++i) {
+        processKeyInput(keys[i]);
     }
+    flushTypedText();
+}
+
+void NCursesUI::processKeys(const std::vector<int>& keys) {
+    dispatchKeys(keys);
+    updateSearch();
+}
+
+// 命令行以 / 或 ? 开头时是在查找
+bool NCursesUI::isSearchCommand() const {
+    return m_editor.getMode() == EditorMode::COMMAND && !m_statusMessage.empty() &&
+           (m_statusMessage[0] == '/' || m_statusMessage[0] == '?');
+}
+
+void NCursesUI::updateSearch() {
+    if (m_searchPending && isSearchCommand()) {
+        m_editor.updateIncrementalSearch(m_statusMessage.substr(1));
+    }
+    m_searchPending = false;
 }
 
 void NCursesUI::processKeyInput(int ch) {
+    if (ch == KEY_RESIZE) {
+        if (m_terminal) {
+            m_terminal->resize();
+        }
+        m_renderer.invalidate();
+        return;
+    }
+    if (ch == kKeyPasteBegin) {
+        flushTypedText();
+        m_pasting = true;
+        m_pasteBuffer.clear();
+        return;
+    }
+    if (m_pasting) {
+        if (ch == kKeyPasteEnd) {
+            m_pasting = false;
+            insertPaste();
+        } else if (ch >= 0 && ch < 256) {
+            m_pasteBuffer += ch == '\r' ? '\n' : static_cast<char>(ch);
+        }
+        return;
+    }
+    // 其他按键之前先提交已缓存的输入，保证按键顺序不变
+    bool typed = m_editor.getMode() == EditorMode::INSERT &&
+                 ((ch >= 32 && ch < 127) || ch == 10 || ch == 9 || (ch >= 0x80 && ch <= 0xFF));
+    if (!typed) {
+        flushTypedText();
+    }
+
     switch(m_editor.getMode()) {
         case EditorMode::NORMAL:
             handleNormalMode(ch);
@@ -122,11 +192,57 @@ void NCursesUI::handleNormalMode(int ch) {
         case 'k': m_editor.moveCursorUp(); break;
         case 'l': m_editor.moveCursorRight(); break;
         case 'x': m_editor.deleteText(DeleteType::CHARACTER); break;
+        case 6: // Ctrl-F
+        case KEY_NPAGE:
+        {
+            Viewport& viewport = m_renderer.viewport();
+            if (m_editor.isWrapEnabled()) {
+                viewport.scrollRows(viewport.rows(), m_editor.getLineCount(), m_renderer.rowCounter());
+            } else {
+                viewport.scrollBy(viewport.rows());
+            }
+            m_editor.gotoLine(viewport.topLine() + 1);
+            break;
+        }
+        case 2: // Ctrl-B
+        case KEY_PPAGE:
+        {
+            Viewport& viewport = m_renderer.viewport();
+            if (m_editor.isWrapEnabled()) {
+                // 光标放到新的顶部行上，跟随时不会再滚动
+                viewport.scrollRows(-viewport.rows(), m_editor.getLineCount(), m_renderer.rowCounter());
+                m_editor.gotoLine(viewport.topLine() + 1);
+            } else {
+                viewport.scrollBy(-viewport.rows());
+                m_editor.gotoLine(viewport.bottomLine());
+            }
+            break;
+        }
         case 'v': m_editor.setMode(EditorMode::VISUAL_CHAR); break;
+        case 'u':
+            m_statusMessage = m_editor.undo() ? "已撤销" : "已经是最早的改动";
+            break;
+        case 18: // Ctrl-R
+            m_statusMessage = m_editor.redo() ? "已重做" : "已经是最新的改动";
+            break;
         case ':': 
             m_editor.setMode(EditorMode::COMMAND);
             m_statusMessage = ":";
             break;
+        case '/':
+        case '?':
+            m_editor.beginIncrementalSearch(ch == '?');
+            m_editor.setMode(EditorMode::COMMAND);
+            m_statusMessage = std::string(1, static_cast<char>(ch));
+            break;
+        case 'n':
+        case 'N':
+            m_statusMessage.clear();
+            if (m_editor.searchNext(ch == 'N')) {
+                m_statusMessage = (ch == 'N' ? "?" : "/") + m_editor.getLastSearch();
+            }
+            m_editor.takeMessage(m_statusMessage);
+            break;
     }
 }
 
@@ -137,19 +253,45 @@ void NCursesUI::handleInsertMode(int ch) {
             break;
         case KEY_BACKSPACE:
         case 127:
-            // 处理退格
+            m_editor.deleteText();
             break;
         default:
-            if (ch >= 32 && ch < 127) {
-                m_editor.insertText(std::string(1, static_cast<char>(ch)));
+            // UTF-8 的多字节字符逐字节到达，原样收下
+            if ((ch >= 32 && ch < 127) || ch == 10 || ch == 9 || (ch >= 0x80 && ch <= 0xFF)) {
+                m_typedText += static_cast<char>(ch);
             }
             break;
     }
 }
 
+void NCursesUI::flushTypedText() {
+    if (!m_typedText.empty()) {
+        m_editor.insertText(m_typedText);
+        m_typedText.clear();
+    }
+}
+
+// 粘贴的内容作为一次插入（一个撤销事务）写入；命令模式下只取第一行
+void NCursesUI::insertPaste() {
+    if (m_editor.getMode() == EditorMode::COMMAND) {
+        std::string line = m_pasteBuffer.substr(0, m_pasteBuffer.find('\n'));
+        for (size_t i = 0; i < line.size(); ++i) {
+            if (static_cast<unsigned char>(line[i]) >= 32) {
+                m_statusMessage += line[i];
+            }
+        }
+    } else if (!m_pasteBuffer.empty()) {
+        m_editor.insertText(m_pasteBuffer);
+    }
+    m_pasteBuffer.clear();
+}
+
 void NCursesUI::handleCommandMode(int ch) {
     switch(ch) {
         case 27: // ESC
+            if (isSearchCommand()) {
+                m_editor.cancelIncrementalSearch();
+            }
             m_editor.setMode(EditorMode::NORMAL);
             m_statusMessage = "";
             break;
@@ -160,32 +302,49 @@ void NCursesUI::handleCommandMode(int ch) {
         case 127:
             if (m_statusMessage.length() > 1) {
                 m_statusMessage = m_statusMessage.substr(0, m_statusMessage.length() - 1);
+                m_searchPending = true;
             }
             break;
         default:
             if (ch >= 32 && ch < 127) {
                 m_statusMessage += static_cast<char>(ch);
+                m_searchPending = true;
             }
             break;
     }
 }
 
 void NCursesUI::processCommand() {
-    if (m_statusMessage.length() > 1 && m_statusMessage[0] == ':') {
+    if (isSearchCommand()) {
+        // 确认增量查找的结果
+        m_searchPending = false;
+        m_editor.finishIncrementalSearch(m_statusMessage.substr(1));
+        m_editor.takeMessage(m_statusMessage);
+    } else if (m_statusMessage.length() > 1 && m_statusMessage[0] == ':') {
         std::string command = m_statusMessage.substr(1);
         if (m_editor.executeCommand(command)) {
-            m_statusMessage = "命令执行成功";
-            if (command == "q" || command.find("wq") != std::string::npos) {
-                endwin();
+            m_statusMessage = m_editor.isSaving() ? "正在保存..." : "命令执行成功";
+            m_editor.takeMessage(m_statusMessage);
+            if (command == "q" || command.compare(0, 2, "wq") == 0) {
+                // 等待尚未完成的后台保存并删除交换文件
+                m_editor.shutdown();
+                closeScreen();
                 exit(0);
             }
         } else {
             m_statusMessage = "无效命令";
+            m_editor.takeMessage(m_statusMessage);
         }
     }
     m_editor.setMode(EditorMode::NORMAL);
 }
 
+void NCursesUI::closeScreen() {
+    if (m_terminal) {
+        m_terminal->close();
+    }
+}
+
 NCursesUI::~NCursesUI() {
-    endwin();
+    closeScreen();
 } 
\ No newline at end of file
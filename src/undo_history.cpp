@@ -0,0 +1,116 @@
+/**
+ * @file undo_history.cpp
+ * @brief 撤销/重做历史实现
+ */
+#include "../include/undo_history.h"
+
+UndoHistory::UndoHistory() : m_depth(0) {
+    m_current.cursorBefore = 0;
+    m_current.cursorAfter = 0;
+}
+
+void UndoHistory::beginTransaction(size_t cursor) {
+    if (m_depth++ == 0) {
+        m_current.deltas.clear();
+        m_current.cursorBefore = cursor;
+        m_current.cursorAfter = cursor;
+    }
+}
+
+void UndoHistory::endTransaction(size_t cursor) {
+    if (m_depth == 0 || --m_depth > 0) {
+        return;
+    }
+    if (!m_current.deltas.empty()) {
+        m_current.cursorAfter = cursor;
+        m_undoStack.push_back(m_current);
+        m_current.deltas.clear();
+    }
+}
+
+// 连续输入或连续退格时把新增量并入上一个，插入模式下逐字符输入只产生一个增量
+bool UndoHistory::mergeInto(EditDelta& last, size_t offset, const std::string& removed,
+                            const std::string& inserted) {
+    if (removed.empty() && last.removed.empty() &&
+        offset == last.offset + last.inserted.size()) {
+        last.inserted += inserted;
+        return true;
+    }
+    if (inserted.empty() && last.inserted.empty() &&
+        offset + removed.size() == last.offset) {
+        last.removed.insert(0, removed);
+        last.offset = offset;
+        return true;
+    }
+    if (inserted.empty() && last.inserted.empty() && offset == last.offset) {
+        last.removed += removed;
+        return true;
+    }
+    return false;
+}
+
+void UndoHistory::record(size_t offset, const std::string& removed, const std::string& inserted,
+                         size_t cursor) {
+    if (removed.empty() && inserted.empty()) {
+        return;
+    }
+    m_redoStack.clear();
+    bool standalone = m_depth == 0;
+    if (standalone) {
+        beginTransaction(cursor);
+    }
+    if (m_current.deltas.empty() || !mergeInto(m_current.deltas.back(), offset, removed, inserted)) {
+        EditDelta delta = { offset, removed, inserted };
+        m_current.deltas.push_back(delta);
+    }
+    if (standalone) {
+        endTransaction(offset + inserted.size());
+    }
+}
+
+bool UndoHistory::canUndo() const {
+    return !m_undoStack.empty();
+}
+
+bool UndoHistory::canRedo() const {
+    return !m_redoStack.empty();
+}
+
+const UndoTransaction* UndoHistory::undo() {
+    if (m_undoStack.empty() || m_depth > 0) {
+        return NULL;
+    }
+    m_redoStack.push_back(m_undoStack.back());
+    m_undoStack.pop_back();
+    return &m_redoStack.back();
+}
+
+const UndoTransaction* UndoHistory::redo() {
+    if (m_redoStack.empty() || m_depth > 0) {
+        return NULL;
+    }
+    m_undoStack.push_back(m_redoStack.back());
+    m_redoStack.pop_back();
+    return &m_undoStack.back();
+}
+
+void UndoHistory::clear() {
+    m_undoStack.clear();
+    m_redoStack.clear();
+    m_current.deltas.clear();
+    m_depth = 0;
+}
+
+size_t UndoHistory::getMemoryUsage() const {
+    size_t total = 0;
+    const std::vector<UndoTransaction>* stacks[] = { &m_undoStack, &m_redoStack };
+    for (size_t s = 0; s < 2; ++s) {
+        for (size_t t = 0; t < stacks[s]->size(); ++t) {
+            const std::vector<EditDelta>& deltas = (*stacks[s])[t].deltas;
+            for (size_t d = 0; d < deltas.size(); ++d) {
+                total += sizeof(EditDelta) + deltas[d].removed.capacity() + deltas[d].inserted.capacity();
+            }
+        }
+    }
+    return total;
+}
@@ -3,6 +3,7 @@
  * @brief 实用工具函数实现
  */
 #include "../include/utils.h"
+#include <cstdio>
 #include <iostream>
 void printUTF8(const std::string& text) {
     #ifdef _WIN32
@@ -15,3 +16,28 @@ void printUTF8(const std::string& text) {
     std::cout << text;
     #endif
 }
+
+std::string formatBytes(size_t bytes) {
+    static const char* const units[] = { "B", "KB", "MB", "GB", "TB" };
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024.0 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024.0;
+        unit++;
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+    return text;
+}
+
+std::string formatCount(size_t count) {
+    std::string digits = std::to_string(count);
+    std::string text;
+    for (size_t i = 0; i < digits.size(); ++i) {
+        if (i > 0 && (digits.size() - i) % 3 == 0) {
+            text += ',';
+        }
+        text += digits[i];
+    }
+    return text;
+}
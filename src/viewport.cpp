@@ -0,0 +1,114 @@
+/**
+ * @file viewport.cpp
+ * @brief 窗口视口实现
+ */
+#include "../include/viewport.h"
+#include <algorithm>
+
+Viewport::Viewport() :
+    m_topLine(0),
+    m_topRow(0),
+    m_leftColumn(0),
+    m_rows(1),
+    m_columns(1) {}
+
+void Viewport::resize(int rows, int columns) {
+    m_rows = std::max(1, rows);
+    m_columns = std::max(1, columns);
+}
+
+void Viewport::follow(int cursorLine, int cursorColumn) {
+    m_topRow = 0;
+    if (cursorLine < m_topLine) {
+        m_topLine = cursorLine;
+    } else if (cursorLine >= m_topLine + m_rows) {
+        m_topLine = cursorLine - m_rows + 1;
+    }
+    if (cursorColumn < m_leftColumn) {
+        m_leftColumn = cursorColumn;
+    } else if (cursorColumn >= m_leftColumn + m_columns) {
+        m_leftColumn = cursorColumn - m_columns + 1;
+    }
+}
+
+void Viewport::scrollBy(int lines) {
+    m_topLine = std::max(0, m_topLine + lines);
+    m_topRow = 0;
+}
+
+void Viewport::followWrapped(int cursorLine, int cursorRow, const RowCounter& rowCount) {
+    m_leftColumn = 0;
+    if (cursorLine < m_topLine || (cursorLine == m_topLine && cursorRow < m_topRow)) {
+        m_topLine = cursorLine;
+        m_topRow = cursorRow;
+        return;
+    }
+    // 数出光标到顶部相隔的屏幕行，每行至少一个屏幕行，相隔的行数超过窗口高度时不必再数
+    if (cursorLine - m_topLine < m_rows) {
+        int distance = cursorRow - m_topRow;
+        for (int line = m_topLine; line < cursorLine; ++line) {
+            distance += rowCount(line);
+        }
+        if (distance < m_rows) {
+            return;
+        }
+    }
+    // 光标在窗口下方：从光标往上数满一屏，光标落在最后一个屏幕行
+    m_topLine = cursorLine;
+    m_topRow = cursorRow;
+    int above = m_rows - 1;
+    while (above > 0) {
+        if (m_topRow >= above) {
+            m_topRow -= above;
+            break;
+        }
+        above -= m_topRow + 1;
+        if (m_topLine == 0) {
+            m_topRow = 0;
+            break;
+        }
+        --m_topLine;
+        m_topRow = rowCount(m_topLine) - 1;
+    }
+}
+
+void Viewport::scrollRows(int rows, int lineCount, const RowCounter& rowCount) {
+    m_topRow += rows;
+    while (m_topRow < 0 && m_topLine > 0) {
+        --m_topLine;
+        m_topRow += rowCount(m_topLine);
+    }
+    while (m_topRow > 0 && m_topRow >= rowCount(m_topLine) && m_topLine + 1 < lineCount) {
+        m_topRow -= rowCount(m_topLine);
+        ++m_topLine;
+    }
+    m_topRow = std::max(0, std::min(m_topRow, rowCount(m_topLine) - 1));
+}
+
+int Viewport::topRow() const {
+    return m_topRow;
+}
+
+int Viewport::topLine() const {
+    return m_topLine;
+}
+
+int Viewport::leftColumn() const {
+    return m_leftColumn;
+}
+
+int Viewport::rows() const {
+    return m_rows;
+}
+
+int Viewport::columns() const {
+    return m_columns;
+}
+
+int Viewport::bottomLine() const {
+    return m_topLine + m_rows;
+}
+
+bool Viewport::isLineVisible(int line) const {
+    return line >= m_topLine && line < m_topLine + m_rows;
+}
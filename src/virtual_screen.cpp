@@ -0,0 +1,165 @@
+/**
+ * @file virtual_screen.cpp
+ * @brief 内存中的虚拟终端实现
+ */
+#include "../include/virtual_screen.h"
+#include <algorithm>
+
+static VirtualScreen::Cell blankCell() {
+    VirtualScreen::Cell cell;
+    cell.glyph = " ";
+    cell.width = 1;
+    cell.reverse = false;
+    cell.pair = 0;
+    return cell;
+}
+
+bool VirtualScreen::Cell::operator==(const Cell& other) const {
+    return width == other.width && reverse == other.reverse && pair == other.pair && glyph == other.glyph;
+}
+
+bool VirtualScreen::Cell::operator!=(const Cell& other) const {
+    return !(*this == other);
+}
+
+bool VirtualScreen::Cell::isBlank() const {
+    return width == 1 && !reverse && pair == 0 && glyph == " ";
+}
+
+VirtualScreen::VirtualScreen(int rows, int columns) :
+    m_rows(0),
+    m_columns(0),
+    m_cursorRow(0),
+    m_cursorColumn(0),
+    m_rowsDrawn(0) {
+    m_lastFrame.rowsDrawn = 0;
+    m_lastFrame.cellsChanged = 0;
+    m_lastFrame.bytesEmitted = 0;
+    resize(rows, columns);
+}
+
+void VirtualScreen::resize(int rows, int columns) {
+    m_rows = std::max(1, rows);
+    m_columns = std::max(1, columns);
+    size_t cells = static_cast<size_t>(m_rows + 1) * static_cast<size_t>(m_columns);
+    m_back.assign(cells, blankCell());
+    // 前台缓冲放一个不可能出现的单元格，使下一帧全部算作变化
+    Cell invalid = blankCell();
+    invalid.width = 0xFF;
+    m_front.assign(cells, invalid);
+}
+
+int VirtualScreen::rows() const {
+    return m_rows;
+}
+
+int VirtualScreen::columns() const {
+    return m_columns;
+}
+
+void VirtualScreen::clear() {
+    std::fill(m_back.begin(), m_back.begin() + static_cast<size_t>(m_rows) * m_columns, blankCell());
+}
+
+void VirtualScreen::drawRow(int row, const std::string& text) {
+    if (row >= 0 && row < m_rows) {
+        writeRow(row, text);
+    }
+}
+
+// 清除一行后按字素簇写入，超出右边界的部分丢弃；零宽的字素簇附加到前一个单元格
+void VirtualScreen::writeRow(int row, const std::string& text) {
+    Cell* cells = &m_back[static_cast<size_t>(row) * m_columns];
+    std::fill(cells, cells + m_columns, blankCell());
+    ++m_rowsDrawn;
+
+    m_layout.build(text.data(), text.size());
+    size_t columns = static_cast<size_t>(m_columns);
+    for (size_t byte = 0; byte < text.size();) {
+        size_t next = m_layout.nextCluster(byte);
+        size_t column = m_layout.columnOf(byte);
+        size_t width = m_layout.columnOf(next) - column;
+        if (column + width > columns) {
+            break;
+        }
+        if (width == 0) {
+            if (column > 0) {
+                cells[column - 1].glyph.append(text, byte, next - byte);
+            }
+        } else {
+            cells[column].glyph.assign(text, byte, next - byte);
+            cells[column].width = static_cast<unsigned char>(width);
+            for (size_t i = 1; i < width; ++i) {
+                cells[column + i].glyph.clear();
+                cells[column + i].width = 0;
+            }
+        }
+        byte = next;
+    }
+}
+
+void VirtualScreen::setStyle(int row, int column, int count, bool reverse, short pair) {
+    if (row < 0 || row >= m_rows || column < 0 || column >= m_columns) {
+        return;
+    }
+    int end = count < 0 ? m_columns : std::min(m_columns, column + count);
+    Cell* cells = &m_back[static_cast<size_t>(row) * m_columns];
+    for (int i = column; i < end; ++i) {
+        cells[i].reverse = reverse;
+        cells[i].pair = pair;
+    }
+}
+
+void VirtualScreen::drawStatus(const std::string& text, short pair) {
+    writeRow(m_rows, text);
+    Cell* cells = &m_back[static_cast<size_t>(m_rows) * m_columns];
+    for (int i = 0; i < m_columns; ++i) {
+        cells[i].pair = pair;
+    }
+}
+
+void VirtualScreen::setCursor(int row, int column) {
+    m_cursorRow = row;
+    m_cursorColumn = column;
+}
+
+void VirtualScreen::present() {
+    m_lastFrame.rowsDrawn = m_rowsDrawn;
+    m_lastFrame.cellsChanged = 0;
+    m_lastFrame.bytesEmitted = 0;
+    for (size_t i = 0; i < m_back.size(); ++i) {
+        if (m_back[i] != m_front[i]) {
+            m_front[i] = m_back[i];
+            ++m_lastFrame.cellsChanged;
+            m_lastFrame.bytesEmitted += m_back[i].glyph.size();
+        }
+    }
+    m_rowsDrawn = 0;
+}
+
+const VirtualScreen::FrameStats& VirtualScreen::lastFrame() const {
+    return m_lastFrame;
+}
+
+std::string VirtualScreen::rowText(int row) const {
+    std::string text;
+    const Cell* cells = &m_front[static_cast<size_t>(row) * m_columns];
+    for (int i = 0; i < m_columns; ++i) {
+        if (cells[i].width != 0xFF) {
+            text += cells[i].glyph;
+        }
+    }
+    return text;
+}
+
+const VirtualScreen::Cell& VirtualScreen::cell(int row, int column) const {
+    return m_front[static_cast<size_t>(row) * m_columns + column];
+}
+
+int VirtualScreen::cursorRow() const {
+    return m_cursorRow;
+}
+
+int VirtualScreen::cursorColumn() const {
+    return m_cursorColumn;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file wrap_layout.cpp
+ * @brief 软换行实现
+ */
+#include "../include/wrap_layout.h"
+#include <algorithm>
+#include <utility>
+
+WrapLayout::WrapLayout() : m_width(80) {}
+
+void WrapLayout::setWidth(size_t columns) {
+    columns = std::max<size_t>(1, columns);
+    if (columns != m_width) {
+        m_width = columns;
+        m_lines.clear();
+    }
+}
+
+size_t WrapLayout::width() const {
+    return m_width;
+}
+
+const std::vector<size_t>& WrapLayout::rowStarts(size_t line, const LineLayout& layout) {
+    std::unordered_map<size_t, std::vector<size_t> >::iterator it = m_lines.find(line);
+    if (it != m_lines.end()) {
+        return it->second;
+    }
+    if (m_lines.size() >= kCacheLines) {
+        m_lines.clear();
+    }
+    std::vector<size_t>& starts = m_lines[line];
+    size_t width = layout.width();
+    size_t start = 0;
+    starts.push_back(0);
+    while (width - start > m_width) {
+        // 覆盖下一屏幕行第一列的字素簇若跨过了边界，整个移到下一屏幕行；
+        // 比窗口还宽的字素簇（很宽的制表符）只能截断
+        size_t limit = start + m_width;
+        size_t next = layout.columnOf(layout.byteAt(limit));
+        if (next <= start) {
+            next = limit;
+        }
+        starts.push_back(next);
+        start = next;
+    }
+    starts.push_back(width);
+    return starts;
+}
+
+size_t WrapLayout::rowCount(size_t line, const LineLayout& layout) {
+    return rowStarts(line, layout).size() - 1;
+}
+
+size_t WrapLayout::rowOf(size_t line, const LineLayout& layout, size_t column) {
+    const std::vector<size_t>& starts = rowStarts(line, layout);
+    // 行尾（列等于整行宽度）算在最后一个屏幕行
+    size_t row = static_cast<size_t>(std::upper_bound(starts.begin(), starts.end() - 1, column) -
+                                     starts.begin());
+    return row > 0 ? row - 1 : 0;
+}
+
+void WrapLayout::clear() {
+    m_lines.clear();
+}
+
+void WrapLayout::applyEdit(size_t line, size_t removedLines, size_t insertedLines) {
+    if (removedLines == insertedLines) {
+        for (size_t i = line; i <= line + removedLines; ++i) {
+            m_lines.erase(i);
+        }
+        return;
+    }
+    std::unordered_map<size_t, std::vector<size_t> > moved;
+    for (std::unordered_map<size_t, std::vector<size_t> >::iterator it = m_lines.begin(); it != m_lines.end();
+         ++it) {
+        if (it->first < line) {
+            moved[it->first] = std::move(it->second);
+        } else if (it->first > line + removedLines) {
+            moved[it->first + insertedLines - removedLines] = std::move(it->second);
+        }
+    }
+    m_lines.swap(moved);
+}
+
+void WrapLayout::invalidateLine(size_t line) {
+    m_lines.erase(line);
+}